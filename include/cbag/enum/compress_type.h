@@ -0,0 +1,13 @@
+#ifndef CBAG_ENUM_COMPRESS_TYPE_H
+#define CBAG_ENUM_COMPRESS_TYPE_H
+
+#include <cbag/common/typedefs.h>
+
+namespace cbag {
+
+// AUTO picks the compression from the file extension.
+enum class compress_type : enum_t { NONE = 0, GZIP = 1, ZSTD = 2, AUTO = 3 };
+
+} // namespace cbag
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef CBAG_ENUM_INDEX_ALGORITHM_H
+#define CBAG_ENUM_INDEX_ALGORITHM_H
+
+#include <cbag/common/typedefs.h>
+
+namespace cbag {
+
+enum class index_algorithm : enum_t {
+    LINEAR = 0,
+    QUADRATIC = 1,
+    RSTAR = 2,
+};
+
+} // namespace cbag
+
+#endif
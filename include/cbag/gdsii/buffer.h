@@ -0,0 +1,47 @@
+#ifndef CBAG_GDSII_BUFFER_H
+#define CBAG_GDSII_BUFFER_H
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace cbag {
+namespace gdsii {
+
+/** A growable buffer that GDS records are encoded into in place.
+ *
+ *  A structure is encoded into one buffer and written to the file with a single call.
+ */
+class gds_buffer {
+  private:
+    std::vector<char> buf;
+
+  public:
+    std::size_t size() const noexcept { return buf.size(); }
+
+    const char *data() const noexcept { return buf.data(); }
+
+    /** Grows the buffer by n bytes and returns a pointer to the new bytes.
+     */
+    char *extend(std::size_t n) {
+        auto old_size = buf.size();
+        buf.resize(old_size + n);
+        return buf.data() + old_size;
+    }
+
+    void append(const gds_buffer &other) {
+        buf.insert(buf.end(), other.buf.begin(), other.buf.end());
+    }
+
+    /** Writes the content to the stream and empties the buffer, keeping its capacity.
+     */
+    void flush(std::ostream &stream) {
+        stream.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+    }
+};
+
+} // namespace gdsii
+} // namespace cbag
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef CBAG_GDSII_CURSOR_H
+#define CBAG_GDSII_CURSOR_H
+
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+#include <cbag/util/sfinae.h>
+
+namespace cbag {
+namespace gdsii {
+
+/** Decodes a big-endian integer from unaligned memory.
+ */
+template <typename T, util::IsInt<T> = 0> T load_big_endian(const char *ptr) {
+    std::make_unsigned_t<T> val;
+    std::memcpy(&val, ptr, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if constexpr (sizeof(T) == 2)
+        val = __builtin_bswap16(val);
+    else if constexpr (sizeof(T) == 4)
+        val = __builtin_bswap32(val);
+    else if constexpr (sizeof(T) == 8)
+        val = __builtin_bswap64(val);
+#endif
+    return static_cast<T>(val);
+}
+
+/** A bounds-checked read position in a GDS file held in memory.
+ *
+ *  Strings are returned as views into the underlying buffer, so the buffer must outlive them.
+ */
+class gds_cursor {
+  private:
+    const char *cur = nullptr;
+    const char *stop = nullptr;
+
+    void check_size(std::size_t n) const {
+        if (n > remaining())
+            throw std::runtime_error("Unexpected end of GDS data.");
+    }
+
+  public:
+    gds_cursor(const char *data, std::size_t size) : cur(data), stop(data + size) {}
+
+    std::size_t remaining() const noexcept { return static_cast<std::size_t>(stop - cur); }
+
+    const char *position() const noexcept { return cur; }
+
+    template <typename T, util::IsInt<T> = 0> T read() {
+        check_size(sizeof(T));
+        auto ans = load_big_endian<T>(cur);
+        cur += sizeof(T);
+        return ans;
+    }
+
+    std::string_view read_chars(std::size_t n) {
+        check_size(n);
+        std::string_view ans(cur, n);
+        cur += n;
+        return ans;
+    }
+
+    void skip(std::size_t n) {
+        check_size(n);
+        cur += n;
+    }
+};
+
+} // namespace gdsii
+} // namespace cbag
+
+#endif
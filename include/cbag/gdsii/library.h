@@ -0,0 +1,57 @@
+#ifndef CBAG_GDSII_LIBRARY_H
+#define CBAG_GDSII_LIBRARY_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cbag/util/mmap_file.h>
+
+#include <cbag/gdsii/read.h>
+#include <cbag/layout/cellview_fwd.h>
+#include <cbag/layout/routing_grid_fwd.h>
+
+namespace cbag {
+namespace gdsii {
+
+/** A GDS file whose cellviews are parsed on demand.
+ *
+ *  Opening the library only scans the structure boundaries.  Requesting a cellview parses it and
+ *  all of its transitive masters that were not loaded before; loaded cellviews are cached.  This
+ *  class is not thread safe, but get_cellview() can parse independent masters concurrently.
+ */
+class gds_library {
+  private:
+    util::mmap_file file;
+    std::shared_ptr<const layout::routing_grid> grid;
+    gds_rlookup rmap;
+    std::string lib_name;
+    std::vector<gds_struct_info> info_list;
+    std::unordered_map<std::string, std::size_t> idx_map;
+    std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> cv_map;
+
+  public:
+    gds_library(const std::string &fname, const std::string &layer_map, const std::string &obj_map,
+                std::shared_ptr<const layout::routing_grid> g);
+
+    const std::string &get_lib_name() const noexcept;
+
+    /** Returns the names of all structures, in file order.
+     */
+    std::vector<std::string> get_cell_names() const;
+
+    bool has_cell(const std::string &cell_name) const;
+
+    bool is_loaded(const std::string &cell_name) const;
+
+    std::size_t get_num_loaded() const noexcept;
+
+    std::shared_ptr<const layout::cellview> get_cellview(const std::string &cell_name,
+                                                         std::size_t num_threads = 1);
+};
+
+} // namespace gdsii
+} // namespace cbag
+
+#endif
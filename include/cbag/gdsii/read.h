@@ -1,21 +1,28 @@
-
 #ifndef CBAG_GDSII_READ_H
 #define CBAG_GDSII_READ_H
 
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
+#include <vector>
 
 #include <boost/container_hash/hash.hpp>
 
 #include <cbag/logging/logging.h>
 
-#include <cbag/util/io.h>
+#include <cbag/util/compress.h>
+#include <cbag/util/mmap_file.h>
 
 #include <cbag/common/layer_t.h>
 #include <cbag/enum/boundary_type.h>
+#include <cbag/enum/compress_type.h>
+#include <cbag/gdsii/cursor.h>
+#include <cbag/gdsii/read_util.h>
 #include <cbag/gdsii/record_type.h>
 #include <cbag/gdsii/typedefs.h>
 #include <cbag/layout/cellview.h>
@@ -27,11 +34,13 @@ namespace gdsii {
 
 using gds_to_lay_map = std::unordered_map<gds_layer_t, layer_t, boost::hash<gds_layer_t>>;
 using gds_to_bnd_map = std::unordered_map<gds_layer_t, boundary_type, boost::hash<gds_layer_t>>;
+using gds_layer_set = std::unordered_set<gds_layer_t, boost::hash<gds_layer_t>>;
 
 class gds_rlookup {
   private:
     gds_to_lay_map lay_map;
     gds_to_bnd_map bnd_map;
+    std::optional<gds_layer_set> filter;
 
   public:
     gds_rlookup();
@@ -41,39 +50,192 @@ class gds_rlookup {
     std::variant<layer_t, boundary_type, bool> get_mapping(gds_layer_t key) const;
 
     layer_t get_layer_t(gds_layer_t key) const;
+
+    /** Only reads elements on GDS layers that map to one of the given layers, and boundaries.
+     */
+    void set_layer_filter(const std::vector<layer_t> &layer_list);
+
+    /** Only reads elements on the given GDS layer/datatype pairs, and boundaries.
+     */
+    void set_gds_layer_filter(gds_layer_set gds_layers);
+
+    /** Returns false if elements on this GDS layer should be skipped without parsing.
+     */
+    bool is_wanted(gds_layer_t key) const;
+};
+
+template <class S> std::string read_gds_start(spdlog::logger &logger, S &stream) {
+    read_header(logger, stream);
+    read_lib_begin(logger, stream);
+    auto ans = read_lib_name(logger, stream);
+    read_units(logger, stream);
+    return ans;
+}
+
+/** Element counts of one GDS structure.  Per-element logging is at TRACE level, these are
+ *  logged once per structure instead.
+ */
+struct gds_cell_stats {
+    std::size_t num_text = 0;
+    std::size_t num_inst = 0;
+    std::size_t num_box = 0;
+    std::size_t num_boundary = 0;
+    std::size_t num_path = 0;
+    std::size_t num_node = 0;
+    // elements on layers removed by the layer filter
+    std::size_t num_skip = 0;
+    // elements with absolute magnification or rotation, which are treated as relative
+    std::size_t num_absolute = 0;
 };
 
-std::tuple<record_type, std::size_t> read_record_header(std::istream &stream);
+void log_cell_stats(spdlog::logger &logger, const std::string &cell_name,
+                    const gds_cell_stats &stats, std::size_t num_bytes,
+                    std::chrono::steady_clock::time_point start);
 
-std::string read_gds_start(spdlog::logger &logger, std::istream &stream);
+void add_object(spdlog::logger &logger, layout::cellview &ans, gds_layer_t &&gds_key,
+                layout::polygon &&poly, const gds_rlookup &rmap);
 
+/** Adds a PATH element to the cellview.  Paths on a 45 degree grid are drawn exactly, except
+ *  that odd widths are rounded up to the next even width.
+ */
+void add_path(spdlog::logger &logger, layout::cellview &ans, const gds_layer_t &gds_key,
+              gds_path &&path, const gds_rlookup &rmap);
+
+/** Adds a magnified instance to the cellview by flattening its geometry, as layout instances
+ *  cannot be scaled.
+ */
+void add_magnified(spdlog::logger &logger, layout::cellview &ans, const layout::instance &inst,
+                   double mag);
+
+/** Returns the shape buffer of the GDS layer, creating it if needed.  Boundaries are not shapes,
+ *  so the buffers of boundary layers keep their elements as read.
+ */
+gds_shape_buffer &get_shape_buffer(gds_shape_map &shape_map, gds_layer_t key,
+                                   const gds_rlookup &rmap);
+
+/** Adds the buffered shapes of a structure to the cellview, one layer at a time.
+ */
+void add_shapes(spdlog::logger &logger, layout::cellview &ans, const gds_shape_map &shape_map,
+                const gds_rlookup &rmap);
+
+template <class S>
 std::tuple<std::string, std::shared_ptr<layout::cellview>> read_lay_cellview(
-    spdlog::logger &logger, std::istream &stream, const std::string &lib_name,
+    spdlog::logger &logger, S &stream, const std::string &lib_name,
     const std::shared_ptr<const layout::routing_grid> &g, const gds_rlookup &rmap,
-    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map);
+    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map) {
+    auto start_time = std::chrono::steady_clock::now();
+    auto start_pos = get_position(stream);
+    auto cell_name = read_struct_name(logger, stream);
 
-template <class OutIter>
-void read_gds(const std::string &fname, const std::string &layer_map, const std::string &obj_map,
-              const std::shared_ptr<const layout::routing_grid> &g, OutIter &&out_iter) {
-    auto log_ptr = get_cbag_logger();
+    SPDLOG_LOGGER_TRACE(&logger, "GDS cellview name: {}", cell_name);
 
-    // get gds file stream
-    log_ptr->info("Reading GDS file {}", fname);
-    auto stream = util::open_file_read(fname, true);
-    auto lib_name = read_gds_start(*log_ptr, stream);
-    log_ptr->info("GDS library: {}", lib_name);
+    auto cv_ptr = std::make_shared<layout::cellview>(g, cell_name, geometry_mode::POLY);
+    auto resolution = g->get_tech()->get_resolution();
+    auto inst_cnt = static_cast<std::size_t>(0);
+    gds_shape_map shape_map;
+    gds_cell_stats stats;
+    while (true) {
+        auto[rtype, rsize] = read_record_header(stream);
+        switch (rtype) {
+        case record_type::TEXT: {
+            SPDLOG_LOGGER_TRACE(&logger, "Reading layout text.");
+            ++stats.num_text;
+            auto gds_key = read_ele_layer<record_type::TEXTTYPE>(logger, stream);
+            if (!rmap.is_wanted(gds_key)) {
+                ++stats.num_skip;
+                skip_element(stream);
+                break;
+            }
+            auto[xform, text, text_h_dbl] = read_text_data(logger, stream, stats.num_absolute);
+            auto text_h = static_cast<offset_t>(text_h_dbl / resolution);
+            cv_ptr->add_label(rmap.get_layer_t(gds_key), std::move(xform), std::move(text), text_h);
+            break;
+        }
+        case record_type::SREF:
+        case record_type::AREF: {
+            SPDLOG_LOGGER_TRACE(&logger, "Reading layout instance.");
+            ++stats.num_inst;
+            auto[inst, mag] =
+                (rtype == record_type::SREF)
+                    ? read_instance(logger, stream, inst_cnt, master_map, stats.num_absolute)
+                    : read_arr_instance(logger, stream, inst_cnt, master_map, stats.num_absolute);
+            if (mag == 1.0)
+                cv_ptr->add_object(inst);
+            else
+                add_magnified(logger, *cv_ptr, inst, mag);
+            break;
+        }
+        case record_type::BOX: {
+            SPDLOG_LOGGER_TRACE(&logger, "Reading layout box.");
+            ++stats.num_box;
+            auto gds_key = read_ele_layer<record_type::BOXTYPE>(logger, stream);
+            if (rmap.is_wanted(gds_key)) {
+                read_box_data(logger, stream, get_shape_buffer(shape_map, gds_key, rmap));
+            } else {
+                ++stats.num_skip;
+                skip_element(stream);
+            }
+            break;
+        }
+        case record_type::BOUNDARY: {
+            SPDLOG_LOGGER_TRACE(&logger, "Reading layout boundary.");
+            ++stats.num_boundary;
+            auto gds_key = read_ele_layer<record_type::DATATYPE>(logger, stream);
+            if (rmap.is_wanted(gds_key)) {
+                read_boundary_data(logger, stream, get_shape_buffer(shape_map, gds_key, rmap));
+            } else {
+                ++stats.num_skip;
+                skip_element(stream);
+            }
+            break;
+        }
+        case record_type::PATH: {
+            SPDLOG_LOGGER_TRACE(&logger, "Reading layout path.");
+            ++stats.num_path;
+            auto gds_key = read_ele_layer<record_type::DATATYPE>(logger, stream);
+            if (rmap.is_wanted(gds_key)) {
+                add_path(logger, *cv_ptr, gds_key, read_path_data(logger, stream), rmap);
+            } else {
+                ++stats.num_skip;
+                skip_element(stream);
+            }
+            break;
+        }
+        case record_type::NODE:
+            SPDLOG_LOGGER_TRACE(&logger, "Skipping layout node.");
+            ++stats.num_node;
+            skip_element(stream);
+            break;
+        case record_type::ENDSTR:
+            add_shapes(logger, *cv_ptr, shape_map, rmap);
+            log_cell_stats(logger, cell_name, stats, get_position(stream) - start_pos,
+                           start_time);
+            return {std::move(cell_name), std::move(cv_ptr)};
+        default:
+            throw std::runtime_error("Unsupported record type in GDS struct: " +
+                                     std::to_string(static_cast<int>(rtype)));
+        }
+    }
+}
+
+/** Reads all cellviews of a GDS library from the given source, which is either a std::istream or
+ *  a gds_cursor.
+ */
+template <class S, class OutIter>
+void read_gds(spdlog::logger &logger, S &stream, const gds_rlookup &rmap,
+              const std::shared_ptr<const layout::routing_grid> &g, OutIter &&out_iter) {
+    auto lib_name = read_gds_start(logger, stream);
+    logger.info("GDS library: {}", lib_name);
 
-    bool is_done = false;
-    gds_rlookup rmap(layer_map, obj_map, *(g->get_tech()));
     std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> cv_map;
-    while (!is_done) {
+    while (true) {
         auto[rtype, rsize] = read_record_header(stream);
         switch (rtype) {
         case record_type::BGNSTR: {
-            log_ptr->info("Reading GDS cellview");
-            stream.ignore(rsize);
+            SPDLOG_LOGGER_TRACE(&logger, "Reading GDS cellview");
+            skip_bytes(stream, rsize);
             auto[cell_name, cv_ptr] =
-                read_lay_cellview(*log_ptr, stream, lib_name, g, rmap, cv_map);
+                read_lay_cellview(logger, stream, lib_name, g, rmap, cv_map);
 
             cv_map.emplace(cell_name, cv_ptr);
             *out_iter = std::move(cv_ptr);
@@ -81,8 +243,6 @@ void read_gds(const std::string &fname, const std::string &layer_map, const std:
             break;
         }
         case record_type::ENDLIB:
-            log_ptr->info("Finish reading GDS file {}", fname);
-            stream.close();
             return;
         default:
             throw std::runtime_error("Unrecognized GDS record type: " +
@@ -91,6 +251,79 @@ void read_gds(const std::string &fname, const std::string &layer_map, const std:
     }
 }
 
+/** The location of a structure in a GDS file, and the names of the structures it references.
+ */
+struct gds_struct_info {
+    std::string name;
+    // positioned at the STRNAME record
+    gds_cursor start;
+    std::vector<std::string> master_list;
+};
+
+/** Scans all structures of a GDS library without parsing their elements.
+ *
+ *  The cursor must be positioned after the library header, and is left after ENDLIB.
+ */
+std::vector<gds_struct_info> index_gds_structs(spdlog::logger &logger, gds_cursor &stream);
+
+/** Parses the given structures, returning the cellviews in the same order.
+ *
+ *  Structures are parsed in waves of the reference graph: a structure is parsed once all its
+ *  masters are done, and all structures of a wave are parsed concurrently with up to num_threads
+ *  threads.  References may also resolve to the already loaded cellviews in master_map.
+ */
+std::vector<std::shared_ptr<layout::cellview>> read_gds_structs(
+    spdlog::logger &logger, const std::vector<gds_struct_info> &info_list,
+    const std::string &lib_name, const std::shared_ptr<const layout::routing_grid> &g,
+    const gds_rlookup &rmap, std::size_t num_threads = 1,
+    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map =
+        {});
+
+/** Reads all cellviews of a GDS file, in file order.
+ *
+ *  The file is memory mapped and parsed in place, so no data is copied through a stream buffer.
+ *  Structures are first indexed, then parsed with read_gds_structs().
+ *
+ *  gzip and zstd compressed files, picked by extension unless comp is given, are decompressed on
+ *  a background thread while a single thread parses the stream.
+ *
+ *  If layer_list is given, only shapes and labels on those layers are read, see
+ *  gds_rlookup::set_layer_filter().
+ */
+template <class OutIter>
+void read_gds(const std::string &fname, const std::string &layer_map, const std::string &obj_map,
+              const std::shared_ptr<const layout::routing_grid> &g, OutIter &&out_iter,
+              std::size_t num_threads = 1, compress_type comp = compress_type::AUTO,
+              const std::optional<std::vector<layer_t>> &layer_list = {}) {
+    auto log_ptr = get_cbag_logger();
+
+    log_ptr->info("Reading GDS file {}", fname);
+    gds_rlookup rmap(layer_map, obj_map, *(g->get_tech()));
+    if (layer_list)
+        rmap.set_layer_filter(*layer_list);
+
+    comp = util::get_compress_type(fname, comp);
+    if (comp != compress_type::NONE) {
+        util::decompress_istream stream(fname, comp);
+        read_gds(*log_ptr, stream, rmap, g, out_iter);
+        log_ptr->info("Finish reading GDS file {}", fname);
+        return;
+    }
+
+    util::mmap_file file(fname);
+    gds_cursor stream(file.data(), file.size());
+    auto lib_name = read_gds_start(*log_ptr, stream);
+    log_ptr->info("GDS library: {}", lib_name);
+    auto info_list = index_gds_structs(*log_ptr, stream);
+
+    auto cv_list = read_gds_structs(*log_ptr, info_list, lib_name, g, rmap, num_threads);
+    for (auto &cv_ptr : cv_list) {
+        *out_iter = std::move(cv_ptr);
+        ++out_iter;
+    }
+    log_ptr->info("Finish reading GDS file {}", fname);
+}
+
 } // namespace gdsii
 } // namespace cbag
 
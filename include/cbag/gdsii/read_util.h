@@ -1,31 +1,49 @@
-
 #ifndef CBAG_GDSII_READ_UTIL_H
 #define CBAG_GDSII_READ_UTIL_H
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
+
+#include <boost/container_hash/hash.hpp>
 
+#include <fmt/core.h>
+
+#include <cbag/common/box_t.h>
 #include <cbag/common/layer_t.h>
+#include <cbag/common/point.h>
 #include <cbag/common/transformation.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/gdsii/cursor.h>
+#include <cbag/gdsii/math.h>
 #include <cbag/gdsii/record_type.h>
 #include <cbag/gdsii/typedefs.h>
+#include <cbag/layout/instance.h>
 #include <cbag/layout/polygon.h>
+#include <cbag/layout/pt_traits.h>
 #include <cbag/logging/logging.h>
 #include <cbag/util/sfinae.h>
 
 namespace cbag {
-
-class box_t;
-
 namespace layout {
-class instance;
 class cellview;
 } // namespace layout
 
 namespace gdsii {
 
+// The parsing functions below work on any source for which read_bytes(), skip_bytes(),
+// read_chars() and peek_record_header() are defined: a std::istream, or a gds_cursor over a
+// memory mapped file.
+
 template <typename T, util::IsInt<T> = 0> T read_bytes(std::istream &stream) {
     constexpr auto unit_size = sizeof(T);
     auto ans = static_cast<T>(0);
@@ -36,35 +54,523 @@ template <typename T, util::IsInt<T> = 0> T read_bytes(std::istream &stream) {
     return ans;
 }
 
-std::tuple<record_type, std::size_t> read_record_header(std::istream &stream);
+template <typename T, util::IsInt<T> = 0> T read_bytes(gds_cursor &stream) {
+    return stream.read<T>();
+}
+
+inline void skip_bytes(std::istream &stream, std::size_t n) { stream.ignore(n); }
+
+inline void skip_bytes(gds_cursor &stream, std::size_t n) { stream.skip(n); }
+
+inline std::string read_chars(std::istream &stream, std::size_t n) {
+    std::string ans(n, '\0');
+    stream.read(ans.data(), n);
+    return ans;
+}
+
+inline std::string_view read_chars(gds_cursor &stream, std::size_t n) {
+    return stream.read_chars(n);
+}
+
+/** Returns the string without the NUL characters that pad it to an even length.
+ */
+inline std::string_view strip_padding(std::string_view str) {
+    auto end = str.find_last_not_of('\0');
+    return str.substr(0, (end == std::string_view::npos) ? 0 : end + 1);
+}
+
+template <class S> std::tuple<record_type, std::size_t> read_record_header(S &stream) {
+    auto size = static_cast<std::size_t>(read_bytes<uint16_t>(stream)) - 4;
+    auto record_val = read_bytes<uint16_t>(stream);
+
+    return {static_cast<record_type>(record_val), size};
+}
+
+inline std::size_t get_position(std::istream &stream) {
+    return static_cast<std::size_t>(stream.tellg());
+}
+
+inline std::size_t get_position(const gds_cursor &stream) {
+    return reinterpret_cast<std::uintptr_t>(stream.position());
+}
+
+inline std::tuple<record_type, std::size_t> peek_record_header(std::istream &stream) {
+    auto ans = read_record_header(stream);
+    stream.seekg(-4, std::ios::cur);
+    return ans;
+}
+
+inline std::tuple<record_type, std::size_t> peek_record_header(gds_cursor stream) {
+    return read_record_header(stream);
+}
+
+template <record_type R, std::size_t unit_size = 1, std::size_t num_data = 0, class S>
+std::size_t check_record_header(S &stream) {
+    auto[actual, size] = read_record_header(stream);
+    if (actual != R)
+        throw std::runtime_error(fmt::format("got gds record {:#x}, expected {:#x}",
+                                             static_cast<int>(actual), static_cast<int>(R)));
+
+    auto ans = size / unit_size;
+    auto mod = size % unit_size;
+    if (mod != 0)
+        throw std::runtime_error(
+            fmt::format("gds record size {} not divisible by unit size {}", size, unit_size));
+
+    if (num_data != 0 && ans != num_data) {
+        throw std::runtime_error(
+            fmt::format("gds record has {} elements, expected {}", ans, num_data));
+    }
+    return ans;
+}
+
+template <record_type R, std::size_t unit_size = 1, std::size_t num_data = 0, class S>
+void read_skip(S &stream) {
+    auto num = check_record_header<R, unit_size, num_data>(stream);
+    skip_bytes(stream, num * unit_size);
+}
+
+template <record_type R, class S> uint16_t read_int(spdlog::logger &logger, S &stream) {
+    check_record_header<R, sizeof(uint16_t), 1>(stream);
+    return read_bytes<uint16_t>(stream);
+}
+
+template <class S> std::tuple<uint16_t, uint16_t> read_col_row(spdlog::logger &logger, S &stream) {
+    check_record_header<record_type::COLROW, sizeof(uint16_t), 2>(stream);
+    auto nx = read_bytes<uint16_t>(stream);
+    auto ny = read_bytes<uint16_t>(stream);
+    return {nx, ny};
+}
+
+template <record_type R, class S> double read_double(spdlog::logger &logger, S &stream) {
+    check_record_header<R, sizeof(uint64_t), 1>(stream);
+    return gds_to_double(read_bytes<uint64_t>(stream));
+}
+
+/** Reads a string record without its padding.  Returns a view into the file buffer when reading
+ *  from a gds_cursor.
+ */
+template <record_type R, class S> auto read_name(spdlog::logger &logger, S &stream) {
+    auto num = check_record_header<R, sizeof(char)>(stream);
+    auto ans = read_chars(stream, num);
+    return decltype(ans)(strip_padding(ans));
+}
+
+template <record_type R, class S> void read_grp_begin(spdlog::logger &logger, S &stream) {
+    read_skip<R, sizeof(tval_t), 12>(stream);
+}
+
+template <class S> void read_header(spdlog::logger &logger, S &stream) {
+    read_skip<record_type::HEADER, sizeof(uint16_t), 1>(stream);
+}
+
+template <class S> void read_lib_begin(spdlog::logger &logger, S &stream) {
+    read_grp_begin<record_type::BGNLIB>(logger, stream);
+}
+
+template <class S> std::string read_lib_name(spdlog::logger &logger, S &stream) {
+    return std::string(read_name<record_type::LIBNAME>(logger, stream));
+}
+
+template <class S> void read_units(spdlog::logger &logger, S &stream) {
+    read_skip<record_type::UNITS, sizeof(uint64_t), 2>(stream);
+}
+
+template <class S> std::string read_struct_name(spdlog::logger &logger, S &stream) {
+    return std::string(read_name<record_type::STRNAME>(logger, stream));
+}
+
+/** Skips all following records whose type is in the given list.
+ */
+template <class S> void skip_optional(S &stream, std::initializer_list<record_type> rec_list) {
+    while (true) {
+        auto[rec, size] = peek_record_header(stream);
+        if (std::find(rec_list.begin(), rec_list.end(), rec) == rec_list.end())
+            return;
+        read_record_header(stream);
+        skip_bytes(stream, size);
+    }
+}
+
+/** Skips the optional ELFLAGS and PLEX records at the start of an element.
+ */
+template <class S> void read_ele_flags(spdlog::logger &logger, S &stream) {
+    skip_optional(stream, {record_type::ELFLAGS, record_type::PLEX});
+}
+
+/** Reads the end of an element, skipping any element properties.
+ */
+template <class S> void read_ele_end(spdlog::logger &logger, S &stream) {
+    skip_optional(stream, {record_type::PROPATTR, record_type::PROPVALUE});
+    check_record_header<record_type::ENDEL, sizeof(uint16_t), 0>(stream);
+}
+
+/** Skips the rest of an element up to and including ENDEL.
+ */
+template <class S> void skip_element(S &stream) {
+    while (true) {
+        auto[rtype, rsize] = read_record_header(stream);
+        skip_bytes(stream, rsize);
+        if (rtype == record_type::ENDEL)
+            return;
+    }
+}
+
+/** Reads the optional STRANS, MAG and ANGLE records of an element.  Absolute magnification and
+ *  rotation are treated as relative and counted in num_absolute, so the caller can warn once.
+ */
+template <class S>
+std::tuple<transformation, double> read_transform_info(spdlog::logger &logger, S &stream,
+                                                       std::size_t &num_absolute) {
+    auto ans = make_xform();
+    // STRANS is optional, with no reflection, magnification or rotation by default
+    if (std::get<0>(peek_record_header(stream)) != record_type::STRANS)
+        return {ans, 1.0};
+
+    auto bit_flag = read_int<record_type::STRANS>(logger, stream);
+    if ((bit_flag & (1 << 2)) != 0 || (bit_flag & (1 << 1)) != 0)
+        ++num_absolute;
+    if ((bit_flag & (1 << 15)) != 0) {
+        set_orient(ans, oMX);
+    }
+
+    double mag = 1.0;
+    double ang_dbl = 0.0;
+    auto[rec, size] = peek_record_header(stream);
+    switch (rec) {
+    case record_type::MAG:
+        mag = read_double<record_type::MAG>(logger, stream);
+        rec = std::get<0>(peek_record_header(stream));
+        if (rec == record_type::ANGLE)
+            ang_dbl = read_double<record_type::ANGLE>(logger, stream);
+        break;
+    case record_type::ANGLE:
+        ang_dbl = read_double<record_type::ANGLE>(logger, stream);
+        break;
+    default:
+        break;
+    }
+
+    auto angle = static_cast<int>(ang_dbl);
+    switch (angle) {
+    case 0:
+        break;
+    case 90:
+        transform_by(ans, make_xform(0, 0, oR90));
+        break;
+    case 180:
+        transform_by(ans, make_xform(0, 0, oR180));
+        break;
+    case 270:
+        transform_by(ans, make_xform(0, 0, oR270));
+        break;
+    default:
+        throw std::runtime_error("GDS rotation angle not supported: " + std::to_string(angle));
+    }
+
+    return {ans, mag};
+}
+
+template <class S> point read_point(S &stream) {
+    auto x = read_bytes<int32_t>(stream);
+    auto y = read_bytes<int32_t>(stream);
+    return {x, y};
+}
+
+template <class S>
+std::tuple<transformation, double> read_transform_mag(spdlog::logger &logger, S &stream,
+                                                      std::size_t &num_absolute) {
+    auto ans = read_transform_info(logger, stream, num_absolute);
+    check_record_header<record_type::XY, sizeof(int32_t), 2>(stream);
+    auto[x, y] = read_point(stream);
+    move_by(std::get<0>(ans), x, y);
 
-void read_header(spdlog::logger &logger, std::istream &stream);
+    return ans;
+}
 
-void read_lib_begin(spdlog::logger &logger, std::istream &stream);
+template <class S> transformation read_transform(spdlog::logger &logger, S &stream) {
+    std::size_t num_absolute = 0;
+    auto ans = std::get<0>(read_transform_mag(logger, stream, num_absolute));
+    if (num_absolute > 0)
+        logger.warn("Absolute GDS magnification and rotation are not supported, treated as "
+                    "relative.");
+    return ans;
+}
 
-std::string read_lib_name(spdlog::logger &logger, std::istream &stream);
+/** Reads the optional ELFLAGS, then the LAYER and the given data type record of an element.
+ *
+ *  This lets the caller skip the rest of an element on an unwanted layer with skip_element().
+ */
+template <record_type R, class S> gds_layer_t read_ele_layer(spdlog::logger &logger, S &stream) {
+    read_ele_flags(logger, stream);
+    auto glay = read_int<record_type::LAYER>(logger, stream);
+    auto gpurp = read_int<R>(logger, stream);
+    return {glay, gpurp};
+}
 
-void read_units(spdlog::logger &logger, std::istream &stream);
+/** Reads the rest of a TEXT element after read_ele_layer().
+ */
+template <class S>
+std::tuple<transformation, std::string, double>
+read_text_data(spdlog::logger &logger, S &stream, std::size_t &num_absolute) {
+    skip_optional(stream, {record_type::PRESENTATION, record_type::PATHTYPE, record_type::WIDTH});
+    auto[xform, mag] = read_transform_mag(logger, stream, num_absolute);
 
-std::string read_struct_name(spdlog::logger &logger, std::istream &stream);
+    auto text = std::string(read_name<record_type::STRING>(logger, stream));
+    read_ele_end(logger, stream);
 
-transformation read_transform(spdlog::logger &logger, std::istream &stream);
+    return {std::move(xform), std::move(text), mag};
+}
 
+template <class S>
 std::tuple<gds_layer_t, transformation, std::string, double> read_text(spdlog::logger &logger,
-                                                                       std::istream &stream);
+                                                                       S &stream) {
+    auto gds_key = read_ele_layer<record_type::TEXTTYPE>(logger, stream);
+    std::size_t num_absolute = 0;
+    auto[xform, text, mag] = read_text_data(logger, stream, num_absolute);
+    if (num_absolute > 0)
+        logger.warn("Absolute GDS magnification and rotation are not supported, treated as "
+                    "relative.");
+    return {gds_key, std::move(xform), std::move(text), mag};
+}
+
+template <class S>
+std::tuple<gds_layer_t, layout::polygon> read_box(spdlog::logger &logger, S &stream) {
+    read_ele_flags(logger, stream);
+    auto glay = read_int<record_type::LAYER>(logger, stream);
+    auto gpurp = read_int<record_type::BOXTYPE>(logger, stream);
+    check_record_header<record_type::XY, sizeof(int32_t), 10>(stream);
+
+    std::array<point, 5> pt_vec;
+    pt_vec[0] = read_point(stream);
+    pt_vec[1] = read_point(stream);
+    pt_vec[2] = read_point(stream);
+    pt_vec[3] = read_point(stream);
+    pt_vec[4] = read_point(stream);
+    read_ele_end(logger, stream);
+
+    layout::polygon poly;
+    poly.set(pt_vec.begin(), pt_vec.end());
+
+    return {gds_layer_t{glay, gpurp}, std::move(poly)};
+}
+
+template <class S>
+std::tuple<gds_layer_t, layout::polygon> read_boundary(spdlog::logger &logger, S &stream) {
+    read_ele_flags(logger, stream);
+    auto glay = read_int<record_type::LAYER>(logger, stream);
+    auto gpurp = read_int<record_type::DATATYPE>(logger, stream);
+    // divide by 2 to get number of points instead of number of coordinates.
+    auto num = check_record_header<record_type::XY, sizeof(int32_t)>(stream) / 2;
+
+    std::vector<point> pt_vec;
+    pt_vec.reserve(num);
+    for (decltype(num) idx = 0; idx < num; ++idx) {
+        pt_vec.push_back(read_point(stream));
+    }
+    read_ele_end(logger, stream);
+
+    layout::polygon poly;
+    poly.set(pt_vec.begin(), pt_vec.end());
+
+    return {gds_layer_t{glay, gpurp}, std::move(poly)};
+}
 
-std::tuple<gds_layer_t, layout::polygon> read_box(spdlog::logger &logger, std::istream &stream);
+/** The BOUNDARY and BOX elements of one GDS layer in a structure.
+ *
+ *  Rectangles are kept as boxes.  Other polygons are stored back to back in one point arena.
+ */
+struct gds_shape_buffer {
+    // if true, every element is stored with its points as read, in file order
+    bool keep_points = false;
+    std::vector<box_t> box_list;
+    std::vector<point> pt_list;
+    // the end of each polygon in pt_list
+    std::vector<std::size_t> poly_end_list;
+};
 
-std::tuple<gds_layer_t, layout::polygon> read_boundary(spdlog::logger &logger,
-                                                       std::istream &stream);
+using gds_shape_map = std::unordered_map<gds_layer_t, gds_shape_buffer, boost::hash<gds_layer_t>>;
 
-layout::instance read_instance(
-    spdlog::logger &logger, std::istream &stream, std::size_t &cnt,
-    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map);
+/** Returns the box if the points, with an optional closing point, form an axis-aligned rectangle.
+ */
+std::optional<box_t> get_rectangle(const point *pt_ptr, std::size_t num);
 
-layout::instance read_arr_instance(
-    spdlog::logger &logger, std::istream &stream, std::size_t &cnt,
-    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map);
+template <class S> void read_xy_shape(S &stream, std::size_t num, gds_shape_buffer &buf) {
+    auto start = buf.pt_list.size();
+    for (decltype(num) idx = 0; idx < num; ++idx) {
+        buf.pt_list.push_back(read_point(stream));
+    }
+    std::optional<box_t> box;
+    if (!buf.keep_points)
+        box = get_rectangle(buf.pt_list.data() + start, num);
+    if (box) {
+        buf.box_list.push_back(*box);
+        buf.pt_list.resize(start);
+    } else {
+        buf.poly_end_list.push_back(buf.pt_list.size());
+    }
+}
+
+/** Reads the rest of a BOX element after read_ele_layer() into the shape buffer of its layer.
+ */
+template <class S> void read_box_data(spdlog::logger &logger, S &stream, gds_shape_buffer &buf) {
+    check_record_header<record_type::XY, sizeof(int32_t), 10>(stream);
+    read_xy_shape(stream, 5, buf);
+    read_ele_end(logger, stream);
+}
+
+/** Reads the rest of a BOUNDARY element after read_ele_layer() into the shape buffer of its
+ *  layer.
+ */
+template <class S>
+void read_boundary_data(spdlog::logger &logger, S &stream, gds_shape_buffer &buf) {
+    auto num = check_record_header<record_type::XY, sizeof(int32_t)>(stream) / 2;
+    read_xy_shape(stream, num, buf);
+    read_ele_end(logger, stream);
+}
+
+/** A PATH element.
+ */
+struct gds_path {
+    uint16_t path_type = 0;
+    int32_t width = 0;
+    // the extensions of path type 4
+    int32_t bgn_extn = 0;
+    int32_t end_extn = 0;
+    std::vector<point> pt_list;
+};
+
+/** Reads the rest of a PATH element after read_ele_layer().
+ */
+template <class S> gds_path read_path_data(spdlog::logger &logger, S &stream) {
+    gds_path ans;
+    while (true) {
+        auto rec = std::get<0>(peek_record_header(stream));
+        if (rec == record_type::PATHTYPE) {
+            ans.path_type = read_int<record_type::PATHTYPE>(logger, stream);
+        } else if (rec == record_type::WIDTH) {
+            check_record_header<record_type::WIDTH, sizeof(int32_t), 1>(stream);
+            ans.width = read_bytes<int32_t>(stream);
+        } else if (rec == record_type::BGNEXTN) {
+            check_record_header<record_type::BGNEXTN, sizeof(int32_t), 1>(stream);
+            ans.bgn_extn = read_bytes<int32_t>(stream);
+        } else if (rec == record_type::ENDEXTN) {
+            check_record_header<record_type::ENDEXTN, sizeof(int32_t), 1>(stream);
+            ans.end_extn = read_bytes<int32_t>(stream);
+        } else {
+            break;
+        }
+    }
+
+    auto num = check_record_header<record_type::XY, sizeof(int32_t)>(stream) / 2;
+    ans.pt_list.reserve(num);
+    for (decltype(num) idx = 0; idx < num; ++idx) {
+        ans.pt_list.push_back(read_point(stream));
+    }
+    read_ele_end(logger, stream);
+
+    return ans;
+}
+
+template <class S>
+std::tuple<gds_layer_t, gds_path> read_path(spdlog::logger &logger, S &stream) {
+    auto gds_key = read_ele_layer<record_type::DATATYPE>(logger, stream);
+    return {gds_key, read_path_data(logger, stream)};
+}
+
+/** Reads the instance name property, and skips all other properties up to ENDEL.
+ */
+template <class S>
+std::string read_inst_name(spdlog::logger &logger, S &stream, std::size_t &cnt) {
+    std::string inst_name;
+    while (true) {
+        auto[rtype, rsize] = read_record_header(stream);
+        switch (rtype) {
+        case record_type::ENDEL:
+            if (inst_name.empty()) {
+                inst_name = "X" + std::to_string(cnt);
+                ++cnt;
+            }
+            return inst_name;
+        case record_type::PROPATTR: {
+            auto prop_code = read_bytes<uint16_t>(stream);
+            auto value = read_name<record_type::PROPVALUE>(logger, stream);
+            if (prop_code == PROP_INST_NAME)
+                inst_name = value;
+            break;
+        }
+        default:
+            throw std::runtime_error(fmt::format(
+                "Unexpected gds record type {} at end of instance.", static_cast<int>(rtype)));
+        }
+    }
+}
+
+/** Reads a SREF element.  Also returns the magnification, which the instance cannot represent.
+ */
+template <class S>
+std::tuple<layout::instance, double> read_instance(
+    spdlog::logger &logger, S &stream, std::size_t &cnt,
+    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map,
+    std::size_t &num_absolute) {
+    read_ele_flags(logger, stream);
+    auto cell_name = std::string(read_name<record_type::SNAME>(logger, stream));
+
+    auto iter = master_map.find(cell_name);
+    if (iter == master_map.end()) {
+        auto msg = fmt::format("Cannot find layout cellview {} in GDS file.", cell_name);
+        logger.error(msg);
+        throw std::runtime_error(msg);
+    }
+    auto master = iter->second;
+    auto[xform, mag] = read_transform_mag(logger, stream, num_absolute);
+    auto inst_name = read_inst_name(logger, stream, cnt);
+    return {layout::instance(std::move(inst_name), master, std::move(xform)), mag};
+}
+
+/** Reads an AREF element.  Also returns the magnification, which the instance cannot represent.
+ */
+template <class S>
+std::tuple<layout::instance, double> read_arr_instance(
+    spdlog::logger &logger, S &stream, std::size_t &cnt,
+    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map,
+    std::size_t &num_absolute) {
+    read_ele_flags(logger, stream);
+    auto cell_name = std::string(read_name<record_type::SNAME>(logger, stream));
+
+    auto iter = master_map.find(cell_name);
+    if (iter == master_map.end())
+        throw std::runtime_error(
+            fmt::format("Cannot find layout cellview {} in GDS file.", cell_name));
+    auto master = iter->second;
+
+    auto[xform, mag] = read_transform_info(logger, stream, num_absolute);
+
+    auto[gds_nx, gds_ny] = read_col_row(logger, stream);
+    check_record_header<record_type::XY, sizeof(int32_t), 6>(stream);
+    std::array<point, 3> pt_vec;
+    pt_vec[0] = read_point(stream);
+    pt_vec[1] = read_point(stream);
+    pt_vec[2] = read_point(stream);
+    auto inst_name = read_inst_name(logger, stream, cnt);
+
+    // the column and row vectors are relative to the origin, and rotated with the instance
+    auto inv_xform = get_invert(xform);
+    offset_t col_x = pt_vec[1][0] - pt_vec[0][0];
+    offset_t col_y = pt_vec[1][1] - pt_vec[0][1];
+    offset_t row_x = pt_vec[2][0] - pt_vec[0][0];
+    offset_t row_y = pt_vec[2][1] - pt_vec[0][1];
+    inv_xform.transform(col_x, col_y);
+    inv_xform.transform(row_x, row_y);
+    move_by(xform, pt_vec[0][0], pt_vec[0][1]);
+    auto gds_spx = col_x / static_cast<offset_t>(gds_nx);
+    auto gds_spy = row_y / static_cast<offset_t>(gds_ny);
+
+    auto[nx, ny, spx, spy] = cbag::convert_gds_array(xform, gds_nx, gds_ny, gds_spx, gds_spy);
+
+    return {layout::instance(std::move(inst_name), master, std::move(xform), nx, ny, spx, spy),
+            mag};
+}
 
 bool print_record(std::istream &stream);
 
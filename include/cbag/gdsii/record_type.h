@@ -21,6 +21,7 @@ enum class record_type : uint16_t {
     STRNAME = 0x0606,
     ENDSTR = 0x0700,
     BOUNDARY = 0x0800,
+    PATH = 0x0900,
     SREF = 0x0A00,
     AREF = 0x0B00,
     TEXT = 0x0C00,
@@ -31,16 +32,23 @@ enum class record_type : uint16_t {
     ENDEL = 0x1100,
     SNAME = 0x1206,
     COLROW = 0x1302,
+    NODE = 0x1500,
     TEXTTYPE = 0x1602,
     PRESENTATION = 0x1701,
     STRING = 0x1906,
     STRANS = 0x1A01,
     MAG = 0x1B05,
     ANGLE = 0x1C05,
+    PATHTYPE = 0x2102,
+    ELFLAGS = 0x2601,
+    NODETYPE = 0x2A02,
     PROPATTR = 0x2B02,
     PROPVALUE = 0x2C06,
     BOX = 0x2D00,
     BOXTYPE = 0x2E02,
+    PLEX = 0x2F03,
+    BGNEXTN = 0x3003,
+    ENDEXTN = 0x3103,
 };
 
 constexpr auto PROP_INST_NAME = 1;
@@ -65,6 +73,8 @@ inline std::string to_string(record_type rec) {
         return "ENDSTR";
     case record_type::BOUNDARY:
         return "BOUNDARY";
+    case record_type::PATH:
+        return "PATH";
     case record_type::SREF:
         return "SREF";
     case record_type::AREF:
@@ -85,6 +95,8 @@ inline std::string to_string(record_type rec) {
         return "SNAME";
     case record_type::COLROW:
         return "COLROW";
+    case record_type::NODE:
+        return "NODE";
     case record_type::TEXTTYPE:
         return "TEXTTYPE";
     case record_type::PRESENTATION:
@@ -97,6 +109,12 @@ inline std::string to_string(record_type rec) {
         return "MAG";
     case record_type::ANGLE:
         return "ANGLE";
+    case record_type::PATHTYPE:
+        return "PATHTYPE";
+    case record_type::ELFLAGS:
+        return "ELFLAGS";
+    case record_type::NODETYPE:
+        return "NODETYPE";
     case record_type::PROPATTR:
         return "PROPATTR";
     case record_type::PROPVALUE:
@@ -105,6 +123,12 @@ inline std::string to_string(record_type rec) {
         return "BOX";
     case record_type::BOXTYPE:
         return "BOXTYPE";
+    case record_type::PLEX:
+        return "PLEX";
+    case record_type::BGNEXTN:
+        return "BGNEXTN";
+    case record_type::ENDEXTN:
+        return "ENDEXTN";
     default:
         throw std::invalid_argument(
             fmt::format("Unknown record type: {:#06x}", static_cast<uint16_t>(rec)));
@@ -0,0 +1,57 @@
+#ifndef CBAG_GDSII_SCAN_H
+#define CBAG_GDSII_SCAN_H
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cbag/common/box_t.h>
+#include <cbag/enum/compress_type.h>
+#include <cbag/gdsii/cursor.h>
+#include <cbag/gdsii/read.h>
+#include <cbag/gdsii/typedefs.h>
+#include <cbag/logging/logging.h>
+
+namespace cbag {
+namespace gdsii {
+
+/** Summary of one GDS structure, gathered by scanning record headers without building a
+ *  cellview.
+ */
+struct gds_struct_summary {
+    std::string name;
+    gds_cell_stats stats;
+    // number of elements on each GDS layer/datatype, references excluded
+    std::map<gds_layer_t, std::size_t> layer_cnt;
+    // number of placements of each master, with arrays counted per element
+    std::map<std::string, uint64_t> ref_cnt;
+    // number of placements of this structure in other structures
+    uint64_t num_used = 0;
+    // number of reference levels below this structure, 0 for leaf structures
+    std::size_t depth = 0;
+    // number of boundaries, boxes and paths after flattening all references
+    uint64_t num_flat = 0;
+    // bounding box of all shapes after flattening, text and nodes excluded
+    box_t bbox = box_t::get_invalid_box();
+};
+
+/** Scans all structures of a GDS library, reading only the records needed for the summary.
+ *
+ *  The stream must be positioned after the library header.  Bounding boxes of non-Manhattan
+ *  paths are approximate.
+ */
+std::vector<gds_struct_summary> scan_gds_structs(spdlog::logger &logger, gds_cursor &stream);
+
+std::vector<gds_struct_summary> scan_gds_structs(spdlog::logger &logger, std::istream &stream);
+
+/** Scans a GDS file, which is memory mapped unless it is compressed.
+ */
+std::vector<gds_struct_summary> scan_gds(const std::string &fname,
+                                         compress_type comp = compress_type::AUTO);
+
+} // namespace gdsii
+} // namespace cbag
+
+#endif
@@ -5,15 +5,20 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <boost/container_hash/hash.hpp>
 
 #include <cbag/logging/logging.h>
 
+#include <cbag/util/compress.h>
 #include <cbag/util/io.h>
 
 #include <cbag/common/layer_t.h>
 #include <cbag/enum/boundary_type.h>
+#include <cbag/enum/compress_type.h>
 #include <cbag/gdsii/typedefs.h>
 #include <cbag/layout/cellview_fwd.h>
 #include <cbag/layout/tech.h>
@@ -28,16 +33,64 @@ class gds_lookup {
   private:
     layer_map lay_map;
     boundary_map bnd_map;
+    std::size_t rect_vertices = 0;
+    std::size_t min_array_size = 0;
+    std::unordered_set<std::string> struct_names;
 
   public:
     gds_lookup(const layout::tech &tech, const std::string &lay_map_file,
                const std::string &obj_map_file);
 
+    /** Write Manhattan polygons with at most this many vertices as rectangles, decomposed into
+     *  maximal horizontal slabs.  Larger polygons are kept whole.  0 writes all polygons as is.
+     */
+    void set_rect_vertices(std::size_t num) noexcept;
+
+    std::size_t get_rect_vertices() const noexcept;
+
+    /** Write vias and rectangles that repeat on a regular grid at least this many times as
+     *  references to generated cells, arrayed with AREFs.  This includes the cuts of a via.
+     *  Rectangles need at least 2 copies.  0 writes all vias and rectangles as boxes.
+     */
+    void set_min_array_size(std::size_t num) noexcept;
+
+    std::size_t get_min_array_size() const noexcept;
+
+    /** Records the name of a structure in the library.  Generated cells skip these names.
+     */
+    void add_struct_name(std::string name);
+
+    bool has_struct_name(const std::string &name) const;
+
     std::optional<gds_layer_t> get_gds_layer(layer_t key) const;
 
     std::optional<gds_layer_t> get_gds_layer(boundary_type bnd_type) const;
 };
 
+/** Finds cellviews with the same content as one seen before, by their content hash.
+ */
+class cell_merger {
+  private:
+    struct entry {
+        const layout::cellview *cv_ptr;
+        std::string cell_name;
+        // the structure names of the cellview's masters
+        layout::str_map_t rename_map;
+    };
+
+    std::unordered_map<std::size_t, std::vector<entry>> cell_map;
+
+  public:
+    /** Returns the structure name of an earlier cellview with the same content.  Otherwise,
+     *  records the cellview with the given structure name and returns nothing.
+     *
+     *  Instances are compared by the structure names of their masters, given by rename_map, so
+     *  cells must be added bottom-up for parents of merged cells to merge as well.
+     */
+    std::optional<std::string> add(const layout::cellview &cv, const std::string &cell_name,
+                                   const layout::str_map_t &rename_map);
+};
+
 std::vector<tval_t> get_gds_time();
 
 void write_gds_start(spdlog::logger &logger, std::ostream &stream, const std::string &lib_name,
@@ -50,36 +103,112 @@ void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std:
                         const std::unordered_map<std::string, std::string> &rename_map,
                         const std::vector<tval_t> &time_vec, const gds_lookup &lookup);
 
+/** Writes the cellviews as GDS structures, each given with its structure name, serializing them
+ *  into separate buffers with up to num_threads threads.
+ *
+ *  The buffers are written in list order, a batch at a time.  A cell sees the renames of the cells
+ *  before it only, like in write_gds_lib(), so the output is identical to the serial writer.  If
+ *  merge_cells is true, a cellview with the same content as an earlier one is not written, and
+ *  references to it use the structure of the earlier one.
+ */
+void write_lay_cellviews(
+    spdlog::logger &logger, std::ostream &stream,
+    const std::vector<std::pair<std::string, const layout::cellview *>> &cell_list,
+    const std::vector<tval_t> &time_vec, const gds_lookup &lookup, std::size_t num_threads,
+    bool merge_cells = false);
+
+/** Options of write_gds_lib() and implement_gds().  The defaults write every cellview as is.
+ */
+struct gds_write_options {
+    // compression of the file written by implement_gds()
+    compress_type comp = compress_type::AUTO;
+    // if more than 1, cellviews are serialized in parallel, see write_lay_cellviews()
+    std::size_t num_threads = 1;
+    // see gds_lookup::set_rect_vertices()
+    std::size_t rect_vertices = 0;
+    // see gds_lookup::set_min_array_size()
+    std::size_t min_array_size = 0;
+    // write cellviews with the same content as one structure, see write_lay_cellviews()
+    bool merge_cells = false;
+};
+
 template <class Vector>
-void implement_gds(const std::string &fname, const std::string &lib_name,
+void write_gds_lib(spdlog::logger &logger, std::ostream &stream, const std::string &lib_name,
                    const std::string &layer_map, const std::string &obj_map, double resolution,
-                   double user_unit, const Vector &cv_list) {
-    auto logger = get_cbag_logger();
+                   double user_unit, const Vector &cv_list,
+                   const gds_write_options &opts = gds_write_options()) {
     auto time_vec = get_gds_time();
-
-    // get gds file stream
-    auto stream = util::open_file_write(fname, true);
-    write_gds_start(*logger, stream, lib_name, resolution, user_unit, time_vec);
+    write_gds_start(logger, stream, lib_name, resolution, user_unit, time_vec);
 
     // get first element and setup gds_lookup
     auto cursor = cv_list.begin();
     auto stop = cv_list.end();
     if (cursor != stop) {
-        std::unordered_map<std::string, std::string> rename_map{};
         gds_lookup lookup{*cursor->second->get_tech(), layer_map, obj_map};
-        for (; cursor != stop; ++cursor) {
-            auto &[cv_cell_name, cv_ptr] = *cursor;
-            const auto &cell_name = cv_ptr->get_name();
-            logger->info("Creating layout cell {}", cv_cell_name);
-            write_lay_cellview(*logger, stream, cv_cell_name, *cv_ptr, rename_map, time_vec,
-                               lookup);
-            logger->info("cell name {} maps to {}", cell_name, cv_cell_name);
-            rename_map[cell_name] = cv_cell_name;
+        lookup.set_rect_vertices(opts.rect_vertices);
+        lookup.set_min_array_size(opts.min_array_size);
+        for (const auto &[cv_cell_name, cv_ptr] : cv_list) {
+            lookup.add_struct_name(cv_cell_name);
+        }
+        if (opts.num_threads > 1) {
+            std::vector<std::pair<std::string, const layout::cellview *>> cell_list;
+            for (; cursor != stop; ++cursor) {
+                auto &[cv_cell_name, cv_ptr] = *cursor;
+                logger.info("cell name {} maps to {}", cv_ptr->get_name(), cv_cell_name);
+                cell_list.emplace_back(cv_cell_name, &(*cv_ptr));
+            }
+            write_lay_cellviews(logger, stream, cell_list, time_vec, lookup, opts.num_threads,
+                                opts.merge_cells);
+        } else {
+            std::unordered_map<std::string, std::string> rename_map{};
+            cell_merger merger;
+            for (; cursor != stop; ++cursor) {
+                auto &[cv_cell_name, cv_ptr] = *cursor;
+                const auto &cell_name = cv_ptr->get_name();
+                if (opts.merge_cells) {
+                    if (auto merge_name = merger.add(*cv_ptr, cv_cell_name, rename_map)) {
+                        logger.info("Merging layout cell {} into {}", cv_cell_name, *merge_name);
+                        rename_map[cell_name] = *merge_name;
+                        continue;
+                    }
+                }
+                logger.info("Creating layout cell {}", cv_cell_name);
+                write_lay_cellview(logger, stream, cv_cell_name, *cv_ptr, rename_map, time_vec,
+                                   lookup);
+                logger.info("cell name {} maps to {}", cell_name, cv_cell_name);
+                rename_map[cell_name] = cv_cell_name;
+            }
         }
     }
 
-    write_gds_stop(*logger, stream);
-    stream.close();
+    write_gds_stop(logger, stream);
+}
+
+/** Writes the cellviews to a GDS file.  The file is gzip or zstd compressed if opts.comp says so,
+ *  or by default if the file name ends with .gz or .zst.
+ *
+ *  Records are encoded in memory and the file is written in large blocks.  See gds_write_options
+ *  for the other options.
+ */
+template <class Vector>
+void implement_gds(const std::string &fname, const std::string &lib_name,
+                   const std::string &layer_map, const std::string &obj_map, double resolution,
+                   double user_unit, const Vector &cv_list,
+                   const gds_write_options &opts = gds_write_options()) {
+    auto logger = get_cbag_logger();
+
+    auto comp = util::get_compress_type(fname, opts.comp);
+    if (comp == compress_type::NONE) {
+        util::block_ostream stream(fname);
+        write_gds_lib(*logger, stream, lib_name, layer_map, obj_map, resolution, user_unit,
+                      cv_list, opts);
+        stream.close();
+    } else {
+        util::compress_ostream stream(fname, comp);
+        write_gds_lib(*logger, stream, lib_name, layer_map, obj_map, resolution, user_unit,
+                      cv_list, opts);
+        stream.close();
+    }
 }
 
 } // namespace gdsii
@@ -2,11 +2,18 @@
 #ifndef CBAG_GDSII_WRITE_UTIL_H
 #define CBAG_GDSII_WRITE_UTIL_H
 
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <cbag/common/box_t.h>
+#include <cbag/common/point.h>
 #include <cbag/common/transformation.h>
+#include <cbag/enum/orientation.h>
+#include <cbag/gdsii/buffer.h>
 #include <cbag/gdsii/typedefs.h>
 #include <cbag/layout/polygon_fwd.h>
 #include <cbag/logging/logging.h>
@@ -23,42 +30,103 @@ template <typename T, util::IsUInt<T> = 0> void write_bytes(std::ostream &stream
     }
 }
 
-void write_header(spdlog::logger &logger, std::ostream &stream);
+/** Returns the rotation angle in degrees and the STRANS reflection bit of the orientation.
+ */
+std::tuple<uint32_t, uint16_t> get_angle_flag(orientation orient);
 
-void write_units(spdlog::logger &logger, std::ostream &stream, double resolution, double user_unit);
+void write_header(spdlog::logger &logger, gds_buffer &buf);
 
-void write_lib_begin(spdlog::logger &logger, std::ostream &stream,
-                     const std::vector<tval_t> &time_vec);
+void write_units(spdlog::logger &logger, gds_buffer &buf, double resolution, double user_unit);
 
-void write_lib_name(spdlog::logger &logger, std::ostream &stream, const std::string &name);
+void write_lib_begin(spdlog::logger &logger, gds_buffer &buf, const std::vector<tval_t> &time_vec);
 
-void write_lib_end(spdlog::logger &logger, std::ostream &stream);
+void write_lib_name(spdlog::logger &logger, gds_buffer &buf, const std::string &name);
 
-void write_struct_begin(spdlog::logger &logger, std::ostream &stream,
+void write_lib_end(spdlog::logger &logger, gds_buffer &buf);
+
+void write_struct_begin(spdlog::logger &logger, gds_buffer &buf,
                         const std::vector<tval_t> &time_vec);
 
-void write_struct_name(spdlog::logger &logger, std::ostream &stream, const std::string &name);
+void write_struct_name(spdlog::logger &logger, gds_buffer &buf, const std::string &name);
 
-void write_struct_end(spdlog::logger &logger, std::ostream &stream);
+void write_struct_end(spdlog::logger &logger, gds_buffer &buf);
 
-void write_transform(spdlog::logger &logger, std::ostream &stream, const transformation &xform,
+void write_transform(spdlog::logger &logger, gds_buffer &buf, const transformation &xform,
                      double mag = 1.0, cnt_t nx = 1, cnt_t ny = 1, offset_t spx = 0,
                      offset_t spy = 0);
 
-void write_polygon(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose,
+void write_polygon(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
                    const layout::polygon &poly);
 
-void write_box(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose,
+void write_box(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
                const box_t &box);
 
-void write_instance(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+/** Writes a SREF, or an AREF if nx or ny is more than 1.  The instance name property is omitted if
+ *  inst_name is empty.
+ */
+void write_instance(spdlog::logger &logger, gds_buffer &buf, const std::string &cell_name,
                     const std::string &inst_name, const transformation &xform, cnt_t nx = 1,
                     cnt_t ny = 1, offset_t spx = 0, offset_t spy = 0);
 
-void write_text(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose,
+void write_text(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
                 const std::string &text, const transformation &xform, offset_t height,
                 double resolution);
 
+/** Splits sorted distinct values into runs of constant pitch with at most max_num values each,
+ *  calling fun(start, num, pitch).  The pitch of a single value is 0.
+ */
+template <class F>
+void for_each_run(const std::vector<coord_t> &val_list, std::size_t max_num, F &&fun) {
+    std::size_t start = 0;
+    auto num = val_list.size();
+    while (start < num) {
+        auto stop = start + 1;
+        offset_t pitch = 0;
+        if (stop < num && max_num > 1) {
+            pitch = val_list[stop] - val_list[start];
+            for (++stop; stop < num && stop - start < max_num &&
+                         val_list[stop] - val_list[stop - 1] == pitch;
+                 ++stop) {
+            }
+        }
+        fun(val_list[start], static_cast<cnt_t>(stop - start), (stop - start > 1) ? pitch : 0);
+        start = stop;
+    }
+}
+
+/** Splits points into regular arrays with at most max_num columns and rows, calling
+ *  fun(origin, nx, ny, spx, spy).  Points on a regular pitch are combined into rows first, then
+ *  rows with the same columns on a regular pitch into arrays.  Duplicate points are dropped.
+ */
+template <class F> void for_each_array(std::vector<point> pt_list, std::size_t max_num, F &&fun) {
+    std::sort(pt_list.begin(), pt_list.end(), [](const point &lhs, const point &rhs) {
+        return std::tie(lhs[1], lhs[0]) < std::tie(rhs[1], rhs[0]);
+    });
+    pt_list.erase(std::unique(pt_list.begin(), pt_list.end()), pt_list.end());
+
+    // rows keyed by their first x, count and pitch, mapped to their y values
+    std::map<std::tuple<coord_t, cnt_t, offset_t>, std::vector<coord_t>> row_map;
+    std::vector<coord_t> x_list;
+    for (std::size_t start = 0; start < pt_list.size();) {
+        auto y = pt_list[start][1];
+        x_list.clear();
+        for (; start < pt_list.size() && pt_list[start][1] == y; ++start) {
+            x_list.push_back(pt_list[start][0]);
+        }
+        for_each_run(x_list, max_num, [&row_map, y](coord_t x0, cnt_t nx, offset_t spx) {
+            row_map[{x0, nx, spx}].push_back(y);
+        });
+    }
+
+    for (const auto &[row, y_list] : row_map) {
+        auto [x0, nx, spx] = row;
+        for_each_run(y_list, max_num,
+                     [&fun, x0 = x0, nx = nx, spx = spx](coord_t y0, cnt_t ny, offset_t spy) {
+                         fun(point{x0, y0}, nx, ny, spx, spy);
+                     });
+    }
+}
+
 } // namespace gdsii
 } // namespace cbag
 
@@ -4,6 +4,7 @@
 #include <memory>
 #include <unordered_map>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include <boost/container_hash/hash.hpp>
@@ -11,6 +12,7 @@
 #include <cbag/common/layer_t.h>
 #include <cbag/common/transformation_fwd.h>
 #include <cbag/enum/geometry_mode.h>
+#include <cbag/enum/index_algorithm.h>
 #include <cbag/layout/geo_index.h>
 #include <cbag/layout/geometry.h>
 #include <cbag/layout/instance.h>
@@ -36,13 +38,39 @@ using block_map_t = std::unordered_map<lay_t, std::vector<blockage>>;
 using pin_map_t = std::unordered_map<lay_t, std::vector<pin>>;
 using inst_map_t = std::unordered_map<std::string, instance>;
 
+class cellview;
+
+/** A shape whose geometry index entry is deferred until the index is needed.
+ */
+struct pending_shape {
+    layer_t key;
+    std::variant<box_t, polygon90, polygon45, polygon, polygon45_set> val;
+};
+
+/** An instance whose geometry index entry is deferred until the index is needed.
+ */
+struct pending_inst {
+    const cellview *master = nullptr;
+    transformation xform;
+    cnt_t nx = 1;
+    cnt_t ny = 1;
+    offset_t spx = 0;
+    offset_t spy = 0;
+};
+
+using pending_object = std::variant<pending_shape, pending_inst>;
+
 class cellview {
   private:
     cnt_t inst_name_cnt = 0;
     geometry_mode geo_mode = geometry_mode::POLY90;
+    index_algorithm idx_alg = index_algorithm::QUADRATIC;
+    std::size_t idx_max_elements = 32;
+    bool lazy_index = false;
     std::shared_ptr<const routing_grid> grid_ptr = nullptr;
     std::string cell_name;
     std::vector<std::shared_ptr<geo_index>> index_list;
+    mutable std::vector<std::vector<pending_object>> pending_list;
     geo_map_t geo_map;
     inst_map_t inst_map;
     pin_map_t pin_map;
@@ -51,6 +79,8 @@ class cellview {
     std::vector<blockage> area_block_list;
     std::vector<boundary> boundary_list;
     std::vector<label> label_list;
+    // sum of the hashes of all added objects, so it is independent of the order they are added
+    std::size_t content_hash = 0;
 
     struct helper;
 
@@ -60,8 +90,38 @@ class cellview {
 
     bool operator==(const cellview &rhs) const noexcept;
 
+    /** Returns true if the two cellviews have the same content, ignoring the cell name.
+     */
+    bool has_same_content(const cellview &rhs) const noexcept;
+
+    /** Returns a hash of the cellview content, ignoring the cell name.
+     *
+     *  The hash is updated as objects are added or removed, so it costs nothing to get.  Cellviews
+     *  with the same content have the same hash if their shapes were added the same way, as
+     *  overlapping shapes are not merged first.  Use has_same_content() to confirm a match.
+     */
+    std::size_t get_hash() const noexcept;
+
+    /** Like has_same_content(), but compares instance masters by their cell names after each
+     *  cellview's rename map, so cellviews whose masters are merged into one cell are the same.
+     */
+    bool has_same_content(const cellview &rhs, const str_map_t &rename_map,
+                          const str_map_t &rhs_rename_map) const noexcept;
+
+    /** Like get_hash(), but hashes instance masters by their cell names after the rename map.
+     */
+    std::size_t get_hash(const str_map_t &rename_map) const noexcept;
+
     void set_geometry_mode(geometry_mode new_mode);
 
+    /** Sets the R-tree split algorithm and maximum node size of the geometry indices.
+     */
+    void set_index_algorithm(index_algorithm alg, std::size_t max_elements = 32);
+
+    index_algorithm get_index_algorithm() const noexcept;
+
+    std::size_t get_index_max_elements() const noexcept;
+
     auto find_geometry(layer_t key) const -> decltype(geo_map.find(key));
 
     const std::string &get_name() const noexcept;
@@ -70,7 +130,31 @@ class cellview {
 
     bool empty() const noexcept;
 
+    /** Returns the geometry index of the given level.
+     *
+     *  With lazy indexing, the first call for a level inserts all pending objects, so it must not
+     *  be made concurrently.  Call finalize() before sharing the cellview between threads.
+     */
     const std::shared_ptr<geo_index> &get_geo_index(level_t lev) const;
+
+    /** Defer geometry indexing until get_geo_index() is called for a level.
+     *
+     *  Useful for cellviews that are only written out and never queried.  Shapes added while lazy
+     *  indexing is enabled have no handles, so they cannot be removed or updated.  Disabling lazy
+     *  indexing indexes all pending objects.
+     */
+    void set_lazy_index(bool enable);
+
+    bool is_lazy_index() const noexcept;
+
+    /** Build the geometry indices of all levels from their staging buffers.
+     */
+    void finalize();
+
+    /** Keep flattened copies of the geometry indices, for cellviews instantiated many times.
+     */
+    void enable_flat_cache();
+
     auto begin_inst() const -> decltype(inst_map.cbegin());
     auto end_inst() const -> decltype(inst_map.cend());
     auto begin_geometry() const -> decltype(geo_map.cbegin());
@@ -97,11 +181,28 @@ class cellview {
     void add_object(boundary &&obj);
     void add_object(const via_wrapper &obj);
     void add_object(const instance &obj);
-    void add_shape(layer_t key, const box_t &obj);
-    void add_shape(layer_t key, const polygon90 &obj);
-    void add_shape(layer_t key, const polygon45 &obj);
-    void add_shape(layer_t key, const polygon &obj);
+    geo_handle add_shape(layer_t key, const box_t &obj);
+    geo_handle add_shape(layer_t key, const polygon90 &obj);
+    geo_handle add_shape(layer_t key, const polygon45 &obj);
+    geo_handle add_shape(layer_t key, const polygon &obj);
     void add_shape(layer_t key, const polygon45_set &obj);
+
+    /** Adds many rectangles on the same layer.  Faster than adding them one by one, but returns
+     *  no handles.
+     */
+    void add_shapes(layer_t key, const std::vector<box_t> &obj_list);
+
+    /** Removes a shape returned by add_shape(), keeping the layer geometry consistent.
+     *
+     *  Returns false if the shape was already removed.  Only shapes on layers with a routing
+     *  level can be removed, as other shapes are not indexed.
+     */
+    bool remove_shape(layer_t key, const geo_handle &h);
+
+    geo_handle update_shape(layer_t key, const geo_handle &h, const box_t &obj);
+    geo_handle update_shape(layer_t key, const geo_handle &h, const polygon90 &obj);
+    geo_handle update_shape(layer_t key, const geo_handle &h, const polygon45 &obj);
+    geo_handle update_shape(layer_t key, const geo_handle &h, const polygon &obj);
     void add_warr(const track_id &tid, std::array<offset_t, 2> coord);
 };
 
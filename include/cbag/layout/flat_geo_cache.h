@@ -0,0 +1,66 @@
+#ifndef CBAG_LAYOUT_FLAT_GEO_CACHE_H
+#define CBAG_LAYOUT_FLAT_GEO_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <cbag/common/box_t.h>
+#include <cbag/common/transformation.h>
+#include <cbag/layout/geo_index.h>
+
+namespace cbag {
+namespace layout {
+
+class geo_iterator;
+class geo_view;
+
+/** All geometries in a geo_index hierarchy, flattened into the coordinate system of the index.
+ *
+ *  Bounding boxes are stored as separate coordinate arrays, so candidates are found with a scan
+ *  over contiguous memory instead of an R-tree traversal.  Only the bounding boxes are searched
+ *  in bulk: the query box is moved into the cache's coordinates, and the transformation to the
+ *  query coordinates is applied to a hit only when it is returned.  The geometries are copied,
+ *  and the versions of all masters are recorded, so a cache never refers to objects of another
+ *  index and can tell when it is out of date.
+ */
+class flat_geo_cache {
+  private:
+    std::vector<coord_t> xl_list;
+    std::vector<coord_t> yl_list;
+    std::vector<coord_t> xh_list;
+    std::vector<coord_t> yh_list;
+    std::vector<geo_object> obj_list;
+    std::vector<cbag::transformation> xform_list;
+    uint64_t version = 0;
+    std::vector<geo_master_version> master_list;
+
+  public:
+    flat_geo_cache();
+
+    /** Collects all geometries returned by the given iterator, which traverses an index at the
+     *  given version with the given masters.
+     */
+    flat_geo_cache(geo_iterator iter, uint64_t version, std::vector<geo_master_version> masters);
+
+    std::size_t size() const;
+
+    /** Returns true if the index is still at the given version, and no master has changed.
+     */
+    bool is_current(uint64_t cur_version) const;
+
+    /** Returns the index of the first geometry at or after start whose bounding box, including
+     *  spacing margins, intersects the box, or size() if there is none.
+     */
+    std::size_t find_next(std::size_t start, const box_t &r) const;
+
+    /** Returns true if the geometry overlaps the box, which is in the coordinates of the cache.
+     */
+    bool intersects(std::size_t idx, const box_t &r, offset_t spx, offset_t spy) const;
+
+    geo_view get_view(std::size_t idx, const cbag::transformation &xform) const;
+};
+
+} // namespace layout
+} // namespace cbag
+
+#endif
@@ -1,41 +1,186 @@
 #ifndef CBAG_LAYOUT_GEO_INDEX_H
 #define CBAG_LAYOUT_GEO_INDEX_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <cbag/common/box_t.h>
 #include <cbag/common/layer_t.h>
 #include <cbag/common/transformation_fwd.h>
 #include <cbag/layout/geo_index_impl.h>
 #include <cbag/layout/polygon45_set_fwd.h>
 
 namespace cbag {
-
-class box_t;
-
 namespace layout {
 
 class tech;
+class flat_geo_cache;
+class geo_index;
 class geo_iterator;
+class geo_view;
+
+// a master in a geo_index hierarchy, with its version when a flat_geo_cache was built
+using geo_master_version = std::pair<std::shared_ptr<const geo_index>, uint64_t>;
 
+/** A single query window of geo_index::query_batch().
+ */
+struct geo_query {
+    box_t box;
+    offset_t spx = 0;
+    offset_t spy = 0;
+};
+
+/** A stable reference to an object inserted in a geo_index.
+ */
+struct geo_handle {
+    geo_id_t id = 0;
+    bg_box bnd_box;
+
+    bool is_valid() const { return id != 0; }
+};
+
+/** A spatial index of all geometries on a single routing level.
+ *
+ *  New objects are collected in a staging buffer, and are only added to the R-tree when the
+ *  index is finalized, either explicitly or on the first query.  An empty R-tree is built from
+ *  the staging buffer with the packing algorithm, which is much faster than inserting objects one
+ *  at a time and also produces a tree that is faster to query.
+ *
+ *  All const methods may be called concurrently.  The staging buffer is flushed under a lock, and
+ *  a finalized index is never modified by queries.  Inserting objects is not thread-safe.
+ */
 class geo_index {
   public:
     using const_iterator = geo_iterator;
 
   private:
-    geo_index_impl index;
+    // the members below are only modified by flush() while holding flush_lock
+    mutable geo_index_impl index;
+    mutable std::vector<geo_object> staged;
+    mutable std::shared_ptr<const flat_geo_cache> flat_cache;
+    mutable std::mutex flush_lock;
+    mutable std::atomic<bool> dirty = false;
+    bool use_flat_cache = false;
+    geo_id_t next_id = 0;
+    // incremented whenever an object is inserted or removed
+    uint64_t version = 0;
+
+    void flush() const;
+
+    geo_handle insert_object(geo_object &&obj);
+
+    void add_masters(std::vector<geo_master_version> &ans) const;
+
+    std::shared_ptr<const flat_geo_cache> make_flat_cache() const;
 
   public:
-    geo_index();
+    explicit geo_index(index_algorithm alg = index_algorithm::QUADRATIC,
+                       std::size_t max_elements = 32);
+
+    index_algorithm get_algorithm() const;
+
+    std::size_t get_max_elements() const;
 
     bool empty() const;
 
+    bool is_finalized() const;
+
+    /** Returns a counter that changes whenever an object is inserted or removed.
+     */
+    uint64_t get_version() const;
+
     box_t get_bbox() const;
 
+    geo_query_iter begin_query(const box_t &r, offset_t spx, offset_t spy) const;
+
+    geo_query_iter begin_nearest(const box_t &r) const;
+
     const_iterator begin_intersect(const box_t &r, offset_t spx, offset_t spy,
                                    const cbag::transformation &xform) const;
 
-    void insert(const std::shared_ptr<const geo_index> &master, const cbag::transformation &xform);
+    /** Finds the geometries intersecting each of the given query windows.
+     *
+     *  Returns one list of hits per query, in the same order as the queries.  Nearby queries are
+     *  grouped so that each group shares a single traversal of the hierarchy.  If num_threads is
+     *  greater than 1, groups are processed in parallel.
+     */
+    std::vector<std::vector<geo_view>> query_batch(const std::vector<geo_query> &queries,
+                                                   const cbag::transformation &xform,
+                                                   std::size_t num_threads = 1) const;
+
+    /** Finds all geometries intersecting the box, using num_threads threads.
+     *
+     *  The box is split into a grid of tiles that are queried in parallel.  A geometry that
+     *  intersects several tiles is only reported by the first one, so the result is the same as
+     *  iterating over begin_intersect(), up to ordering.
+     */
+    std::vector<geo_view> query_tiled(const box_t &r, offset_t spx, offset_t spy,
+                                      const cbag::transformation &xform,
+                                      std::size_t num_threads) const;
+
+    /** Returns the k geometries closest to the box, in increasing distance order.
+     *
+     *  Distances are euclidean, and are measured to each geometry grown by its spacing margins.
+     *  The search is best-first across the instance hierarchy, with bounding boxes as lower bounds,
+     *  so only the parts of the hierarchy that can contain one of the results are visited, and
+     *  only polygons whose bounding box is close enough are measured exactly.
+     */
+    std::vector<geo_view> get_nearest(const box_t &r, std::size_t k,
+                                      const cbag::transformation &xform) const;
+
+    /** Returns the distance from the box to the closest geometry, or infinity if there is none.
+     */
+    double get_min_distance(const box_t &r) const;
+
+    void finalize();
+
+    /** Keep a flattened copy of all geometries in this hierarchy.
+     *
+     *  Queries that reach an instance of this index then scan the flattened copy instead of
+     *  traversing the hierarchy.  Intended for small masters that are instantiated many times.  The
+     *  copy is rebuilt on the next query after this index or any of its masters changes.
+     */
+    void enable_flat_cache();
+
+    /** Returns the flattened copy of this hierarchy, rebuilding it if it is out of date, or nullptr
+     *  if the flat cache is not enabled.
+     */
+    std::shared_ptr<const flat_geo_cache> get_flat_cache() const;
+
+    geo_handle insert(const std::shared_ptr<const geo_index> &master,
+                      const cbag::transformation &xform, cnt_t nx = 1, cnt_t ny = 1,
+                      offset_t spx = 0, offset_t spy = 0);
+
+    template <typename T>
+    geo_handle insert(T &&obj, offset_t spx, offset_t spy, layer_t key = {0, 0}) {
+        return insert_object(geo_object(std::forward<T>(obj), spx, spy, key, ++next_id));
+    }
+
+    /** Returns the object referenced by the handle, or nullptr if it was removed.
+     */
+    const geo_object *find(const geo_handle &h) const;
+
+    /** Removes the object referenced by the handle.  Returns false if it was already removed.
+     */
+    bool remove(const geo_handle &h);
 
-    template <typename T> void insert(T &&obj, offset_t spx, offset_t spy) {
-        index.insert(geo_object(std::forward<T>(obj), spx, spy));
+    /** Replaces the object referenced by the handle, keeping its layer and id.
+     *
+     *  Returns the updated handle.  Throws std::invalid_argument if the object was removed.
+     */
+    template <typename T>
+    geo_handle update(const geo_handle &h, T &&obj, offset_t spx, offset_t spy) {
+        auto old_obj = find(h);
+        if (!old_obj)
+            throw std::invalid_argument("Cannot update a removed geo_index object.");
+        auto key = old_obj->key;
+        remove(h);
+        return insert_object(geo_object(std::forward<T>(obj), spx, spy, key, h.id));
     }
 };
 
@@ -1,8 +1,16 @@
 #ifndef CBAG_LAYOUT_GEO_INDEX_IMPL_H
 #define CBAG_LAYOUT_GEO_INDEX_IMPL_H
 
+#include <array>
+#include <iterator>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <boost/geometry/index/detail/rtree/utilities/view.hpp>
 #include <boost/geometry/index/rtree.hpp>
 
+#include <cbag/enum/index_algorithm.h>
 #include <cbag/layout/geo_object.h>
 
 namespace bgi = boost::geometry::index;
@@ -10,8 +18,180 @@ namespace bgi = boost::geometry::index;
 namespace cbag {
 namespace layout {
 
-using geo_index_impl = bgi::rtree<geo_object, bgi::quadratic<32, 16>>;
-using geo_query_iter = geo_index_impl::const_query_iterator;
+// the default tree, with its node size fixed at compile time so that Boost can unroll node scans
+using geo_rtree_default = bgi::rtree<geo_object, bgi::quadratic<32, 16>>;
+using geo_rtree_linear = bgi::rtree<geo_object, bgi::dynamic_linear>;
+using geo_rtree_quadratic = bgi::rtree<geo_object, bgi::dynamic_quadratic>;
+using geo_rtree_rstar = bgi::rtree<geo_object, bgi::dynamic_rstar>;
+
+/** An incremental intersection query that walks the nodes of an R-tree.
+ *
+ *  This visits the same objects in the same order as the tree's query iterator, but the path to
+ *  the current leaf is kept in a fixed array instead of a type-erased heap object, so starting,
+ *  copying and advancing a query does not allocate unless the tree is deeper than num_inline
+ *  internal levels.
+ */
+template <class Tree>
+class geo_rtree_query
+    : public bgi::detail::rtree::utilities::view<Tree>::members_holder::visitor_const {
+  public:
+    // number of internal levels stored inside the query
+    static constexpr std::size_t num_inline = 6;
+
+  private:
+    using members_holder = typename bgi::detail::rtree::utilities::view<Tree>::members_holder;
+    using internal_node = typename members_holder::internal_node;
+    using leaf = typename members_holder::leaf;
+    using internal_iterator =
+        typename bgi::detail::rtree::elements_type<internal_node>::type::const_iterator;
+    using leaf_iterator = typename bgi::detail::rtree::elements_type<leaf>::type::const_iterator;
+    // the next child of an internal node to visit, and the end of its children
+    using level = std::pair<internal_iterator, internal_iterator>;
+
+    bg_box box;
+    std::array<level, num_inline> stack;
+    std::vector<level> heap_stack;
+    std::size_t depth = 0;
+    leaf_iterator cur = {};
+    leaf_iterator end = {};
+
+    level &get_level(std::size_t idx) {
+        return (idx < num_inline) ? stack[idx] : heap_stack[idx - num_inline];
+    }
+
+    // advance to the next object that intersects the box, starting at cur
+    void search_value() {
+        while (true) {
+            for (; cur != end; ++cur) {
+                if (bg::intersects(box, cur->bnd_box))
+                    return;
+            }
+            if (depth == 0) {
+                cur = end = leaf_iterator();
+                return;
+            }
+            auto &top = get_level(depth - 1);
+            if (top.first == top.second) {
+                --depth;
+            } else {
+                auto child = top.first++;
+                if (bg::intersects(box, child->first))
+                    bgi::detail::rtree::apply_visitor(*this, *child->second);
+            }
+        }
+    }
+
+  public:
+    geo_rtree_query() = default;
+
+    geo_rtree_query(const Tree &tree, const bg_box &box) : box(box) {
+        bgi::detail::rtree::utilities::view<Tree> tree_view(tree);
+        tree_view.apply_visitor(*this);
+        search_value();
+    }
+
+    void operator()(const internal_node &n) {
+        auto &elements = bgi::detail::rtree::elements(n);
+        // heap levels are kept when popped, so they can be reused
+        if (depth >= num_inline && heap_stack.size() == depth - num_inline)
+            heap_stack.emplace_back();
+        get_level(depth++) = {elements.begin(), elements.end()};
+    }
+
+    void operator()(const leaf &n) {
+        auto &elements = bgi::detail::rtree::elements(n);
+        cur = elements.begin();
+        end = elements.end();
+    }
+
+    bool is_end() const { return cur == end; }
+
+    const geo_object &operator*() const { return *cur; }
+
+    geo_rtree_query &operator++() {
+        ++cur;
+        search_value();
+        return *this;
+    }
+
+    bool operator==(const geo_rtree_query &rhs) const { return cur == rhs.cur; }
+};
+
+/** An R-tree query iterator for any of the supported split algorithms.
+ *
+ *  Intersection queries use geo_rtree_query, and nearest queries use the tree's own iterator.  A
+ *  default constructed iterator is the end iterator.
+ */
+class geo_query_iter {
+  private:
+    std::variant<std::monostate, geo_rtree_query<geo_rtree_default>,
+                 geo_rtree_query<geo_rtree_linear>, geo_rtree_query<geo_rtree_quadratic>,
+                 geo_rtree_query<geo_rtree_rstar>, geo_rtree_default::const_query_iterator,
+                 geo_rtree_linear::const_query_iterator, geo_rtree_quadratic::const_query_iterator,
+                 geo_rtree_rstar::const_query_iterator>
+        val;
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = geo_object;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const geo_object *;
+    using reference = const geo_object &;
+
+    geo_query_iter();
+
+    template <class Tree>
+    explicit geo_query_iter(geo_rtree_query<Tree> &&iter) : val(std::move(iter)) {}
+
+    explicit geo_query_iter(geo_rtree_default::const_query_iterator &&iter);
+    explicit geo_query_iter(geo_rtree_linear::const_query_iterator &&iter);
+    explicit geo_query_iter(geo_rtree_quadratic::const_query_iterator &&iter);
+    explicit geo_query_iter(geo_rtree_rstar::const_query_iterator &&iter);
+
+    bool is_end() const;
+
+    geo_query_iter &operator++();
+    reference operator*() const;
+    pointer operator->() const;
+    bool operator==(const geo_query_iter &rhs) const;
+    bool operator!=(const geo_query_iter &rhs) const;
+};
+
+/** The R-tree of a geo_index, with the split algorithm and node size chosen at runtime.
+ *
+ *  The default, a quadratic tree with 32 elements per node, uses compile time parameters like
+ *  before the algorithm was configurable, so the default index pays nothing for the choice.
+ */
+class geo_index_impl {
+  private:
+    std::variant<geo_rtree_default, geo_rtree_linear, geo_rtree_quadratic, geo_rtree_rstar> tree;
+
+  public:
+    explicit geo_index_impl(index_algorithm alg = index_algorithm::QUADRATIC,
+                            std::size_t max_elements = 32);
+
+    index_algorithm get_algorithm() const;
+
+    std::size_t get_max_elements() const;
+
+    bool empty() const;
+
+    std::size_t size() const;
+
+    bg_box bounds() const;
+
+    geo_query_iter qbegin_intersects(const bg_box &r) const;
+
+    geo_query_iter qbegin_nearest(const bg_box &r, std::size_t k) const;
+
+    void insert(const std::vector<geo_object> &obj_list);
+
+    bool remove(const geo_object &obj);
+
+    /** Rebuilds the tree from its current content and the new objects with the packing algorithm.
+     */
+    void rebuild(std::vector<geo_object> &&obj_list);
+};
 
 } // namespace layout
 } // namespace cbag
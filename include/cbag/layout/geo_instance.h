@@ -1,6 +1,7 @@
 #ifndef CBAG_LAYOUT_GEO_INSTANCE_H
 #define CBAG_LAYOUT_GEO_INSTANCE_H
 
+#include <array>
 #include <memory>
 
 #include <cbag/common/transformation.h>
@@ -11,24 +12,49 @@ class box_t;
 
 namespace layout {
 
-class geo_iterator;
 class geo_index;
 
+/** An index entry representing an instance, or an array of instances, of a master geo_index.
+ *
+ *  Array element (ix, iy) is placed at xform shifted by (ix * spx, iy * spy).  The bounding box
+ *  covers the whole array, so an array of any size is a single R-tree entry.
+ */
 class geo_instance {
   private:
     std::shared_ptr<const geo_index> master = nullptr;
     transformation xform;
+    cnt_t nx = 1;
+    cnt_t ny = 1;
+    offset_t spx = 0;
+    offset_t spy = 0;
 
   public:
     geo_instance();
 
-    geo_instance(std::shared_ptr<const geo_index> master, transformation xform);
+    geo_instance(std::shared_ptr<const geo_index> master, transformation xform, cnt_t nx = 1,
+                 cnt_t ny = 1, offset_t spx = 0, offset_t spy = 0);
 
     bool empty() const;
 
+    const std::shared_ptr<const geo_index> &get_master() const;
+
+    const transformation &get_xform() const;
+
+    cnt_t get_nx() const;
+
+    cnt_t get_ny() const;
+
+    transformation get_xform(cnt_t ix, cnt_t iy) const;
+
     box_t get_bbox() const;
 
-    geo_iterator begin_intersect(const box_t &r, offset_t spx, offset_t spy) const;
+    /** Returns the bounding box of the array elements in the given column and row ranges.
+     */
+    box_t get_bbox(const std::array<std::array<cnt_t, 2>, 2> &range) const;
+
+    /** Returns the [start, stop) column and row ranges of array elements intersecting the box.
+     */
+    std::array<std::array<cnt_t, 2>, 2> get_index_range(const box_t &r) const;
 
     bool operator==(const geo_instance &rhs) const;
 };
@@ -1,16 +1,21 @@
 #ifndef CBAG_LAYOUT_GEO_ITERATOR_H
 #define CBAG_LAYOUT_GEO_ITERATOR_H
 
+#include <array>
 #include <iterator>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <cbag/common/box_t.h>
+#include <cbag/common/transformation.h>
 #include <cbag/layout/geo_index_impl.h>
 
 namespace cbag {
 namespace layout {
 
+class flat_geo_cache;
+
 enum geo_union_enum : enum_t {
     RECT = 0,
     POLY90 = 1,
@@ -33,36 +38,118 @@ class geo_union {
     geo_union_enum index() const { return static_cast<geo_union_enum>(val.index()); }
 };
 
+/** A lightweight reference to a geometry found by a geo_iterator.
+ *
+ *  The view only stores a pointer to the object in the index and the transformation from the
+ *  object's cellview to the query coordinate system.  The geometry is only copied and transformed
+ *  when get_union() is called.
+ */
+class geo_view {
+  private:
+    const geo_object *obj = nullptr;
+    cbag::transformation xform;
+
+  public:
+    geo_view();
+
+    geo_view(const geo_object *obj, cbag::transformation xform);
+
+    geo_union_enum index() const;
+
+    const geo_object &get_object() const;
+
+    const cbag::transformation &get_xform() const;
+
+    box_t get_bbox() const;
+
+    /** Returns the bounding box including spacing margins.
+     */
+    box_t get_bnd_box() const;
+
+    /** Returns true if the geometry overlaps the box, using the same spacing rules as
+     *  geo_index::begin_intersect().
+     */
+    bool intersects(const box_t &r, offset_t spx, offset_t spy) const;
+
+    geo_union get_union() const;
+};
+
+/** An input iterator over all geometries in a geo_index that intersect a box.
+ *
+ *  The hierarchy is traversed with a stack of query frames, where each frame stores the
+ *  transformation from its cellview to the query coordinate system.  The first frames are stored
+ *  inline, and deeper hierarchies spill to the heap.  Copies only copy the frames in use.  Only the
+ *  elements of an instance array that overlap the query box are visited, and masters with a
+ *  flat_geo_cache are scanned directly instead of being traversed.
+ */
 class geo_iterator {
   public:
-    using flat_geo_type = geo_union;
+    using flat_geo_type = geo_view;
     using iterator_category = std::input_iterator_tag;
-    using value_type = const flat_geo_type;
+    using value_type = flat_geo_type;
     using difference_type = std::ptrdiff_t;
-    using pointer = value_type *;
-    using reference = value_type &;
+    using pointer = const value_type *;
+    using reference = value_type;
+
+    // number of frames stored inside the iterator
+    static constexpr std::size_t num_inline = 8;
+
+    /** The value of an iterator before a postfix increment.
+     */
+    class postfix_proxy {
+      private:
+        value_type val;
+
+      public:
+        explicit postfix_proxy(value_type val) : val(std::move(val)) {}
+
+        value_type operator*() const { return val; }
+    };
 
   private:
-    box_t box;
-    offset_t spx = 0;
-    offset_t spy = 0;
-    geo_query_iter cur;
-    geo_query_iter end;
-    cbag::transformation xform;
-    std::shared_ptr<geo_iterator> inner = nullptr;
-    flat_geo_type cur_val;
+    struct frame {
+        geo_query_iter cur;
+        cbag::transformation xform;
+        box_t box;
+        offset_t spx = 0;
+        offset_t spy = 0;
+        // the instance array at cur that is being expanded, and the next element to visit
+        const geo_instance *inst = nullptr;
+        std::array<cnt_t, 2> inst_idx = {0, 0};
+        std::array<std::array<cnt_t, 2>, 2> inst_range = {};
+        // if not null, scan this flattened master instead of the R-tree query
+        std::shared_ptr<const flat_geo_cache> flat;
+        std::size_t flat_idx = 0;
+    };
+
+    std::array<frame, num_inline> stack;
+    std::vector<frame> heap_stack;
+    std::size_t depth = 0;
     struct helper;
 
+    frame &get_frame(std::size_t idx);
+
+    const frame &get_frame(std::size_t idx) const;
+
+    // adds a frame to the top of the stack and returns it
+    frame &push_frame();
+
+    void assign_frames(const geo_iterator &rhs);
+
   public:
     geo_iterator();
 
     geo_iterator(const box_t &box, offset_t spx, offset_t spy, geo_query_iter &&cur,
-                 geo_query_iter &&end, const cbag::transformation &xform);
+                 const cbag::transformation &xform);
+
+    geo_iterator(const geo_iterator &rhs);
+
+    geo_iterator &operator=(const geo_iterator &rhs);
 
     bool has_next() const;
 
     geo_iterator &operator++();
-    geo_iterator operator++(int);
+    postfix_proxy operator++(int);
     reference operator*() const;
     bool operator==(const geo_iterator &rhs) const;
     bool operator!=(const geo_iterator &rhs) const;
@@ -1,12 +1,14 @@
 #ifndef CBAG_LAYOUT_GEO_OBJECT_H
 #define CBAG_LAYOUT_GEO_OBJECT_H
 
+#include <cstdint>
 #include <variant>
 
 #include <boost/geometry.hpp>
 #include <boost/polygon/polygon.hpp>
 
 #include <cbag/common/box_t.h>
+#include <cbag/common/layer_t.h>
 #include <cbag/common/typedefs.h>
 #include <cbag/layout/geo_instance.h>
 #include <cbag/layout/polygon.h>
@@ -20,6 +22,7 @@ namespace layout {
 
 using bg_point = bg::model::point<coord_t, 2, bg::cs::cartesian>;
 using bg_box = bg::model::box<bg_point>;
+using geo_id_t = uint64_t;
 
 class geo_object {
   public:
@@ -31,8 +34,13 @@ class geo_object {
     offset_t spx = 0;
     offset_t spy = 0;
     box_type bnd_box;
+    // the layer of a shape, used to keep per-layer geometries consistent on removal
+    layer_t key = {0, 0};
+    // unique within a geo_index, 0 if not assigned
+    geo_id_t id = 0;
 
-    template <typename T> geo_object(T &&v, offset_t spx, offset_t spy);
+    template <typename T>
+    geo_object(T &&v, offset_t spx, offset_t spy, layer_t key = {0, 0}, geo_id_t id = 0);
 
     bool operator==(const geo_object &v) const;
 
@@ -42,8 +50,9 @@ class geo_object {
 bg_box get_bnd_box(const geo_object::value_type &val, offset_t spx, offset_t spy);
 
 template <typename T>
-geo_object::geo_object(T &&v, offset_t spx, offset_t spy)
-    : val(std::forward<T>(v)), spx(spx), spy(spy), bnd_box(get_bnd_box(val, spx, spy)) {}
+geo_object::geo_object(T &&v, offset_t spx, offset_t spy, layer_t key, geo_id_t id)
+    : val(std::forward<T>(v)), spx(spx), spy(spy), bnd_box(get_bnd_box(val, spx, spy)), key(key),
+      id(id) {}
 
 } // namespace layout
 } // namespace cbag
@@ -58,6 +67,16 @@ template <> struct indexable<cbag::layout::geo_object> {
     result_type operator()(const cbag::layout::geo_object &v) const { return v.bnd_box; }
 };
 
+// objects are removed from the R-tree by id, so identical shapes are distinguished
+template <> struct equal_to<cbag::layout::geo_object> {
+    using result_type = bool;
+
+    bool operator()(const cbag::layout::geo_object &lhs,
+                    const cbag::layout::geo_object &rhs) const {
+        return lhs.id == rhs.id;
+    }
+};
+
 } // namespace index
 } // namespace geometry
 } // namespace boost
@@ -53,6 +53,16 @@ class geometry {
     void add_shape(const polygon &obj);
     void add_shape(const polygon45_set &obj);
 
+    void add_shapes(const std::vector<box_t> &obj_list);
+
+    /** Subtracts the area of the shape.  Other shapes overlapping it must be added back.
+     */
+    void remove_shape(const geo_object::value_type &obj);
+
+    /** Returns the Manhattan polygon set, or nullptr if the geometry is not in POLY90 mode.
+     */
+    const polygon90_set *get_polygon90_set() const noexcept;
+
     template <typename T> void write_geometry(T &output) const {
         std::visit(
             overload{
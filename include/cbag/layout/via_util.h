@@ -24,9 +24,9 @@ template <typename It> void get_via_cuts(const via &v, It out_iter) {
 
     offset_t dx = -xoff;
     box_t cut_box{0, 0, static_cast<coord_t>(vw), static_cast<coord_t>(vh)};
-    for (std::decay_t<decltype(nx)> xidx = 0; xidx != nx; ++xidx, dx += spx) {
+    for (std::decay_t<decltype(nx)> xidx = 0; xidx != nx; ++xidx, dx += vw + spx) {
         offset_t dy = -yoff;
-        for (std::decay_t<decltype(ny)> yidx = 0; yidx != ny; ++yidx, dy += spy) {
+        for (std::decay_t<decltype(ny)> yidx = 0; yidx != ny; ++yidx, dy += vh + spy) {
             *out_iter = get_move_by(get_transform(cut_box, v.xform), dx, dy);
             ++out_iter;
         }
@@ -13,6 +13,12 @@ std::shared_ptr<spdlog::logger> get_bag_logger();
 
 std::shared_ptr<spdlog::logger> get_cbag_logger();
 
+/** Returns a logger with the same sinks, level and name, that can be used from several threads.
+ *
+ *  The cbag logger sinks are not thread safe, so worker threads log through a locking sink.
+ */
+std::shared_ptr<spdlog::logger> make_worker_logger(spdlog::logger &logger);
+
 } // namespace cbag
 
 #endif
@@ -0,0 +1,101 @@
+#ifndef CBAG_OASIS_IO_UTIL_H
+#define CBAG_OASIS_IO_UTIL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cbag/common/point.h>
+#include <cbag/common/typedefs.h>
+#include <cbag/oasis/record_type.h>
+
+namespace cbag {
+namespace oasis {
+
+/** A bounds-checked read position in OASIS data held in memory.
+ */
+class oas_cursor {
+  private:
+    const char *cur = nullptr;
+    const char *stop = nullptr;
+
+  public:
+    oas_cursor(const char *data, std::size_t size) : cur(data), stop(data + size) {}
+
+    bool empty() const noexcept { return cur == stop; }
+
+    uint8_t read_byte();
+
+    std::string_view read_chars(std::size_t n);
+};
+
+/** An OASIS repetition, either a regular array along the x and y axes or a list of offsets.
+ */
+struct oas_repetition {
+    cnt_t nx = 1;
+    cnt_t ny = 1;
+    offset_t spx = 0;
+    offset_t spy = 0;
+    // the offsets of all elements, starting with (0, 0), if the repetition is not regular
+    std::vector<point> offset_list;
+
+    bool is_regular() const noexcept { return offset_list.empty(); }
+
+    bool is_single() const noexcept { return is_regular() && nx == 1 && ny == 1; }
+
+    std::vector<point> get_offsets() const;
+};
+
+uint64_t read_uint(oas_cursor &cur);
+
+int64_t read_sint(oas_cursor &cur);
+
+double read_real(oas_cursor &cur);
+
+/** Reads a real number whose type was already read, as in property values.
+ */
+double read_real(oas_cursor &cur, uint64_t type);
+
+std::string_view read_string(oas_cursor &cur);
+
+/** Reads a point list, returning the vertices relative to the first one at (0, 0).
+ *
+ *  Polygon point lists of type 0 and 1 imply one extra vertex that closes the polygon with
+ *  manhattan edges.
+ */
+std::vector<point> read_point_list(oas_cursor &cur, bool is_polygon);
+
+/** Reads a repetition.  Type 0 returns a copy of last.
+ */
+oas_repetition read_repetition(oas_cursor &cur, const oas_repetition &last);
+
+/** Decompresses the data of a CBLOCK record, the cursor is positioned after its record ID.
+ */
+std::string read_cblock(oas_cursor &cur);
+
+void write_byte(std::string &buf, uint8_t val);
+
+void write_uint(std::string &buf, uint64_t val);
+
+void write_sint(std::string &buf, int64_t val);
+
+void write_real(std::string &buf, double val);
+
+void write_string(std::string &buf, std::string_view val);
+
+/** Writes a point list for vertices relative to the first one at (0, 0), using the most compact
+ *  of the manhattan, octangular or all-angle forms.
+ */
+void write_point_list(std::string &buf, const std::vector<point> &pt_list);
+
+void write_repetition(std::string &buf, const oas_repetition &rep);
+
+/** Compresses the data into a CBLOCK record.
+ */
+void write_cblock(std::string &buf, std::string_view data);
+
+} // namespace oasis
+} // namespace cbag
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef CBAG_OASIS_READ_H
+#define CBAG_OASIS_READ_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cbag/logging/logging.h>
+
+#include <cbag/util/mmap_file.h>
+
+#include <cbag/gdsii/read.h>
+#include <cbag/layout/cellview.h>
+#include <cbag/layout/routing_grid_fwd.h>
+#include <cbag/layout/tech.h>
+
+namespace cbag {
+namespace oasis {
+
+/** Parses OASIS data held in memory, returning all cellviews in file order.
+ *
+ *  Layers are mapped with the same GDS layer/datatype map files as GDS.  Circles and compact
+ *  trapezoids are skipped, and text labels have no orientation or height.
+ */
+std::vector<std::shared_ptr<layout::cellview>>
+read_oas(spdlog::logger &logger, std::string_view data, const gdsii::gds_rlookup &rmap,
+         const std::shared_ptr<const layout::routing_grid> &g);
+
+/** Reads all cellviews of an OASIS file, in file order.
+ */
+template <class OutIter>
+void read_oas(const std::string &fname, const std::string &layer_map, const std::string &obj_map,
+              const std::shared_ptr<const layout::routing_grid> &g, OutIter &&out_iter) {
+    auto log_ptr = get_cbag_logger();
+
+    log_ptr->info("Reading OASIS file {}", fname);
+    util::mmap_file file(fname);
+    gdsii::gds_rlookup rmap(layer_map, obj_map, *(g->get_tech()));
+    auto cv_list = read_oas(*log_ptr, std::string_view(file.data(), file.size()), rmap, g);
+    for (auto &cv_ptr : cv_list) {
+        *out_iter = std::move(cv_ptr);
+        ++out_iter;
+    }
+    log_ptr->info("Finish reading OASIS file {}", fname);
+}
+
+} // namespace oasis
+} // namespace cbag
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef CBAG_OASIS_RECORD_TYPE_H
+#define CBAG_OASIS_RECORD_TYPE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cbag {
+namespace oasis {
+
+enum class record_type : uint8_t {
+    PAD = 0,
+    START = 1,
+    END = 2,
+    CELLNAME_IMPLICIT = 3,
+    CELLNAME = 4,
+    TEXTSTRING_IMPLICIT = 5,
+    TEXTSTRING = 6,
+    PROPNAME_IMPLICIT = 7,
+    PROPNAME = 8,
+    PROPSTRING_IMPLICIT = 9,
+    PROPSTRING = 10,
+    LAYERNAME = 11,
+    LAYERNAME_TEXT = 12,
+    CELL_REF = 13,
+    CELL = 14,
+    XYABSOLUTE = 15,
+    XYRELATIVE = 16,
+    PLACEMENT = 17,
+    PLACEMENT_MAG = 18,
+    TEXT = 19,
+    RECTANGLE = 20,
+    POLYGON = 21,
+    PATH = 22,
+    TRAPEZOID = 23,
+    TRAPEZOID_A = 24,
+    TRAPEZOID_B = 25,
+    CTRAPEZOID = 26,
+    CIRCLE = 27,
+    PROPERTY = 28,
+    PROPERTY_REPEAT = 29,
+    XNAME_IMPLICIT = 30,
+    XNAME = 31,
+    XELEMENT = 32,
+    XGEOMETRY = 33,
+    CBLOCK = 34,
+};
+
+constexpr auto MAGIC = "%SEMI-OASIS\r\n";
+constexpr std::size_t MAGIC_SIZE = 13;
+constexpr auto VERSION = "1.0";
+// the END record is padded to this size
+constexpr std::size_t END_SIZE = 256;
+// the property holding instance names of placements
+constexpr auto PROP_INST_NAME = "CBAG_INST_NAME";
+
+} // namespace oasis
+} // namespace cbag
+
+#endif
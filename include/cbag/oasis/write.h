@@ -0,0 +1,79 @@
+#ifndef CBAG_OASIS_WRITE_H
+#define CBAG_OASIS_WRITE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <cbag/logging/logging.h>
+
+#include <cbag/util/io.h>
+
+#include <cbag/gdsii/write.h>
+#include <cbag/layout/cellview_fwd.h>
+
+namespace cbag {
+namespace oasis {
+
+using cell_ref_map = std::unordered_map<std::string, uint64_t>;
+
+void write_oas_start(std::ostream &stream, double resolution, double user_unit);
+
+/** Writes the CELLNAME records of all referenced cells, then the END record.
+ */
+void write_oas_stop(std::ostream &stream, const cell_ref_map &ref_map);
+
+/** Writes a cellview as a CELL record, in a CBLOCK if compress is true.  ref_map gives the
+ *  reference numbers of cell names, new names are added to it.
+ */
+void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+                        const layout::cellview &cv,
+                        const std::unordered_map<std::string, std::string> &rename_map,
+                        cell_ref_map &ref_map, const gdsii::gds_lookup &lookup, bool compress);
+
+template <class Vector>
+void write_oas_lib(spdlog::logger &logger, std::ostream &stream, const std::string &layer_map,
+                   const std::string &obj_map, double resolution, double user_unit,
+                   const Vector &cv_list, bool compress) {
+    write_oas_start(stream, resolution, user_unit);
+
+    cell_ref_map ref_map;
+    auto cursor = cv_list.begin();
+    auto stop = cv_list.end();
+    if (cursor != stop) {
+        std::unordered_map<std::string, std::string> rename_map{};
+        gdsii::gds_lookup lookup{*cursor->second->get_tech(), layer_map, obj_map};
+        for (; cursor != stop; ++cursor) {
+            auto &[cv_cell_name, cv_ptr] = *cursor;
+            const auto &cell_name = cv_ptr->get_name();
+            logger.info("Creating layout cell {}", cv_cell_name);
+            write_lay_cellview(logger, stream, cv_cell_name, *cv_ptr, rename_map, ref_map, lookup,
+                               compress);
+            logger.info("cell name {} maps to {}", cell_name, cv_cell_name);
+            rename_map[cell_name] = cv_cell_name;
+        }
+    }
+
+    write_oas_stop(stream, ref_map);
+}
+
+/** Writes the cellviews to an OASIS file, with the same layer and object maps as GDS.
+ *
+ *  Rectangles on a regular pitch, including via cuts, are written as arrays, and each cell is
+ *  deflate compressed in a CBLOCK unless compress is false.
+ */
+template <class Vector>
+void implement_oas(const std::string &fname, const std::string &layer_map,
+                   const std::string &obj_map, double resolution, double user_unit,
+                   const Vector &cv_list, bool compress = true) {
+    auto logger = get_cbag_logger();
+
+    auto stream = util::open_file_write(fname, true);
+    write_oas_lib(*logger, stream, layer_map, obj_map, resolution, user_unit, cv_list, compress);
+    stream.close();
+}
+
+} // namespace oasis
+} // namespace cbag
+
+#endif
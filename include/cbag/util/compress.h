@@ -0,0 +1,126 @@
+#ifndef CBAG_UTIL_COMPRESS_H
+#define CBAG_UTIL_COMPRESS_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cbag/enum/compress_type.h>
+
+namespace cbag {
+namespace util {
+
+/** Returns the given compression, or the one implied by the file extension (.gz or .zst) if it
+ *  is AUTO.
+ */
+compress_type get_compress_type(const std::string &fname,
+                                compress_type type = compress_type::AUTO);
+
+/** A read buffer over a compressed file.
+ *
+ *  A background thread reads and decompresses the file in chunks, so decompression overlaps with
+ *  parsing.  Seeking is only supported within the current chunk, which is enough to peek at a
+ *  record header.
+ */
+class decompress_buf : public std::streambuf {
+  private:
+    std::ifstream file;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::vector<char>> queue;
+    bool done = false;
+    bool stop = false;
+    std::exception_ptr error;
+    std::vector<char> cur;
+    // the stream position of eback()
+    std::size_t base_pos = 0;
+    std::thread worker;
+
+    void run(compress_type type);
+
+    bool push(std::vector<char> &&chunk);
+
+  protected:
+    int_type underflow() override;
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which) override;
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+  public:
+    decompress_buf(const std::string &fname, compress_type type);
+
+    decompress_buf(const decompress_buf &) = delete;
+    decompress_buf &operator=(const decompress_buf &) = delete;
+
+    ~decompress_buf() override;
+};
+
+class encoder;
+
+/** A write buffer that compresses its data into a file.
+ */
+class compress_buf : public std::streambuf {
+  private:
+    std::ofstream file;
+    std::unique_ptr<encoder> enc;
+    std::vector<char> in_buf;
+    std::string out_buf;
+    bool closed = false;
+
+    void write_out(bool last);
+
+  protected:
+    int_type overflow(int_type c) override;
+
+    int sync() override;
+
+  public:
+    compress_buf(const std::string &fname, compress_type type);
+
+    compress_buf(const compress_buf &) = delete;
+    compress_buf &operator=(const compress_buf &) = delete;
+
+    ~compress_buf() override;
+
+    /** Finishes the compressed stream and closes the file.
+     */
+    void close();
+};
+
+/** An input stream over a gzip or zstd compressed file.  Errors are thrown, not flagged.
+ */
+class decompress_istream : public std::istream {
+  private:
+    decompress_buf buf;
+
+  public:
+    decompress_istream(const std::string &fname, compress_type type);
+};
+
+/** An output stream into a gzip or zstd compressed file.  Errors are thrown, not flagged.
+ */
+class compress_ostream : public std::ostream {
+  private:
+    compress_buf buf;
+
+  public:
+    compress_ostream(const std::string &fname, compress_type type);
+
+    void close();
+};
+
+} // namespace util
+} // namespace cbag
+
+#endif
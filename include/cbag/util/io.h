@@ -3,7 +3,9 @@
 
 #include <filesystem>
 #include <fstream>
+#include <ostream>
 #include <string>
+#include <vector>
 
 namespace cbag {
 namespace util {
@@ -24,6 +26,23 @@ std::filesystem::path get_canonical_path(std::string fname);
 
 std::filesystem::path join(const std::string &first, const std::string &second);
 
+/** A binary output file stream that writes its data in large blocks, so few system calls are
+ *  made for files written in many small pieces.  Errors on open, write and close are thrown.
+ */
+class block_ostream : public std::ostream {
+  private:
+    std::vector<char> block;
+    std::filebuf buf;
+
+  public:
+    explicit block_ostream(const std::string &fname, std::size_t block_size = 1 << 20);
+
+    block_ostream(const block_ostream &) = delete;
+    block_ostream &operator=(const block_ostream &) = delete;
+
+    void close();
+};
+
 } // namespace util
 // namespace util
 } // namespace cbag
@@ -11,6 +11,14 @@ namespace util {
 // ceiling division
 inline constexpr int ceil(int x, unsigned int y) { return x / y + (x % y > 0); }
 
+// floor division, rounds towards negative infinity
+inline constexpr int64_t floor_div(int64_t x, int64_t y) {
+    return x / y - ((x % y != 0) && ((x < 0) != (y < 0)));
+}
+
+// ceiling division, rounds towards positive infinity
+inline constexpr int64_t ceil_div(int64_t x, int64_t y) { return -floor_div(-x, y); }
+
 // only works on arithmetic right shift architectures
 inline constexpr int floor2(int a) { return a >> 1; }
 
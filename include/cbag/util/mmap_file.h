@@ -0,0 +1,34 @@
+#ifndef CBAG_UTIL_MMAP_FILE_H
+#define CBAG_UTIL_MMAP_FILE_H
+
+#include <string>
+
+namespace cbag {
+namespace util {
+
+/** A read-only memory mapping of a whole file.
+ */
+class mmap_file {
+  private:
+    const char *ptr = nullptr;
+    std::size_t num_bytes = 0;
+
+  public:
+    explicit mmap_file(const std::string &fname);
+
+    mmap_file(const mmap_file &) = delete;
+    mmap_file &operator=(const mmap_file &) = delete;
+    mmap_file(mmap_file &&other) noexcept;
+    mmap_file &operator=(mmap_file &&other) noexcept;
+
+    ~mmap_file();
+
+    const char *data() const noexcept;
+
+    std::size_t size() const noexcept;
+};
+
+} // namespace util
+} // namespace cbag
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef CBAG_UTIL_PARALLEL_H
+#define CBAG_UTIL_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cbag {
+namespace util {
+
+/** A set of worker threads that run submitted tasks in order.
+ *
+ *  Threads are started when the pool grows and are joined when it is destroyed, so repeated
+ *  parallel loops do not pay for thread creation.
+ */
+class thread_pool {
+  private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    mutable std::mutex lock;
+    std::condition_variable cond;
+    bool stopping = false;
+
+    void run();
+
+  public:
+    explicit thread_pool(std::size_t num_threads = 0);
+
+    thread_pool(const thread_pool &) = delete;
+
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    ~thread_pool();
+
+    std::size_t size() const;
+
+    /** Starts more workers so that there are at least num_threads of them.
+     */
+    void reserve(std::size_t num_threads);
+
+    void submit(std::function<void()> task);
+
+    /** Returns the pool used by parallel_for(), created on first use.
+     */
+    static thread_pool &get_default();
+};
+
+/** Calls fun(idx) for every idx in [0, n) using up to num_threads threads of the pool.
+ *
+ *  The calling thread is one of the workers, so num_threads <= 1 runs everything serially.  Work
+ *  items are handed out one at a time, so expensive and cheap items can be mixed freely.  The
+ *  first exception thrown by fun is re-thrown on the calling thread after all workers finish.
+ *  Helpers that have not started when the calling thread runs out of work are skipped, so nested
+ *  calls cannot deadlock the pool.
+ */
+template <class F>
+void parallel_for(thread_pool &pool, std::size_t n, std::size_t num_threads, F &&fun) {
+    num_threads = std::min(num_threads, n);
+    if (num_threads <= 1) {
+        for (std::size_t idx = 0; idx < n; ++idx) {
+            fun(idx);
+        }
+        return;
+    }
+
+    // helpers may start after this call returns, so they share the state with a shared_ptr
+    struct job_state {
+        std::atomic<std::size_t> next{0};
+        std::exception_ptr err = nullptr;
+        std::mutex lock;
+        std::condition_variable cond;
+        std::size_t num_active = 0;
+        bool done = false;
+    };
+    auto job = std::make_shared<job_state>();
+    auto work = [&fun, n](job_state &state) {
+        try {
+            for (auto idx = state.next++; idx < n; idx = state.next++) {
+                fun(idx);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(state.lock);
+            if (!state.err)
+                state.err = std::current_exception();
+            state.next = n;
+        }
+    };
+
+    pool.reserve(num_threads - 1);
+    for (std::size_t idx = 1; idx < num_threads; ++idx) {
+        pool.submit([job, &work]() {
+            {
+                std::lock_guard<std::mutex> guard(job->lock);
+                if (job->done)
+                    return;
+                ++job->num_active;
+            }
+            work(*job);
+            std::lock_guard<std::mutex> guard(job->lock);
+            if (--job->num_active == 0)
+                job->cond.notify_all();
+        });
+    }
+    work(*job);
+
+    std::unique_lock<std::mutex> guard(job->lock);
+    job->done = true;
+    job->cond.wait(guard, [&job]() { return job->num_active == 0; });
+    if (job->err)
+        std::rethrow_exception(job->err);
+}
+
+template <class F> void parallel_for(std::size_t n, std::size_t num_threads, F &&fun) {
+    parallel_for(thread_pool::get_default(), n, num_threads, std::forward<F>(fun));
+}
+
+} // namespace util
+} // namespace cbag
+
+#endif
@@ -105,7 +105,8 @@ transformation get_transform_by(transformation xform, const transformation &rhs)
 
 std::tuple<cnt_t, cnt_t, offset_t, offset_t> convert_array(const transformation &xform, cnt_t nx,
                                                            cnt_t ny, offset_t spx, offset_t spy) {
-    get_invert(xform).transform(spx, spy);
+    // pitches are vectors, so only the orientation applies
+    get_invert(make_xform(0, 0, orient(xform))).transform(spx, spy);
     return (flips_xy(xform)) ? std::make_tuple(ny, nx, spx, spy)
                              : std::make_tuple(nx, ny, spx, spy);
 }
@@ -113,7 +114,7 @@ std::tuple<cnt_t, cnt_t, offset_t, offset_t> convert_array(const transformation
 std::tuple<cnt_t, cnt_t, offset_t, offset_t> convert_gds_array(const transformation &xform,
                                                                cnt_t gds_nx, cnt_t gds_ny,
                                                                offset_t gds_spx, offset_t gds_spy) {
-    xform.transform(gds_spx, gds_spy);
+    make_xform(0, 0, orient(xform)).transform(gds_spx, gds_spy);
     return (flips_xy(xform)) ? std::make_tuple(gds_ny, gds_nx, gds_spx, gds_spy)
                              : std::make_tuple(gds_nx, gds_ny, gds_spx, gds_spy);
 }
@@ -0,0 +1,97 @@
+#include <fmt/core.h>
+
+#include <cbag/gdsii/library.h>
+#include <cbag/layout/routing_grid.h>
+#include <cbag/util/compress.h>
+
+namespace cbag {
+namespace gdsii {
+
+// the library needs random access into the file, so it cannot stream compressed data
+const std::string &check_uncompressed(const std::string &fname) {
+    if (util::get_compress_type(fname) != compress_type::NONE)
+        throw std::invalid_argument("GDS library requires an uncompressed file: " + fname);
+    return fname;
+}
+
+gds_library::gds_library(const std::string &fname, const std::string &layer_map,
+                         const std::string &obj_map, std::shared_ptr<const layout::routing_grid> g)
+    : file(check_uncompressed(fname)), grid(std::move(g)),
+      rmap(layer_map, obj_map, *(grid->get_tech())) {
+    auto log_ptr = get_cbag_logger();
+    log_ptr->info("Indexing GDS file {}", fname);
+
+    gds_cursor stream(file.data(), file.size());
+    lib_name = read_gds_start(*log_ptr, stream);
+    info_list = index_gds_structs(*log_ptr, stream);
+    for (std::size_t idx = 0; idx < info_list.size(); ++idx) {
+        idx_map.emplace(info_list[idx].name, idx);
+    }
+}
+
+const std::string &gds_library::get_lib_name() const noexcept { return lib_name; }
+
+std::vector<std::string> gds_library::get_cell_names() const {
+    std::vector<std::string> ans;
+    ans.reserve(info_list.size());
+    for (const auto &info : info_list) {
+        ans.push_back(info.name);
+    }
+    return ans;
+}
+
+bool gds_library::has_cell(const std::string &cell_name) const {
+    return idx_map.find(cell_name) != idx_map.end();
+}
+
+bool gds_library::is_loaded(const std::string &cell_name) const {
+    return cv_map.find(cell_name) != cv_map.end();
+}
+
+std::size_t gds_library::get_num_loaded() const noexcept { return cv_map.size(); }
+
+std::shared_ptr<const layout::cellview> gds_library::get_cellview(const std::string &cell_name,
+                                                                  std::size_t num_threads) {
+    auto cv_iter = cv_map.find(cell_name);
+    if (cv_iter != cv_map.end())
+        return cv_iter->second;
+
+    auto log_ptr = get_cbag_logger();
+    auto idx_iter = idx_map.find(cell_name);
+    if (idx_iter == idx_map.end()) {
+        auto msg = fmt::format("Cannot find layout cellview {} in GDS file.", cell_name);
+        log_ptr->error(msg);
+        throw std::runtime_error(msg);
+    }
+
+    // collect the structure and all its masters that are not loaded yet
+    std::vector<gds_struct_info> todo_list;
+    std::vector<bool> visited(info_list.size(), false);
+    std::vector<std::size_t> stack{idx_iter->second};
+    visited[idx_iter->second] = true;
+    while (!stack.empty()) {
+        auto idx = stack.back();
+        stack.pop_back();
+        todo_list.push_back(info_list[idx]);
+        for (const auto &master_name : info_list[idx].master_list) {
+            if (is_loaded(master_name))
+                continue;
+            auto iter = idx_map.find(master_name);
+            if (iter != idx_map.end() && !visited[iter->second]) {
+                visited[iter->second] = true;
+                stack.push_back(iter->second);
+            }
+        }
+    }
+
+    log_ptr->info("Loading {} GDS cellviews for {}", todo_list.size(), cell_name);
+    auto new_list =
+        read_gds_structs(*log_ptr, todo_list, lib_name, grid, rmap, num_threads, cv_map);
+    for (std::size_t idx = 0; idx < todo_list.size(); ++idx) {
+        cv_map.emplace(todo_list[idx].name, std::move(new_list[idx]));
+    }
+    return cv_map[cell_name];
+}
+
+} // namespace gdsii
+} // namespace cbag
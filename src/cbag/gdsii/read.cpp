@@ -1,10 +1,17 @@
+#include <algorithm>
+#include <cmath>
+
 #include <fmt/core.h>
 
 #include <cbag/util/overload.h>
 
+#include <cbag/common/box_t_util.h>
+#include <cbag/util/parallel.h>
+
 #include <cbag/gdsii/parse_map.h>
 #include <cbag/gdsii/read.h>
 #include <cbag/gdsii/read_util.h>
+#include <cbag/layout/path_util.h>
 
 namespace cbag {
 namespace gdsii {
@@ -67,12 +74,33 @@ layer_t gds_rlookup::get_layer_t(gds_layer_t key) const {
     return iter->second;
 }
 
-std::string read_gds_start(spdlog::logger &logger, std::istream &stream) {
-    read_header(logger, stream);
-    read_lib_begin(logger, stream);
-    auto ans = read_lib_name(logger, stream);
-    read_units(logger, stream);
-    return ans;
+void gds_rlookup::set_layer_filter(const std::vector<layer_t> &layer_list) {
+    gds_layer_set gds_layers;
+    for (const auto &[gds_key, key] : lay_map) {
+        if (std::find(layer_list.begin(), layer_list.end(), key) != layer_list.end())
+            gds_layers.insert(gds_key);
+    }
+    filter = std::move(gds_layers);
+}
+
+void gds_rlookup::set_gds_layer_filter(gds_layer_set gds_layers) { filter = std::move(gds_layers); }
+
+bool gds_rlookup::is_wanted(gds_layer_t key) const {
+    return !filter || filter->find(key) != filter->end() || bnd_map.find(key) != bnd_map.end();
+}
+
+void log_cell_stats(spdlog::logger &logger, const std::string &cell_name,
+                    const gds_cell_stats &stats, std::size_t num_bytes,
+                    std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+    logger.info("Read GDS cellview {}: {} boxes, {} boundaries, {} paths, {} instances, {} texts, "
+                "{} nodes, {} skipped by layer, {} bytes in {:.3f} s.",
+                cell_name, stats.num_box, stats.num_boundary, stats.num_path, stats.num_inst,
+                stats.num_text, stats.num_node, stats.num_skip, num_bytes, diff.count());
+    if (stats.num_absolute > 0)
+        logger.warn("GDS cellview {}: {} elements use absolute magnification or rotation, which "
+                    "are not supported and treated as relative.",
+                    cell_name, stats.num_absolute);
 }
 
 void add_object(spdlog::logger &logger, layout::cellview &ans, gds_layer_t &&gds_key,
@@ -95,56 +123,308 @@ void add_object(spdlog::logger &logger, layout::cellview &ans, gds_layer_t &&gds
         map_val);
 }
 
-std::tuple<std::string, std::shared_ptr<layout::cellview>> read_lay_cellview(
-    spdlog::logger &logger, std::istream &stream, const std::string &lib_name,
-    const std::shared_ptr<const layout::routing_grid> &g, const gds_rlookup &rmap,
-    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map) {
-    auto cell_name = read_struct_name(logger, stream);
+gds_shape_buffer &get_shape_buffer(gds_shape_map &shape_map, gds_layer_t key,
+                                   const gds_rlookup &rmap) {
+    auto [iter, inserted] = shape_map.try_emplace(key);
+    if (inserted)
+        iter->second.keep_points = std::holds_alternative<boundary_type>(rmap.get_mapping(key));
+    return iter->second;
+}
 
-    logger.info("GDS cellview name: " + cell_name);
+void add_shapes(spdlog::logger &logger, layout::cellview &ans, const gds_shape_map &shape_map,
+                const gds_rlookup &rmap) {
+    for (const auto & [ gds_key, buf ] : shape_map) {
+        auto for_each_poly = [&buf](auto &&fun) {
+            std::size_t start = 0;
+            for (auto stop : buf.poly_end_list) {
+                layout::polygon poly;
+                poly.set(buf.pt_list.begin() + start, buf.pt_list.begin() + stop);
+                fun(std::move(poly));
+                start = stop;
+            }
+        };
 
-    auto cv_ptr = std::make_shared<layout::cellview>(g, cell_name, geometry_mode::POLY);
-    auto resolution = g->get_tech()->get_resolution();
-    auto inst_cnt = static_cast<std::size_t>(0);
+        std::visit(
+            overload{
+                [&ans, &buf, &for_each_poly](layer_t k) {
+                    ans.add_shapes(k, buf.box_list);
+                    for_each_poly([&ans, &k](layout::polygon &&poly) { ans.add_shape(k, poly); });
+                },
+                [&ans, &buf, &for_each_poly](boundary_type k) {
+                    // only readers that do not use get_shape_buffer() have boxes here
+                    for (const auto &box : buf.box_list) {
+                        std::array<point, 4> pt_vec = {point{xl(box), yl(box)},
+                                                       point{xh(box), yl(box)},
+                                                       point{xh(box), yh(box)},
+                                                       point{xl(box), yh(box)}};
+                        layout::boundary bnd{k};
+                        bnd.set(pt_vec.begin(), pt_vec.end());
+                        ans.add_object(std::move(bnd));
+                    }
+                    for_each_poly([&ans, &k](layout::polygon &&poly) {
+                        layout::boundary bnd{k};
+                        bnd.set(poly.begin(), poly.end());
+                        ans.add_object(std::move(bnd));
+                    });
+                },
+                [&logger, &gds_key = gds_key](bool k) {
+                    logger.warn("Cannot find mapping for GDS layer/purpose: ({}, {}), skipping.",
+                                gds_key.first, gds_key.second);
+                },
+            },
+            rmap.get_mapping(gds_key));
+    }
+}
+
+// moves p0 away from p1 by the given distance
+point extend_point(const point &p0, const point &p1, int32_t ext) {
+    auto dx = static_cast<double>(p0[0]) - p1[0];
+    auto dy = static_cast<double>(p0[1]) - p1[1];
+    auto len = std::hypot(dx, dy);
+    if (len == 0)
+        return p0;
+    return {p0[0] + static_cast<coord_t>(std::round(dx / len * ext)),
+            p0[1] + static_cast<coord_t>(std::round(dy / len * ext))};
+}
+
+bool is_path45(const std::vector<point> &pt_list) {
+    for (std::size_t idx = 1; idx < pt_list.size(); ++idx) {
+        auto dx = pt_list[idx][0] - pt_list[idx - 1][0];
+        auto dy = pt_list[idx][1] - pt_list[idx - 1][1];
+        if (dx != 0 && dy != 0 && std::abs(dx) != std::abs(dy))
+            return false;
+    }
+    return true;
+}
+
+// the polygon covered by an off-angle path segment, with truncated ends
+layout::polygon get_segment_poly(const point &p0, const point &p1, double half_width) {
+    auto dx = static_cast<double>(p1[0]) - p0[0];
+    auto dy = static_cast<double>(p1[1]) - p0[1];
+    auto len = std::hypot(dx, dy);
+    auto nx = static_cast<coord_t>(std::round(-dy / len * half_width));
+    auto ny = static_cast<coord_t>(std::round(dx / len * half_width));
+    std::array<point, 4> pt_vec = {point{p0[0] + nx, p0[1] + ny}, point{p1[0] + nx, p1[1] + ny},
+                                   point{p1[0] - nx, p1[1] - ny}, point{p0[0] - nx, p0[1] - ny}};
+    layout::polygon ans;
+    ans.set(pt_vec.begin(), pt_vec.end());
+    return ans;
+}
+
+void add_path(spdlog::logger &logger, layout::cellview &ans, const gds_layer_t &gds_key,
+              gds_path &&path, const gds_rlookup &rmap) {
+    auto map_val = rmap.get_mapping(gds_key);
+    auto key_ptr = std::get_if<layer_t>(&map_val);
+    if (!key_ptr) {
+        logger.warn("Cannot add GDS path on layer/purpose ({}, {}), skipping.", gds_key.first,
+                    gds_key.second);
+        return;
+    }
+    auto width = std::abs(path.width);
+    auto &pt_list = path.pt_list;
+    if (width == 0 || pt_list.size() < 2) {
+        logger.warn("Skipping degenerate GDS path on layer/purpose ({}, {}).", gds_key.first,
+                    gds_key.second);
+        return;
+    }
+    // the edges of an odd width path are off grid, so it is widened to cover the whole path
+    auto half_width = (width + 1) / 2;
+    if (width % 2 != 0) {
+        logger.warn("GDS path on layer/purpose ({}, {}) has odd width {}, widening it to {}.",
+                    gds_key.first, gds_key.second, width, 2 * half_width);
+    }
+
+    auto sty = end_style::truncate;
+    switch (path.path_type) {
+    case 0:
+        break;
+    case 1:
+        sty = end_style::round;
+        break;
+    case 2:
+        sty = end_style::extend;
+        break;
+    case 4: {
+        auto n = pt_list.size();
+        pt_list[0] = extend_point(pt_list[0], pt_list[1], path.bgn_extn);
+        pt_list[n - 1] = extend_point(pt_list[n - 1], pt_list[n - 2], path.end_extn);
+        break;
+    }
+    default:
+        logger.warn("Unsupported GDS path type {}, using flush ends.", path.path_type);
+    }
+
+    if (is_path45(pt_list)) {
+        auto sm = (sty == end_style::round) ? end_style::round : end_style::extend;
+        ans.add_shape(*key_ptr, layout::make_path(pt_list, half_width, sty, sty, sm));
+    } else {
+        logger.warn("GDS path on layer/purpose ({}, {}) is not on a 45 degree grid, drawing "
+                    "segments with flush ends.",
+                    gds_key.first, gds_key.second);
+        for (std::size_t idx = 1; idx < pt_list.size(); ++idx) {
+            if (pt_list[idx] != pt_list[idx - 1])
+                ans.add_shape(*key_ptr,
+                              get_segment_poly(pt_list[idx - 1], pt_list[idx], half_width));
+        }
+    }
+}
+
+// adds the geometry of master, scaled by mag then transformed by xform, to ans
+void add_scaled_geometry(layout::cellview &ans, const layout::cellview &master,
+                         const transformation &xform, double mag) {
+    auto scale = [mag](coord_t val) { return static_cast<coord_t>(std::round(val * mag)); };
+    std::vector<point> pt_vec;
+    for (auto iter = master.begin_geometry(); iter != master.end_geometry(); ++iter) {
+        std::vector<layout::polygon> poly_list;
+        iter->second.write_geometry(poly_list);
+        for (const auto &poly : poly_list) {
+            pt_vec.clear();
+            for (const auto &pt : poly) {
+                pt_vec.push_back({scale(pt.x()), scale(pt.y())});
+            }
+            layout::polygon tmp;
+            tmp.set(pt_vec.begin(), pt_vec.end());
+            bp::transform(tmp, xform);
+            ans.add_shape(iter->first, tmp);
+        }
+    }
+    for (auto iter = master.begin_inst(); iter != master.end_inst(); ++iter) {
+        const auto &inst = iter->second;
+        auto inst_master = inst.get_cellview();
+        if (!inst_master)
+            continue;
+        for (cnt_t ix = 0; ix < inst.nx; ++ix) {
+            for (cnt_t iy = 0; iy < inst.ny; ++iy) {
+                auto inst_xform = get_move_by(inst.xform, ix * inst.spx, iy * inst.spy);
+                auto[x, y] = location(inst_xform);
+                auto elem_xform = make_xform(scale(x), scale(y), orient(inst_xform));
+                add_scaled_geometry(ans, *inst_master, get_transform_by(elem_xform, xform), mag);
+            }
+        }
+    }
+}
+
+void add_magnified(spdlog::logger &logger, layout::cellview &ans, const layout::instance &inst,
+                   double mag) {
+    logger.warn("Flattening magnified GDS instance {}, labels and pins are skipped.",
+                inst.get_inst_name());
+    auto master = inst.get_cellview();
+    for (cnt_t ix = 0; ix < inst.nx; ++ix) {
+        for (cnt_t iy = 0; iy < inst.ny; ++iy) {
+            add_scaled_geometry(ans, *master,
+                                get_move_by(inst.xform, ix * inst.spx, iy * inst.spy), mag);
+        }
+    }
+}
+
+// skips to the end of a structure, returns the sorted names of all referenced structures
+std::vector<std::string> read_struct_masters(gds_cursor &stream) {
+    std::vector<std::string> ans;
     while (true) {
         auto[rtype, rsize] = read_record_header(stream);
         switch (rtype) {
-        case record_type::TEXT: {
-            logger.info("Reading layout text.");
-            auto[gds_key, xform, text, text_h_dbl] = read_text(logger, stream);
-            auto text_h = static_cast<offset_t>(text_h_dbl / resolution);
-            cv_ptr->add_label(rmap.get_layer_t(gds_key), std::move(xform), std::move(text), text_h);
-            break;
-        }
-        case record_type::SREF:
-            logger.info("Reading layout instance.");
-            cv_ptr->add_object(read_instance(logger, stream, inst_cnt, master_map));
-            break;
-        case record_type::AREF:
-            logger.info("Reading layout array instance.");
-            cv_ptr->add_object(read_arr_instance(logger, stream, inst_cnt, master_map));
-            break;
-        case record_type::BOX: {
-            logger.info("Reading layout box.");
-            auto[gds_key, poly] = read_box(logger, stream);
-            add_object(logger, *cv_ptr, std::move(gds_key), std::move(poly), rmap);
+        case record_type::SNAME:
+            ans.emplace_back(strip_padding(read_chars(stream, rsize)));
             break;
+        case record_type::ENDSTR:
+            std::sort(ans.begin(), ans.end());
+            ans.erase(std::unique(ans.begin(), ans.end()), ans.end());
+            return ans;
+        default:
+            skip_bytes(stream, rsize);
         }
-        case record_type::BOUNDARY: {
-            logger.info("Reading layout boundary.");
-            auto[gds_key, poly] = read_boundary(logger, stream);
-            add_object(logger, *cv_ptr, std::move(gds_key), std::move(poly), rmap);
+    }
+}
+
+std::vector<gds_struct_info> index_gds_structs(spdlog::logger &logger, gds_cursor &stream) {
+    std::vector<gds_struct_info> ans;
+    while (true) {
+        auto[rtype, rsize] = read_record_header(stream);
+        switch (rtype) {
+        case record_type::BGNSTR: {
+            skip_bytes(stream, rsize);
+            auto start = stream;
+            auto name = read_struct_name(logger, stream);
+            ans.push_back({std::move(name), start, read_struct_masters(stream)});
             break;
         }
-        case record_type::ENDSTR:
-            logger.info("Finish reading GDS cellview.");
-            return {std::move(cell_name), std::move(cv_ptr)};
+        case record_type::ENDLIB:
+            logger.info("Found {} GDS structures.", ans.size());
+            return ans;
         default:
-            throw std::runtime_error("Unsupported record type in GDS struct: " +
+            throw std::runtime_error("Unrecognized GDS record type: " +
                                      std::to_string(static_cast<int>(rtype)));
         }
     }
 }
 
+std::vector<std::shared_ptr<layout::cellview>> read_gds_structs(
+    spdlog::logger &logger, const std::vector<gds_struct_info> &info_list,
+    const std::string &lib_name, const std::shared_ptr<const layout::routing_grid> &g,
+    const gds_rlookup &rmap, std::size_t num_threads,
+    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map) {
+    auto num = info_list.size();
+    // if a name is repeated, references resolve to the first structure
+    std::unordered_map<std::string, std::size_t> idx_map;
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        idx_map.emplace(info_list[idx].name, idx);
+    }
+
+    // the reference graph, as the number of unread masters and the parents of each structure
+    std::vector<std::size_t> num_masters(num, 0);
+    std::vector<std::vector<std::size_t>> parent_list(num);
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        for (const auto &master_name : info_list[idx].master_list) {
+            if (master_map.find(master_name) != master_map.end())
+                continue;
+            auto iter = idx_map.find(master_name);
+            if (iter == idx_map.end()) {
+                auto msg = fmt::format("Cannot find layout cellview {} in GDS file.", master_name);
+                logger.error(msg);
+                throw std::runtime_error(msg);
+            }
+            parent_list[iter->second].push_back(idx);
+            ++num_masters[idx];
+        }
+    }
+
+    std::vector<std::size_t> wave;
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        if (num_masters[idx] == 0)
+            wave.push_back(idx);
+    }
+
+    auto worker_ptr = (num_threads > 1) ? make_worker_logger(logger) : nullptr;
+    auto &worker_logger = worker_ptr ? *worker_ptr : logger;
+    std::vector<std::shared_ptr<layout::cellview>> ans(num);
+    auto cv_map = master_map;
+    std::size_t num_done = 0;
+    while (!wave.empty()) {
+        logger.info("Reading {} GDS cellviews.", wave.size());
+        util::parallel_for(wave.size(), num_threads, [&](std::size_t widx) {
+            auto idx = wave[widx];
+            auto stream = info_list[idx].start;
+            ans[idx] = std::get<1>(
+                read_lay_cellview(worker_logger, stream, lib_name, g, rmap, cv_map));
+        });
+
+        std::vector<std::size_t> next_wave;
+        for (auto idx : wave) {
+            // build the indices now, so parents in later waves only read them
+            ans[idx]->finalize();
+            cv_map.emplace(info_list[idx].name, ans[idx]);
+            for (auto parent : parent_list[idx]) {
+                if (--num_masters[parent] == 0)
+                    next_wave.push_back(parent);
+            }
+        }
+        num_done += wave.size();
+        wave = std::move(next_wave);
+    }
+    if (num_done != num)
+        throw std::runtime_error("GDS file has circular structure references.");
+    return ans;
+}
+
 } // namespace gdsii
 } // namespace cbag
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <iterator>
 
 #include <fmt/core.h>
 
+#include <cbag/common/box_t_util.h>
 #include <cbag/common/point.h>
 #include <cbag/common/transformation_util.h>
 #include <cbag/gdsii/math.h>
@@ -15,296 +17,32 @@
 namespace cbag {
 namespace gdsii {
 
-std::tuple<record_type, std::size_t> read_record_header(std::istream &stream) {
-    auto size = static_cast<std::size_t>(read_bytes<uint16_t>(stream)) - 4;
-    auto record_val = read_bytes<uint16_t>(stream);
-
-    return {static_cast<record_type>(record_val), size};
-}
-
-std::tuple<record_type, std::size_t> peek_record_header(std::istream &stream) {
-    auto ans = read_record_header(stream);
-    stream.seekg(-4, std::ios::cur);
-    return ans;
-}
-
 std::tuple<record_type, std::size_t> print_record_header(std::istream &stream) {
     auto ans = read_record_header(stream);
     std::cout << to_string(std::get<0>(ans)) << std::endl;
     return ans;
 }
 
-template <record_type R, std::size_t unit_size = 1, std::size_t num_data = 0>
-std::size_t check_record_header(std::istream &stream) {
-    auto[actual, size] = read_record_header(stream);
-    if (actual != R)
-        throw std::runtime_error(fmt::format("got gds record {:#x}, expected {:#x}",
-                                             static_cast<int>(actual), static_cast<int>(R)));
-
-    auto ans = size / unit_size;
-    auto mod = size % unit_size;
-    if (mod != 0)
-        throw std::runtime_error(
-            fmt::format("gds record size {} not divisible by unit size {}", size, unit_size));
-
-    if (num_data != 0 && ans != num_data) {
-        throw std::runtime_error(
-            fmt::format("gds record has {} elements, expected {}", ans, num_data));
-    }
-    return ans;
-}
-
-template <record_type R, std::size_t unit_size = 1, std::size_t num_data = 0>
-void read_skip(std::istream &stream) {
-    auto num = check_record_header<R, unit_size, num_data>(stream);
-    stream.ignore(num * unit_size);
-}
-
-template <record_type R> uint16_t read_int(spdlog::logger &logger, std::istream &stream) {
-    check_record_header<R, sizeof(uint16_t), 1>(stream);
-    return read_bytes<uint16_t>(stream);
-}
-
-std::tuple<uint16_t, uint16_t> read_col_row(spdlog::logger &logger, std::istream &stream) {
-    check_record_header<record_type::COLROW, sizeof(uint16_t), 2>(stream);
-    auto nx = read_bytes<uint16_t>(stream);
-    auto ny = read_bytes<uint16_t>(stream);
-    return {nx, ny};
-}
-
-template <record_type R> double read_double(spdlog::logger &logger, std::istream &stream) {
-    check_record_header<R, sizeof(uint64_t), 1>(stream);
-    return gds_to_double(read_bytes<uint64_t>(stream));
-}
-
-template <record_type R> std::string read_name(spdlog::logger &logger, std::istream &stream) {
-    std::string ans;
-    auto num = check_record_header<R, sizeof(char)>(stream);
-    ans.reserve(num);
-    for (decltype(num) idx = 0; idx < num; ++idx) {
-        ans.push_back(read_bytes<char>(stream));
-    }
+std::optional<box_t> get_rectangle(const point *pt_ptr, std::size_t num) {
+    if (num == 5 && pt_ptr[4] != pt_ptr[0])
+        return {};
+    if (num != 4 && num != 5)
+        return {};
+    auto &p0 = pt_ptr[0];
+    auto &p1 = pt_ptr[1];
+    auto &p2 = pt_ptr[2];
+    auto &p3 = pt_ptr[3];
+    // either the first edge is vertical or it is horizontal
+    if (!((p0[0] == p1[0] && p1[1] == p2[1] && p2[0] == p3[0] && p3[1] == p0[1]) ||
+          (p0[1] == p1[1] && p1[0] == p2[0] && p2[1] == p3[1] && p3[0] == p0[0])))
+        return {};
+    auto ans = box_t(std::min(p0[0], p2[0]), std::min(p0[1], p2[1]), std::max(p0[0], p2[0]),
+                     std::max(p0[1], p2[1]));
+    if (!is_physical(ans))
+        return {};
     return ans;
 }
 
-template <record_type R> void read_grp_begin(spdlog::logger &logger, std::istream &stream) {
-    read_skip<R, sizeof(tval_t), 12>(stream);
-}
-
-void read_header(spdlog::logger &logger, std::istream &stream) {
-    read_skip<record_type::HEADER, sizeof(uint16_t), 1>(stream);
-}
-
-void read_lib_begin(spdlog::logger &logger, std::istream &stream) {
-    read_grp_begin<record_type::BGNLIB>(logger, stream);
-}
-
-std::string read_lib_name(spdlog::logger &logger, std::istream &stream) {
-    return read_name<record_type::LIBNAME>(logger, stream);
-}
-
-void read_units(spdlog::logger &logger, std::istream &stream) {
-    read_skip<record_type::UNITS, sizeof(uint64_t), 2>(stream);
-}
-
-std::string read_struct_name(spdlog::logger &logger, std::istream &stream) {
-    return read_name<record_type::STRNAME>(logger, stream);
-}
-
-void read_ele_end(spdlog::logger &logger, std::istream &stream) {
-    check_record_header<record_type::ENDEL, sizeof(uint16_t), 0>(stream);
-}
-
-std::tuple<transformation, double> read_transform_info(spdlog::logger &logger,
-                                                       std::istream &stream) {
-    auto bit_flag = read_int<record_type::STRANS>(logger, stream);
-
-    auto ans = make_xform();
-    if ((bit_flag & (1 << 15)) != 0) {
-        set_orient(ans, oMX);
-    }
-
-    double mag = 1.0;
-    double ang_dbl = 0.0;
-    auto[rec, size] = peek_record_header(stream);
-    switch (rec) {
-    case record_type::MAG:
-        mag = read_double<record_type::MAG>(logger, stream);
-        rec = std::get<0>(peek_record_header(stream));
-        if (rec == record_type::ANGLE)
-            ang_dbl = read_double<record_type::ANGLE>(logger, stream);
-        break;
-    case record_type::ANGLE:
-        ang_dbl = read_double<record_type::ANGLE>(logger, stream);
-        break;
-    default:
-        break;
-    }
-
-    auto angle = static_cast<int>(ang_dbl);
-    switch (angle) {
-    case 0:
-        break;
-    case 90:
-        transform_by(ans, make_xform(0, 0, oR90));
-        break;
-    case 180:
-        transform_by(ans, make_xform(0, 0, oR180));
-        break;
-    case 270:
-        transform_by(ans, make_xform(0, 0, oR270));
-        break;
-    default:
-        throw std::runtime_error("GDS rotation angle not supported: " + std::to_string(angle));
-    }
-
-    return {ans, mag};
-}
-
-point read_point(std::istream &stream) {
-    auto x = read_bytes<int32_t>(stream);
-    auto y = read_bytes<int32_t>(stream);
-    return {x, y};
-}
-
-std::tuple<transformation, double> read_transform_mag(spdlog::logger &logger,
-                                                      std::istream &stream) {
-    auto ans = read_transform_info(logger, stream);
-    check_record_header<record_type::XY, sizeof(int32_t), 2>(stream);
-    auto[x, y] = read_point(stream);
-    move_by(std::get<0>(ans), x, y);
-
-    return ans;
-}
-
-transformation read_transform(spdlog::logger &logger, std::istream &stream) {
-    return std::get<0>(read_transform_mag(logger, stream));
-}
-
-std::tuple<gds_layer_t, transformation, std::string, double> read_text(spdlog::logger &logger,
-                                                                       std::istream &stream) {
-    auto glay = read_int<record_type::LAYER>(logger, stream);
-    auto gpurp = read_int<record_type::TEXTTYPE>(logger, stream);
-    read_skip<record_type::PRESENTATION, sizeof(uint16_t), 1>(stream);
-    auto[xform, mag] = read_transform_mag(logger, stream);
-
-    auto text = read_name<record_type::STRING>(logger, stream);
-    read_ele_end(logger, stream);
-
-    return {gds_layer_t{glay, gpurp}, std::move(xform), std::move(text), mag};
-}
-
-std::tuple<gds_layer_t, layout::polygon> read_box(spdlog::logger &logger, std::istream &stream) {
-    auto glay = read_int<record_type::LAYER>(logger, stream);
-    auto gpurp = read_int<record_type::BOXTYPE>(logger, stream);
-    check_record_header<record_type::XY, sizeof(int32_t), 10>(stream);
-
-    std::array<point, 5> pt_vec;
-    pt_vec[0] = read_point(stream);
-    pt_vec[1] = read_point(stream);
-    pt_vec[2] = read_point(stream);
-    pt_vec[3] = read_point(stream);
-    pt_vec[4] = read_point(stream);
-    read_ele_end(logger, stream);
-
-    layout::polygon poly;
-    poly.set(pt_vec.begin(), pt_vec.end());
-
-    return {gds_layer_t{glay, gpurp}, std::move(poly)};
-}
-
-std::tuple<gds_layer_t, layout::polygon> read_boundary(spdlog::logger &logger,
-                                                       std::istream &stream) {
-    auto glay = read_int<record_type::LAYER>(logger, stream);
-    auto gpurp = read_int<record_type::DATATYPE>(logger, stream);
-    // divide by 2 to get number of points instead of number of coordinates.
-    auto num = check_record_header<record_type::XY, sizeof(int32_t)>(stream) / 2;
-
-    std::vector<point> pt_vec;
-    pt_vec.reserve(num);
-    for (decltype(num) idx = 0; idx < num; ++idx) {
-        pt_vec.push_back(read_point(stream));
-    }
-    read_ele_end(logger, stream);
-
-    layout::polygon poly;
-    poly.set(pt_vec.begin(), pt_vec.end());
-
-    return {gds_layer_t{glay, gpurp}, std::move(poly)};
-}
-
-std::string read_inst_name(spdlog::logger &logger, std::istream &stream, std::size_t &cnt) {
-    auto[rtype, rsize] = read_record_header(stream);
-    std::string inst_name;
-    switch (rtype) {
-    case record_type::ENDEL:
-        inst_name = "X" + std::to_string(cnt);
-        ++cnt;
-        break;
-    case record_type::PROPATTR: {
-        auto prop_code = read_bytes<uint16_t>(stream);
-        if (prop_code != PROP_INST_NAME) {
-            throw std::runtime_error(
-                fmt::format("Unexpected gds property code {} for instance.", prop_code));
-        }
-        inst_name = read_name<record_type::PROPVALUE>(logger, stream);
-        read_ele_end(logger, stream);
-        break;
-    }
-    default:
-        throw std::runtime_error(fmt::format("Unexpected gds record type {} at end of instance.",
-                                             static_cast<int>(rtype)));
-    }
-    return inst_name;
-}
-
-layout::instance read_instance(
-    spdlog::logger &logger, std::istream &stream, std::size_t &cnt,
-    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map) {
-    auto cell_name = read_name<record_type::SNAME>(logger, stream);
-
-    auto iter = master_map.find(cell_name);
-    if (iter == master_map.end()) {
-        auto msg = fmt::format("Cannot find layout cellview {} in GDS file.", cell_name);
-        logger.error(msg);
-        throw std::runtime_error(msg);
-    }
-    auto master = iter->second;
-    auto xform = read_transform(logger, stream);
-    auto inst_name = read_inst_name(logger, stream, cnt);
-    return {std::move(inst_name), master, std::move(xform)};
-}
-
-layout::instance read_arr_instance(
-    spdlog::logger &logger, std::istream &stream, std::size_t &cnt,
-    const std::unordered_map<std::string, std::shared_ptr<const layout::cellview>> &master_map) {
-    auto cell_name = read_name<record_type::SNAME>(logger, stream);
-
-    auto iter = master_map.find(cell_name);
-    if (iter == master_map.end())
-        throw std::runtime_error(
-            fmt::format("Cannot find layout cellview {} in GDS file.", cell_name));
-    auto master = iter->second;
-
-    auto[xform, mag] = read_transform_info(logger, stream);
-
-    auto[gds_nx, gds_ny] = read_col_row(logger, stream);
-    check_record_header<record_type::XY, sizeof(int32_t), 6>(stream);
-    std::array<point, 3> pt_vec;
-    pt_vec[0] = read_point(stream);
-    pt_vec[1] = read_point(stream);
-    pt_vec[2] = read_point(stream);
-    auto inst_name = read_inst_name(logger, stream, cnt);
-
-    move_by(xform, pt_vec[0][0], pt_vec[0][1]);
-    auto gds_spx = pt_vec[1][0] / gds_nx;
-    auto gds_spy = pt_vec[2][1] / gds_ny;
-
-    auto[nx, ny, spx, spy] = cbag::convert_gds_array(xform, gds_nx, gds_ny, gds_spx, gds_spy);
-
-    return {std::move(inst_name), master, std::move(xform), nx, ny, spx, spy};
-}
-
 void print_time(std::istream &stream) {
     struct tm val;
     auto timeinfo = &val;
@@ -333,10 +71,13 @@ bool print_record(std::istream &stream) {
     case record_type::TEXT:
     case record_type::ENDEL:
     case record_type::BOX:
+    case record_type::PATH:
+    case record_type::NODE:
         break;
     // bit flag records
     case record_type::PRESENTATION:
     case record_type::STRANS:
+    case record_type::ELFLAGS:
         std::cout << fmt::format("bit flag: {:#06x}", read_bytes<uint16_t>(stream)) << std::endl;
         break;
     case record_type::HEADER:
@@ -345,6 +86,8 @@ bool print_record(std::istream &stream) {
     case record_type::TEXTTYPE:
     case record_type::PROPATTR:
     case record_type::BOXTYPE:
+    case record_type::PATHTYPE:
+    case record_type::NODETYPE:
         std::cout << fmt::format("value: {}", read_bytes<uint16_t>(stream)) << std::endl;
         break;
     case record_type::BGNLIB:
@@ -362,6 +105,9 @@ bool print_record(std::istream &stream) {
     }
 
     case record_type::WIDTH:
+    case record_type::PLEX:
+    case record_type::BGNEXTN:
+    case record_type::ENDEXTN:
         std::cout << fmt::format("value: {}", read_bytes<int32_t>(stream)) << std::endl;
         break;
     case record_type::XY: {
@@ -390,12 +136,7 @@ bool print_record(std::istream &stream) {
     case record_type::SNAME:
     case record_type::STRING:
     case record_type::PROPVALUE: {
-        std::string ans;
-        ans.reserve(size);
-        for (std::size_t idx = 0; idx < size; ++idx) {
-            ans.push_back(read_bytes<char>(stream));
-        }
-        std::cout << "value: " << ans << std::endl;
+        std::cout << "value: " << read_chars(stream, size) << std::endl;
         break;
     }
     default:
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <cbag/common/box_t_util.h>
+#include <cbag/gdsii/read_util.h>
+#include <cbag/gdsii/scan.h>
+#include <cbag/util/compress.h>
+#include <cbag/util/mmap_file.h>
+
+namespace cbag {
+namespace gdsii {
+
+/** A structure reference, kept until all structures are scanned.
+ */
+struct scan_ref {
+    std::string master;
+    bool flip = false;
+    double mag = 1.0;
+    double angle = 0.0;
+    // the origin, then the column and row end points of arrays
+    std::array<std::array<double, 2>, 3> pt_list = {};
+    uint16_t nx = 1;
+    uint16_t ny = 1;
+};
+
+struct scan_element {
+    record_type type = record_type::ENDEL;
+    gds_layer_t key = {0, 0};
+    box_t bbox = box_t::get_invalid_box();
+    coord_t half_width = 0;
+    coord_t ext = 0;
+    scan_ref ref;
+};
+
+
+template <class S> void scan_xy(S &stream, std::size_t num, scan_element &ele) {
+    switch (ele.type) {
+    case record_type::SREF:
+    case record_type::AREF: {
+        auto num_read = std::min(num, ele.ref.pt_list.size());
+        for (std::size_t idx = 0; idx < num_read; ++idx) {
+            ele.ref.pt_list[idx][0] = read_bytes<int32_t>(stream);
+            ele.ref.pt_list[idx][1] = read_bytes<int32_t>(stream);
+        }
+        skip_bytes(stream, (num - num_read) * 2 * sizeof(int32_t));
+        break;
+    }
+    case record_type::BOUNDARY:
+    case record_type::BOX:
+    case record_type::PATH:
+        for (std::size_t idx = 0; idx < num; ++idx) {
+            auto x = static_cast<coord_t>(read_bytes<int32_t>(stream));
+            auto y = static_cast<coord_t>(read_bytes<int32_t>(stream));
+            merge(ele.bbox, box_t(x, y, x, y));
+        }
+        break;
+    default:
+        skip_bytes(stream, num * 2 * sizeof(int32_t));
+    }
+}
+
+void add_element(gds_struct_summary &info, std::vector<scan_ref> &ref_list, scan_element &ele) {
+    switch (ele.type) {
+    case record_type::SREF:
+    case record_type::AREF:
+        ++info.stats.num_inst;
+        info.ref_cnt[ele.ref.master] += static_cast<uint64_t>(ele.ref.nx) * ele.ref.ny;
+        ref_list.push_back(std::move(ele.ref));
+        return;
+    case record_type::TEXT:
+        ++info.stats.num_text;
+        break;
+    case record_type::NODE:
+        ++info.stats.num_node;
+        break;
+    case record_type::BOUNDARY:
+        ++info.stats.num_boundary;
+        merge(info.bbox, ele.bbox);
+        break;
+    case record_type::BOX:
+        ++info.stats.num_box;
+        merge(info.bbox, ele.bbox);
+        break;
+    case record_type::PATH:
+        ++info.stats.num_path;
+        if (is_valid(ele.bbox)) {
+            auto delta = ele.half_width + std::max<coord_t>(ele.ext, 0);
+            merge(info.bbox, expand(ele.bbox, delta, delta));
+        }
+        break;
+    default:
+        throw std::runtime_error("GDS element end without element begin.");
+    }
+    ++info.layer_cnt[ele.key];
+}
+
+template <class S>
+void scan_struct(S &stream, gds_struct_summary &info, std::vector<scan_ref> &ref_list) {
+    scan_element ele;
+    while (true) {
+        auto[rtype, rsize] = read_record_header(stream);
+        switch (rtype) {
+        case record_type::BOUNDARY:
+        case record_type::BOX:
+        case record_type::PATH:
+        case record_type::TEXT:
+        case record_type::NODE:
+        case record_type::SREF:
+        case record_type::AREF:
+            ele = scan_element{};
+            ele.type = rtype;
+            skip_bytes(stream, rsize);
+            break;
+        case record_type::LAYER:
+            ele.key.first = read_bytes<uint16_t>(stream);
+            break;
+        case record_type::DATATYPE:
+        case record_type::BOXTYPE:
+        case record_type::TEXTTYPE:
+        case record_type::NODETYPE:
+            ele.key.second = read_bytes<uint16_t>(stream);
+            break;
+        case record_type::WIDTH:
+            ele.half_width = (std::abs(read_bytes<int32_t>(stream)) + 1) / 2;
+            break;
+        case record_type::BGNEXTN:
+        case record_type::ENDEXTN:
+            ele.ext = std::max(ele.ext, static_cast<coord_t>(read_bytes<int32_t>(stream)));
+            break;
+        case record_type::SNAME:
+            ele.ref.master = std::string(strip_padding(read_chars(stream, rsize)));
+            break;
+        case record_type::STRANS:
+            ele.ref.flip = (read_bytes<uint16_t>(stream) & 0x8000) != 0;
+            break;
+        case record_type::MAG:
+            ele.ref.mag = gds_to_double(read_bytes<uint64_t>(stream));
+            break;
+        case record_type::ANGLE:
+            ele.ref.angle = gds_to_double(read_bytes<uint64_t>(stream));
+            break;
+        case record_type::COLROW:
+            ele.ref.nx = read_bytes<uint16_t>(stream);
+            ele.ref.ny = read_bytes<uint16_t>(stream);
+            break;
+        case record_type::XY:
+            scan_xy(stream, rsize / (2 * sizeof(int32_t)), ele);
+            break;
+        case record_type::ENDEL:
+            add_element(info, ref_list, ele);
+            break;
+        case record_type::ENDSTR:
+            return;
+        default:
+            skip_bytes(stream, rsize);
+        }
+    }
+}
+
+// cosine and sine of the angle in degrees, exact for multiples of 90 degrees
+std::array<double, 2> get_rotation(double angle) {
+    if (std::fmod(angle, 90.0) == 0.0) {
+        switch (((static_cast<int64_t>(angle / 90.0) % 4) + 4) % 4) {
+        case 1:
+            return {0.0, 1.0};
+        case 2:
+            return {-1.0, 0.0};
+        case 3:
+            return {0.0, -1.0};
+        default:
+            return {1.0, 0.0};
+        }
+    }
+    auto rad = angle * M_PI / 180.0;
+    return {std::cos(rad), std::sin(rad)};
+}
+
+box_t get_ref_bbox(const box_t &master_box, const scan_ref &ref) {
+    if (!is_valid(master_box))
+        return master_box;
+
+    auto[cos_val, sin_val] = get_rotation(ref.angle);
+    std::array<double, 4> bnds = {HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+    for (auto x : {xl(master_box), xh(master_box)}) {
+        for (auto y : {yl(master_box), yh(master_box)}) {
+            auto xm = ref.mag * x;
+            auto ym = ref.mag * (ref.flip ? -y : y);
+            auto xr = cos_val * xm - sin_val * ym;
+            auto yr = sin_val * xm + cos_val * ym;
+            bnds = {std::min(bnds[0], xr), std::min(bnds[1], yr), std::max(bnds[2], xr),
+                    std::max(bnds[3], yr)};
+        }
+    }
+
+    // the bounding box of an array is the union of its corner elements
+    auto &p0 = ref.pt_list[0];
+    std::array<double, 2> col_span = {0, 0};
+    std::array<double, 2> row_span = {0, 0};
+    for (std::size_t idx = 0; idx < 2; ++idx) {
+        if (ref.nx > 1)
+            col_span[idx] = (ref.pt_list[1][idx] - p0[idx]) * (ref.nx - 1) / ref.nx;
+        if (ref.ny > 1)
+            row_span[idx] = (ref.pt_list[2][idx] - p0[idx]) * (ref.ny - 1) / ref.ny;
+    }
+    std::array<double, 4> offsets;
+    for (std::size_t idx = 0; idx < 2; ++idx) {
+        offsets[idx] = p0[idx] + std::min(0.0, col_span[idx]) + std::min(0.0, row_span[idx]);
+        offsets[idx + 2] = p0[idx] + std::max(0.0, col_span[idx]) + std::max(0.0, row_span[idx]);
+    }
+    return {static_cast<coord_t>(std::floor(bnds[0] + offsets[0])),
+            static_cast<coord_t>(std::floor(bnds[1] + offsets[1])),
+            static_cast<coord_t>(std::ceil(bnds[2] + offsets[2])),
+            static_cast<coord_t>(std::ceil(bnds[3] + offsets[3]))};
+}
+
+struct hierarchy_info {
+    std::vector<gds_struct_summary> &info_list;
+    const std::vector<std::vector<scan_ref>> &ref_table;
+    std::unordered_map<std::string, std::size_t> idx_map;
+    // 0 if not visited, 1 if in progress, 2 if done
+    std::vector<int> status;
+    std::unordered_set<std::string> missing;
+};
+
+void set_hierarchy(spdlog::logger &logger, hierarchy_info &hier, std::size_t idx) {
+    auto &info = hier.info_list[idx];
+    switch (hier.status[idx]) {
+    case 1:
+        throw std::runtime_error("Circular reference in GDS structure: " + info.name);
+    case 2:
+        return;
+    default:
+        break;
+    }
+    hier.status[idx] = 1;
+
+    info.num_flat = info.stats.num_boundary + info.stats.num_box + info.stats.num_path;
+    for (const auto &ref : hier.ref_table[idx]) {
+        auto iter = hier.idx_map.find(ref.master);
+        if (iter == hier.idx_map.end()) {
+            if (hier.missing.insert(ref.master).second)
+                logger.warn("Cannot find GDS structure {} referenced by {}", ref.master,
+                            info.name);
+            continue;
+        }
+        set_hierarchy(logger, hier, iter->second);
+        auto &master = hier.info_list[iter->second];
+        auto cnt = static_cast<uint64_t>(ref.nx) * ref.ny;
+        master.num_used += cnt;
+        info.depth = std::max(info.depth, master.depth + 1);
+        info.num_flat += cnt * master.num_flat;
+        merge(info.bbox, get_ref_bbox(master.bbox, ref));
+    }
+
+    hier.status[idx] = 2;
+}
+
+template <class S>
+std::vector<gds_struct_summary> scan_gds_structs_impl(spdlog::logger &logger, S &stream) {
+    std::vector<gds_struct_summary> ans;
+    std::vector<std::vector<scan_ref>> ref_table;
+    while (true) {
+        auto[rtype, rsize] = read_record_header(stream);
+        switch (rtype) {
+        case record_type::BGNSTR: {
+            skip_bytes(stream, rsize);
+            auto &info = ans.emplace_back();
+            info.name = read_struct_name(logger, stream);
+            scan_struct(stream, info, ref_table.emplace_back());
+            break;
+        }
+        case record_type::ENDLIB: {
+            auto num = ans.size();
+            hierarchy_info hier{ans, ref_table, {}, std::vector<int>(num, 0), {}};
+            // if a name is repeated, references resolve to the first structure
+            for (std::size_t idx = 0; idx < num; ++idx) {
+                hier.idx_map.emplace(ans[idx].name, idx);
+            }
+            for (std::size_t idx = 0; idx < num; ++idx) {
+                set_hierarchy(logger, hier, idx);
+            }
+            logger.info("Scanned {} GDS structures.", num);
+            return ans;
+        }
+        default:
+            throw std::runtime_error("Unrecognized GDS record type: " +
+                                     std::to_string(static_cast<int>(rtype)));
+        }
+    }
+}
+
+std::vector<gds_struct_summary> scan_gds_structs(spdlog::logger &logger, gds_cursor &stream) {
+    return scan_gds_structs_impl(logger, stream);
+}
+
+std::vector<gds_struct_summary> scan_gds_structs(spdlog::logger &logger, std::istream &stream) {
+    return scan_gds_structs_impl(logger, stream);
+}
+
+std::vector<gds_struct_summary> scan_gds(const std::string &fname, compress_type comp) {
+    auto log_ptr = get_cbag_logger();
+
+    log_ptr->info("Scanning GDS file {}", fname);
+    comp = util::get_compress_type(fname, comp);
+    if (comp != compress_type::NONE) {
+        util::decompress_istream stream(fname, comp);
+        auto lib_name = read_gds_start(*log_ptr, stream);
+        log_ptr->info("GDS library: {}", lib_name);
+        return scan_gds_structs(*log_ptr, stream);
+    }
+
+    util::mmap_file file(fname);
+    gds_cursor stream(file.data(), file.size());
+    auto lib_name = read_gds_start(*log_ptr, stream);
+    log_ptr->info("GDS library: {}", lib_name);
+    return scan_gds_structs(*log_ptr, stream);
+}
+
+} // namespace gdsii
+} // namespace cbag
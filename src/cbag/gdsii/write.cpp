@@ -1,31 +1,59 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <tuple>
+
 #include <fmt/core.h>
 
 #include <cbag/common/box_t_util.h>
 #include <cbag/common/transformation_util.h>
 #include <cbag/gdsii/parse_map.h>
+#include <cbag/gdsii/read_util.h>
 #include <cbag/gdsii/write.h>
 #include <cbag/gdsii/write_util.h>
 #include <cbag/layout/cellview.h>
 #include <cbag/layout/polygon.h>
 #include <cbag/layout/via_util.h>
+#include <cbag/util/parallel.h>
 
 namespace cbag {
 namespace gdsii {
 
+using box_map = std::map<gds_layer_t, std::vector<box_t>>;
+
+// returns the polygon as a box if it is a rectangle
+std::optional<box_t> get_rectangle(const layout::polygon &poly) {
+    if (poly.size() > 5)
+        return {};
+    std::array<point, 5> pt_list;
+    std::size_t num = 0;
+    for (const auto &pt : poly) {
+        pt_list[num++] = {pt.x(), pt.y()};
+    }
+    return get_rectangle(pt_list.data(), num);
+}
+
+/** Writes polygons.  If box_list is given, rectangles are added to it instead.
+ */
 class polygon_writer {
   public:
     using value_type = layout::polygon;
 
   private:
     spdlog::logger &logger;
-    std::ostream &stream;
+    gds_buffer &buf;
     glay_t layer;
     gpurp_t purpose;
+    std::vector<box_t> *box_list;
     value_type last;
 
   public:
-    polygon_writer(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose)
-        : logger(logger), stream(stream), layer(layer), purpose(purpose) {}
+    polygon_writer(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
+                   std::vector<box_t> *box_list = nullptr)
+        : logger(logger), buf(buf), layer(layer), purpose(purpose), box_list(box_list) {}
 
     void push_back(value_type &&v) {
         record_last();
@@ -39,7 +67,13 @@ class polygon_writer {
 
     void record_last() const {
         if (last.size() > 0) {
-            write_polygon(logger, stream, layer, purpose, last);
+            if (box_list) {
+                if (auto box = get_rectangle(last)) {
+                    box_list->push_back(*box);
+                    return;
+                }
+            }
+            write_polygon(logger, buf, layer, purpose, last);
         }
     }
 
@@ -51,16 +85,16 @@ class polygon_writer {
 class rect_writer {
   private:
     spdlog::logger &logger;
-    std::ostream &stream;
+    gds_buffer &buf;
     glay_t layer;
     gpurp_t purpose;
 
   public:
-    rect_writer(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose)
-        : logger(logger), stream(stream), layer(layer), purpose(purpose) {}
+    rect_writer(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose)
+        : logger(logger), buf(buf), layer(layer), purpose(purpose) {}
 
     rect_writer &operator=(const box_t &box) {
-        write_box(logger, stream, layer, purpose, box);
+        write_box(logger, buf, layer, purpose, box);
         return *this;
     }
 
@@ -69,6 +103,66 @@ class rect_writer {
     rect_writer &operator++() { return *this; }
 };
 
+/** Writes Manhattan polygons with at most max_vertices vertices as rectangles, and larger ones as
+ *  polygons.  If box_list is given, the rectangles are added to it instead.
+ */
+class rect_polygon_writer {
+  public:
+    using value_type = layout::polygon90;
+
+  private:
+    spdlog::logger &logger;
+    gds_buffer &buf;
+    glay_t layer;
+    gpurp_t purpose;
+    std::size_t max_vertices;
+    std::vector<box_t> *box_list;
+    value_type last;
+
+  public:
+    rect_polygon_writer(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
+                        std::size_t max_vertices, std::vector<box_t> *box_list = nullptr)
+        : logger(logger), buf(buf), layer(layer), purpose(purpose), max_vertices(max_vertices),
+          box_list(box_list) {}
+
+    void push_back(value_type &&v) {
+        record_last();
+        last = std::move(v);
+    }
+
+    void insert(value_type *ptr, const value_type &v) {
+        record_last();
+        last = v;
+    }
+
+    void record_last() const {
+        if (last.size() == 0)
+            return;
+        if (last.size() > max_vertices) {
+            layout::polygon poly;
+            poly.set(last.begin(), last.end());
+            write_polygon(logger, buf, layer, purpose, poly);
+            return;
+        }
+
+        layout::polygon90_set poly_set;
+        poly_set.insert(last);
+        std::vector<boost::polygon::rectangle_data<coord_t>> rect_list;
+        poly_set.get_rectangles(rect_list);
+        for (const auto &r : rect_list) {
+            auto box = box_t(xl(r), yl(r), xh(r), yh(r));
+            if (box_list)
+                box_list->push_back(box);
+            else
+                write_box(logger, buf, layer, purpose, box);
+        }
+    }
+
+    value_type &back() { return last; }
+
+    value_type *end() const { return nullptr; }
+};
+
 layer_map parse_layer_map(const std::string &fname, const layout::tech &tech) {
     layer_map ans;
 
@@ -105,6 +199,20 @@ gds_lookup::gds_lookup(const layout::tech &tech, const std::string &lay_map_file
                        const std::string &obj_map_file)
     : lay_map(parse_layer_map(lay_map_file, tech)), bnd_map(parse_obj_map(obj_map_file)) {}
 
+void gds_lookup::set_rect_vertices(std::size_t num) noexcept { rect_vertices = num; }
+
+std::size_t gds_lookup::get_rect_vertices() const noexcept { return rect_vertices; }
+
+void gds_lookup::set_min_array_size(std::size_t num) noexcept { min_array_size = num; }
+
+std::size_t gds_lookup::get_min_array_size() const noexcept { return min_array_size; }
+
+void gds_lookup::add_struct_name(std::string name) { struct_names.emplace(std::move(name)); }
+
+bool gds_lookup::has_struct_name(const std::string &name) const {
+    return struct_names.find(name) != struct_names.end();
+}
+
 std::optional<gds_layer_t> gds_lookup::get_gds_layer(layer_t key) const {
     auto iter = lay_map.find(key);
     if (iter == lay_map.end())
@@ -123,6 +231,27 @@ std::optional<gds_layer_t> gds_lookup::get_gds_layer(boundary_type bnd_type) con
     return iter->second;
 }
 
+std::optional<std::string> cell_merger::add(const layout::cellview &cv,
+                                            const std::string &cell_name,
+                                            const layout::str_map_t &rename_map) {
+    // keep only the renames of the masters, as rename_map may hold every cell written so far
+    layout::str_map_t master_map;
+    for (auto iter = cv.begin_inst(); iter != cv.end_inst(); ++iter) {
+        const auto &master_name = iter->second.get_cell_name(nullptr);
+        auto map_iter = rename_map.find(master_name);
+        if (map_iter != rename_map.end())
+            master_map.emplace(master_name, map_iter->second);
+    }
+
+    auto &cell_list = cell_map[cv.get_hash(master_map)];
+    for (const auto &item : cell_list) {
+        if (item.cv_ptr->has_same_content(cv, item.rename_map, master_map))
+            return item.cell_name;
+    }
+    cell_list.push_back(entry{&cv, cell_name, std::move(master_map)});
+    return {};
+}
+
 std::vector<tval_t> get_gds_time() {
     auto ep_time = std::time(nullptr);
     auto loc_time = std::localtime(&ep_time);
@@ -135,51 +264,263 @@ std::vector<tval_t> get_gds_time() {
 
 void write_gds_start(spdlog::logger &logger, std::ostream &stream, const std::string &lib_name,
                      double resolution, double user_unit, const std::vector<tval_t> &time_vec) {
-    write_header(logger, stream);
-    write_lib_begin(logger, stream, time_vec);
-    write_lib_name(logger, stream, lib_name);
-    write_units(logger, stream, resolution, user_unit);
+    gds_buffer buf;
+    write_header(logger, buf);
+    write_lib_begin(logger, buf, time_vec);
+    write_lib_name(logger, buf, lib_name);
+    write_units(logger, buf, resolution, user_unit);
+    buf.flush(stream);
 }
 
-void write_gds_stop(spdlog::logger &logger, std::ostream &stream) { write_lib_end(logger, stream); }
+void write_gds_stop(spdlog::logger &logger, std::ostream &stream) {
+    gds_buffer buf;
+    write_lib_end(logger, buf);
+    buf.flush(stream);
+}
 
-void write_lay_geometry(spdlog::logger &logger, std::ostream &stream, glay_t lay, gpurp_t purp,
-                        const layout::geometry &geo) {
-    polygon_writer w(logger, stream, lay, purp);
+void write_lay_geometry(spdlog::logger &logger, gds_buffer &buf, glay_t lay, gpurp_t purp,
+                        const layout::geometry &geo, std::size_t rect_vertices,
+                        std::vector<box_t> *box_list) {
+    if (rect_vertices > 0) {
+        if (auto poly_set = geo.get_polygon90_set()) {
+            rect_polygon_writer w(logger, buf, lay, purp, rect_vertices, box_list);
+            poly_set->get(w);
+            w.record_last();
+            return;
+        }
+    }
+    polygon_writer w(logger, buf, lay, purp, box_list);
     geo.write_geometry(w);
     w.record_last();
 }
 
-void write_lay_via(spdlog::logger &logger, std::ostream &stream, const layout::tech &tech,
+using via_gds_layers = std::array<gds_layer_t, 3>;
+
+// returns the GDS layers of the bottom metal, the cut and the top metal of a via
+std::optional<via_gds_layers> get_via_gds_layers(spdlog::logger &logger, const layout::tech &tech,
+                                                 const gds_lookup &lookup,
+                                                 const std::string &via_id) {
+    auto [lay1_key, cut_key, lay2_key] = tech.get_via_layer_purpose(via_id);
+    via_gds_layers ans;
+    std::size_t idx = 0;
+    for (const auto &key : {lay1_key, cut_key, lay2_key}) {
+        auto gkey = lookup.get_gds_layer(key);
+        if (!gkey) {
+            logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping via.",
+                        key.first, key.second);
+            return {};
+        }
+        ans[idx++] = *gkey;
+    }
+    return ans;
+}
+
+// returns the boxes of a via with their GDS layers
+std::vector<std::pair<gds_layer_t, box_t>> get_via_boxes(const via_gds_layers &layers,
+                                                         const layout::via &v) {
+    auto &[bot_key, cut_key, top_key] = layers;
+    std::vector<std::pair<gds_layer_t, box_t>> ans{{bot_key, layout::get_bot_box(v)},
+                                                   {top_key, layout::get_top_box(v)}};
+    std::vector<box_t> cut_list;
+    get_via_cuts(v, std::back_inserter(cut_list));
+    for (const auto &box : cut_list) {
+        ans.emplace_back(cut_key, box);
+    }
+    return ans;
+}
+
+void write_lay_via(spdlog::logger &logger, gds_buffer &buf, const layout::tech &tech,
                    const gds_lookup &lookup, const layout::via &v) {
-    auto [lay1_key, cut_key, lay2_key] = tech.get_via_layer_purpose(v.get_via_id());
-    auto gkey1 = lookup.get_gds_layer(lay1_key);
-    if (!gkey1) {
-        logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping via.",
-                    lay1_key.first, lay1_key.second);
+    auto layers = get_via_gds_layers(logger, tech, lookup, v.get_via_id());
+    if (!layers)
         return;
+    auto &[bot_key, cut_key, top_key] = *layers;
+    write_box(logger, buf, bot_key.first, bot_key.second, layout::get_bot_box(v));
+    write_box(logger, buf, top_key.first, top_key.second, layout::get_top_box(v));
+    get_via_cuts(v, rect_writer(logger, buf, cut_key.first, cut_key.second));
+}
+
+// largest number of columns or rows of an AREF
+constexpr std::size_t max_gds_array = std::numeric_limits<int16_t>::max();
+
+// vias with the same via ID and parameters, placed without rotation or reflection
+struct via_group {
+    const layout::via *via_ptr = nullptr;
+    // the boxes of the via placed at the origin
+    std::vector<std::pair<gds_layer_t, box_t>> box_list;
+    std::vector<point> pt_list;
+    std::string cell_name;
+};
+
+/** Collects the rectangles and vias of a cellview, then writes the ones that repeat on a regular
+ *  grid as arrays of generated cells.
+ *
+ *  Generated cells are named after the cellview, skipping the structure names recorded in the
+ *  lookup.  They are written to cell_buf as soon as they are needed, so they come before the
+ *  structure that uses them.
+ */
+class array_writer {
+  private:
+    spdlog::logger &logger;
+    gds_buffer &cell_buf;
+    const std::string &cell_name;
+    const std::vector<tval_t> &time_vec;
+    const layout::tech &tech;
+    const gds_lookup &lookup;
+    std::size_t min_size;
+    box_map rect_map;
+    std::map<std::tuple<gds_layer_t, offset_t, offset_t>, std::string> rect_cells;
+    std::vector<via_group> via_list;
+    // the group of the last via, as similar vias are usually added together
+    std::size_t via_idx = 0;
+    std::size_t num_via_cells = 0;
+    std::size_t num_rect_cells = 0;
+
+  public:
+    array_writer(spdlog::logger &logger, gds_buffer &cell_buf, const std::string &cell_name,
+                 const std::vector<tval_t> &time_vec, const layout::tech &tech,
+                 const gds_lookup &lookup, std::size_t min_size)
+        : logger(logger), cell_buf(cell_buf), cell_name(cell_name), time_vec(time_vec), tech(tech),
+          lookup(lookup), min_size(min_size) {}
+
+    std::vector<box_t> *get_box_list(const gds_layer_t &key) { return &rect_map[key]; }
+
+    void add_via(const layout::via &v) {
+        if (orient(v.xform) != oR0) {
+            if (auto layers = get_via_gds_layers(logger, tech, lookup, v.get_via_id())) {
+                for (const auto &[key, box] : get_via_boxes(*layers, v)) {
+                    rect_map[key].push_back(box);
+                }
+            }
+            return;
+        }
+        if (auto group = get_via_group(v))
+            group->pt_list.push_back(location(v.xform));
     }
-    auto gkey2 = lookup.get_gds_layer(lay2_key);
-    if (!gkey2) {
-        logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping via.",
-                    lay2_key.first, lay2_key.second);
-        return;
+
+    /** Writes the collected vias and rectangles to out, which holds the structure body.
+     */
+    void write_arrays(gds_buffer &out) {
+        for (auto &group : via_list) {
+            for_each_array(std::move(group.pt_list), max_gds_array,
+                           [this, &out, &group](const point &origin, cnt_t nx, cnt_t ny,
+                                                offset_t spx, offset_t spy) {
+                               if (nx * ny >= min_size) {
+                                   write_instance(logger, out, get_via_cell(group), "",
+                                                  make_xform(origin[0], origin[1]), nx, ny, spx,
+                                                  spy);
+                                   return;
+                               }
+                               for (cnt_t idx = 0; idx < nx * ny; ++idx) {
+                                   auto dx = origin[0] + static_cast<offset_t>(idx % nx) * spx;
+                                   auto dy = origin[1] + static_cast<offset_t>(idx / nx) * spy;
+                                   for (const auto &[key, box] : group.box_list) {
+                                       rect_map[key].push_back(get_move_by(box, dx, dy));
+                                   }
+                               }
+                           });
+        }
+        write_boxes(out, rect_map);
     }
-    auto gkeyc = lookup.get_gds_layer(cut_key);
-    if (!gkeyc) {
-        logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping via.",
-                    cut_key.first, cut_key.second);
-        return;
+
+  private:
+    via_group *get_via_group(const layout::via &v) {
+        auto matches = [&v](const via_group &group) {
+            return group.via_ptr->get_via_id() == v.get_via_id() &&
+                   group.via_ptr->get_params() == v.get_params();
+        };
+        if (via_idx < via_list.size() && matches(via_list[via_idx]))
+            return &via_list[via_idx];
+        for (via_idx = 0; via_idx < via_list.size(); ++via_idx) {
+            if (matches(via_list[via_idx]))
+                return &via_list[via_idx];
+        }
+
+        auto layers = get_via_gds_layers(logger, tech, lookup, v.get_via_id());
+        if (!layers)
+            return nullptr;
+        auto &group = via_list.emplace_back();
+        group.via_ptr = &v;
+        group.box_list =
+            get_via_boxes(*layers, layout::via(make_xform(), v.get_via_id(), v.get_params()));
+        via_idx = via_list.size() - 1;
+        return &group;
+    }
+
+    void write_cell(const std::string &name, const gds_buffer &body) {
+        write_struct_begin(logger, cell_buf, time_vec);
+        write_struct_name(logger, cell_buf, name);
+        cell_buf.append(body);
+        write_struct_end(logger, cell_buf);
+    }
+
+    // the next generated cell name of the given kind that is not a structure of the library
+    std::string get_new_name(const char *kind, std::size_t &cnt) {
+        auto ans = fmt::format("{}${}{}", cell_name, kind, cnt++);
+        while (lookup.has_struct_name(ans)) {
+            ans = fmt::format("{}${}{}", cell_name, kind, cnt++);
+        }
+        return ans;
+    }
+
+    const std::string &get_via_cell(via_group &group) {
+        if (group.cell_name.empty()) {
+            group.cell_name = get_new_name("via", num_via_cells);
+            box_map via_map;
+            for (const auto &[key, box] : group.box_list) {
+                via_map[key].push_back(box);
+            }
+            gds_buffer body;
+            write_boxes(body, via_map);
+            write_cell(group.cell_name, body);
+        }
+        return group.cell_name;
+    }
+
+    const std::string &get_rect_cell(const gds_layer_t &key, offset_t w, offset_t h) {
+        auto [iter, is_new] = rect_cells.emplace(std::make_tuple(key, w, h), std::string());
+        if (is_new) {
+            iter->second = get_new_name("rect", num_rect_cells);
+            gds_buffer body;
+            write_box(logger, body, key.first, key.second, box_t(0, 0, w, h));
+            write_cell(iter->second, body);
+        }
+        return iter->second;
     }
-    auto [glay1, gpurp1] = *gkey1;
-    auto [gcl, gcp] = *gkeyc;
-    auto [glay2, gpurp2] = *gkey2;
-    write_box(logger, stream, glay1, gpurp1, layout::get_bot_box(v));
-    write_box(logger, stream, glay2, gpurp2, layout::get_top_box(v));
-    get_via_cuts(v, rect_writer(logger, stream, gcl, gcp));
-}
 
-void write_lay_pin(spdlog::logger &logger, std::ostream &stream, glay_t lay, gpurp_t purp,
+    // writes boxes of the same size on a regular grid as arrays, and the rest as boxes
+    void write_boxes(gds_buffer &out, const box_map &shape_map) {
+        auto min_num = std::max(min_size, static_cast<std::size_t>(2));
+        for (const auto &[key, box_list] : shape_map) {
+            std::map<std::pair<offset_t, offset_t>, std::vector<point>> size_map;
+            for (const auto &box : box_list) {
+                size_map[{width(box), height(box)}].push_back({xl(box), yl(box)});
+            }
+            for (auto &[dim, pt_list] : size_map) {
+                auto [w, h] = dim;
+                for_each_array(std::move(pt_list), max_gds_array,
+                               [this, &out, &key = key, min_num, w = w,
+                                h = h](const point &origin, cnt_t nx, cnt_t ny, offset_t spx,
+                                       offset_t spy) {
+                                   if (nx * ny >= min_num) {
+                                       write_instance(logger, out, get_rect_cell(key, w, h), "",
+                                                      make_xform(origin[0], origin[1]), nx, ny,
+                                                      spx, spy);
+                                       return;
+                                   }
+                                   for (cnt_t idx = 0; idx < nx * ny; ++idx) {
+                                       auto x0 = origin[0] + static_cast<offset_t>(idx % nx) * spx;
+                                       auto y0 = origin[1] + static_cast<offset_t>(idx / nx) * spy;
+                                       write_box(logger, out, key.first, key.second,
+                                                 box_t(x0, y0, x0 + w, y0 + h));
+                                   }
+                               });
+            }
+        }
+    }
+};
+
+void write_lay_pin(spdlog::logger &logger, gds_buffer &buf, glay_t lay, gpurp_t purp,
                    const layout::pin &pin, bool make_pin_obj, double resolution) {
     if (!is_physical(pin)) {
         logger.warn("non-physical bbox {} on pin layer ({}, {}), skipping.", to_string(pin), lay,
@@ -198,34 +539,43 @@ void write_lay_pin(spdlog::logger &logger, std::ostream &stream, glay_t lay, gpu
         xform = make_xform(xc, yc, oR0);
     }
 
-    write_text(logger, stream, lay, purp, pin.get_label(), xform, text_h, resolution);
+    write_text(logger, buf, lay, purp, pin.get_label(), xform, text_h, resolution);
     if (make_pin_obj) {
-        write_box(logger, stream, lay, purp, pin);
+        write_box(logger, buf, lay, purp, pin);
     }
 }
 
-void write_lay_label(spdlog::logger &logger, std::ostream &stream, const layout::label &lab,
+void write_lay_label(spdlog::logger &logger, gds_buffer &buf, const layout::label &lab,
                      double resolution) {
     auto [lay, purp] = lab.get_key();
-    write_text(logger, stream, lay, purp, lab.get_text(), lab.get_xform(), lab.get_height(),
+    write_text(logger, buf, lay, purp, lab.get_text(), lab.get_xform(), lab.get_height(),
                resolution);
 }
 
-void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+// encodes the structure of the cellview into buf, after the array cells it uses
+void write_lay_cellview(spdlog::logger &logger, gds_buffer &buf, const std::string &cell_name,
                         const cbag::layout::cellview &cv,
                         const std::unordered_map<std::string, std::string> &rename_map,
                         const std::vector<tval_t> &time_vec, const gds_lookup &lookup) {
-    write_struct_begin(logger, stream, time_vec);
-    write_struct_name(logger, stream, cell_name);
-
-    logger.info("Export layout instances.");
+    auto start_time = std::chrono::steady_clock::now();
+    auto start_size = buf.size();
+    auto tech_ptr = cv.get_tech();
+    // with arrays, generated cells go to buf first, so the structure is encoded separately
+    auto min_array_size = lookup.get_min_array_size();
+    gds_buffer body;
+    auto &out = (min_array_size > 0) ? body : buf;
+    array_writer arr_writer(logger, buf, cell_name, time_vec, *tech_ptr, lookup, min_array_size);
+    write_struct_begin(logger, out, time_vec);
+    write_struct_name(logger, out, cell_name);
+
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout instances.");
     for (auto iter = cv.begin_inst(); iter != cv.end_inst(); ++iter) {
         auto &[inst_name, inst] = *iter;
-        write_instance(logger, stream, inst.get_cell_name(&rename_map), inst_name, inst.xform,
+        write_instance(logger, out, inst.get_cell_name(&rename_map), inst_name, inst.xform,
                        inst.nx, inst.ny, inst.spx, inst.spy);
     }
 
-    logger.info("Export layout geometries.");
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout geometries.");
     for (auto iter = cv.begin_geometry(); iter != cv.end_geometry(); ++iter) {
         auto &[layer_key, geo] = *iter;
         auto gkey = lookup.get_gds_layer(layer_key);
@@ -234,18 +584,22 @@ void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std:
                         layer_key.first, layer_key.second);
         } else {
             auto [glay, gpurp] = *gkey;
-            write_lay_geometry(logger, stream, glay, gpurp, geo);
+            auto box_list = (min_array_size > 0) ? arr_writer.get_box_list(*gkey) : nullptr;
+            write_lay_geometry(logger, out, glay, gpurp, geo, lookup.get_rect_vertices(),
+                               box_list);
         }
     }
 
-    logger.info("Export layout vias.");
-    auto tech_ptr = cv.get_tech();
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout vias.");
     auto resolution = tech_ptr->get_resolution();
     for (auto iter = cv.begin_via(); iter != cv.end_via(); ++iter) {
-        write_lay_via(logger, stream, *tech_ptr, lookup, *iter);
+        if (min_array_size > 0)
+            arr_writer.add_via(*iter);
+        else
+            write_lay_via(logger, out, *tech_ptr, lookup, *iter);
     }
 
-    logger.info("Export layout pins.");
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout pins.");
     auto purp = tech_ptr->get_pin_purpose();
     auto make_pin_obj = tech_ptr->get_make_pin();
     for (auto iter = cv.begin_pin(); iter != cv.end_pin(); ++iter) {
@@ -257,17 +611,17 @@ void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std:
         } else {
             auto [glay, gpurp] = *gkey;
             for (const auto &pin : pin_list) {
-                write_lay_pin(logger, stream, glay, gpurp, pin, make_pin_obj, resolution);
+                write_lay_pin(logger, out, glay, gpurp, pin, make_pin_obj, resolution);
             }
         }
     }
 
-    logger.info("Export layout labels.");
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout labels.");
     for (auto iter = cv.begin_label(); iter != cv.end_label(); ++iter) {
-        write_lay_label(logger, stream, *iter, resolution);
+        write_lay_label(logger, out, *iter, resolution);
     }
 
-    logger.info("Export layout boundaries.");
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout boundaries.");
     for (auto iter = cv.begin_boundary(); iter != cv.end_boundary(); ++iter) {
         auto btype = iter->get_type();
         auto gkey = lookup.get_gds_layer(btype);
@@ -275,13 +629,105 @@ void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std:
             logger.warn("Cannot find boundary type {} in object map.  Skipping boundary.", btype);
         } else {
             auto [glay, gpurp] = *gkey;
-            write_polygon(logger, stream, glay, gpurp, *iter);
+            write_polygon(logger, out, glay, gpurp, *iter);
+        }
+    }
+
+    if (min_array_size > 0) {
+        SPDLOG_LOGGER_TRACE(&logger, "Export layout arrays.");
+        arr_writer.write_arrays(out);
+    }
+
+    write_struct_end(logger, out);
+    if (min_array_size > 0)
+        buf.append(body);
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start_time;
+    logger.info("Wrote GDS cellview {}: {} instances, {} layers, {} vias, {} labels, {} bytes "
+                "in {:.3f} s.",
+                cell_name, std::distance(cv.begin_inst(), cv.end_inst()),
+                std::distance(cv.begin_geometry(), cv.end_geometry()),
+                std::distance(cv.begin_via(), cv.end_via()),
+                std::distance(cv.begin_label(), cv.end_label()), buf.size() - start_size,
+                diff.count());
+}
+
+void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+                        const cbag::layout::cellview &cv,
+                        const std::unordered_map<std::string, std::string> &rename_map,
+                        const std::vector<tval_t> &time_vec, const gds_lookup &lookup) {
+    gds_buffer buf;
+    write_lay_cellview(logger, buf, cell_name, cv, rename_map, time_vec, lookup);
+    buf.flush(stream);
+}
+
+// number of cells per thread serialized before the buffers are written out
+constexpr std::size_t cells_per_thread = 16;
+
+// the structure names given to each cellview name, with the index of the cell
+using rename_history =
+    std::unordered_map<std::string, std::vector<std::pair<std::size_t, std::string>>>;
+
+// the renames of the masters of the given cell that are done before it in the serial writer
+std::unordered_map<std::string, std::string>
+get_rename_map(const layout::cellview &cv, const rename_history &history, std::size_t idx) {
+    std::unordered_map<std::string, std::string> ans;
+    for (auto iter = cv.begin_inst(); iter != cv.end_inst(); ++iter) {
+        const auto &master_name = iter->second.get_cell_name(nullptr);
+        auto hist_iter = history.find(master_name);
+        if (hist_iter == history.end())
+            continue;
+        for (const auto &[cell_idx, cell_name] : hist_iter->second) {
+            if (cell_idx >= idx)
+                break;
+            ans[master_name] = cell_name;
         }
     }
+    return ans;
+}
 
-    write_struct_end(logger, stream);
+void write_lay_cellviews(
+    spdlog::logger &logger, std::ostream &stream,
+    const std::vector<std::pair<std::string, const layout::cellview *>> &cell_list,
+    const std::vector<tval_t> &time_vec, const gds_lookup &lookup, std::size_t num_threads,
+    bool merge_cells) {
+    auto num = cell_list.size();
+    rename_history history;
+    // merged cells are not written, and later cells refer to the structure they are merged into
+    std::vector<bool> is_merged(num, false);
+    cell_merger merger;
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        auto &[cell_name, cv_ptr] = cell_list[idx];
+        std::optional<std::string> merge_name;
+        if (merge_cells)
+            merge_name = merger.add(*cv_ptr, cell_name, get_rename_map(*cv_ptr, history, idx));
+        if (merge_name) {
+            logger.info("Merging layout cell {} into {}", cell_name, *merge_name);
+            is_merged[idx] = true;
+        }
+        history[cv_ptr->get_name()].emplace_back(idx, merge_name ? *merge_name : cell_name);
+    }
 
-    logger.info("Finish GDS export.");
+    auto worker_ptr = (num_threads > 1) ? make_worker_logger(logger) : nullptr;
+    auto &worker_logger = worker_ptr ? *worker_ptr : logger;
+    auto batch_size = cells_per_thread * std::max(num_threads, static_cast<std::size_t>(1));
+    // buffers are emptied when written out, but keep their memory for the next batch
+    std::vector<gds_buffer> buf_list(std::min(num, batch_size));
+    for (std::size_t start = 0; start < num; start += batch_size) {
+        auto stop = std::min(num, start + batch_size);
+        util::parallel_for(stop - start, num_threads, [&](std::size_t offset) {
+            auto idx = start + offset;
+            if (is_merged[idx])
+                return;
+            auto &[cell_name, cv_ptr] = cell_list[idx];
+            auto rename_map = get_rename_map(*cv_ptr, history, idx);
+            write_lay_cellview(worker_logger, buf_list[offset], cell_name, *cv_ptr, rename_map,
+                               time_vec, lookup);
+        });
+        for (std::size_t offset = 0; offset < stop - start; ++offset) {
+            buf_list[offset].flush(stream);
+        }
+    }
 }
 
 } // namespace gdsii
@@ -1,6 +1,8 @@
 #include <array>
-#include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <cbag/common/box_t_util.h>
@@ -17,6 +19,7 @@ namespace gdsii {
 using size_type = uint16_t;
 
 constexpr auto MAX_SIZE = UINT16_MAX;
+constexpr auto MAX_XY_SIZE = (MAX_SIZE - 4) / sizeof(uint32_t);
 constexpr auto TYPE_SIZE = sizeof(record_type);
 constexpr auto SIZE_SIZE = sizeof(size_type);
 constexpr auto VERSION = static_cast<uint16_t>(5);
@@ -40,43 +43,26 @@ class uchar_iter {
     bool operator!=(const uchar_iter &other) { return iter != other.iter; }
 };
 
-template <typename iT> class point_xy_iter {
-  private:
-    iT pt_iter;
-    bool is_y = false;
-
-  public:
-    point_xy_iter() = default;
-    explicit point_xy_iter(iT pt_iter, bool is_y = false)
-        : pt_iter(std::move(pt_iter)), is_y(is_y) {}
-
-    uint32_t operator*() const {
-        auto val = (is_y) ? pt_iter->y() : pt_iter->x();
-        return *reinterpret_cast<uint32_t *>(&val);
-    }
-
-    uint32_t x() const { return pt_iter->x(); }
-
-    uint32_t y() const { return pt_iter->y(); }
-
-    point_xy_iter &operator++() {
-        if (is_y) {
-            ++pt_iter;
-        }
-        is_y = !is_y;
-        return *this;
-    }
-    bool operator!=(const point_xy_iter &other) const noexcept {
-        return pt_iter != other.pt_iter || is_y != other.is_y;
-    }
-};
+template <typename T, util::IsUInt<T> = 0> char *store_big_endian(char *ptr, T val) {
+    if constexpr (sizeof(T) == 2)
+        val = __builtin_bswap16(val);
+    else if constexpr (sizeof(T) == 4)
+        val = __builtin_bswap32(val);
+    else if constexpr (sizeof(T) == 8)
+        val = __builtin_bswap64(val);
+    std::memcpy(ptr, &val, sizeof(T));
+    return ptr + sizeof(T);
+}
 
+// the record is encoded in place at the end of the buffer
 template <record_type R, typename iT>
-void write(std::ostream &stream, std::size_t num_data, iT start, iT stop) {
+void write(gds_buffer &buf, std::size_t num_data, iT start, iT stop) {
     constexpr auto unit_size = sizeof(*start);
 
     auto size_test = unit_size * num_data + SIZE_SIZE + TYPE_SIZE;
-    assert(size_test <= MAX_SIZE);
+    if (size_test > MAX_SIZE)
+        throw std::runtime_error("Cannot write GDS record of " + std::to_string(size_test) +
+                                 " bytes.");
 
     auto size = static_cast<size_type>(size_test);
     bool add_zero = false;
@@ -84,50 +70,55 @@ void write(std::ostream &stream, std::size_t num_data, iT start, iT stop) {
         ++size;
         add_zero = true;
     }
-    write_bytes(stream, size);
-    write_bytes(stream, static_cast<uint16_t>(R));
+    auto ptr = store_big_endian(buf.extend(size), size);
+    ptr = store_big_endian(ptr, static_cast<uint16_t>(R));
     for (; start != stop; ++start) {
-        write_bytes(stream, *start);
-    }
-    if (add_zero) {
-        stream.put('\0');
+        ptr = store_big_endian(ptr, *start);
     }
+    if (add_zero)
+        *ptr = '\0';
 }
 
 template <record_type R>
-void write_grp_begin(spdlog::logger &logger, std::ostream &stream,
-                     const std::vector<tval_t> &time_vec) {
+void write_grp_begin(spdlog::logger &logger, gds_buffer &buf, const std::vector<tval_t> &time_vec) {
     std::vector<tval_t> data(time_vec.begin(), time_vec.end());
     data.insert(data.end(), time_vec.begin(), time_vec.end());
-    write<R>(stream, data.size(), data.begin(), data.end());
+    write<R>(buf, data.size(), data.begin(), data.end());
 }
 
-template <record_type R> void write_empty(spdlog::logger &logger, std::ostream &stream) {
+template <record_type R> void write_empty(spdlog::logger &logger, gds_buffer &buf) {
     std::array<uint16_t, 0> tmp;
-    write<R>(stream, tmp.size(), tmp.begin(), tmp.end());
+    write<R>(buf, tmp.size(), tmp.begin(), tmp.end());
 }
 
 template <record_type R>
-void write_name(spdlog::logger &logger, std::ostream &stream, const std::string &name) {
-    write<R>(stream, name.size(), uchar_iter(name.begin()), uchar_iter(name.end()));
+void write_name(spdlog::logger &logger, gds_buffer &buf, const std::string &name) {
+    write<R>(buf, name.size(), uchar_iter(name.begin()), uchar_iter(name.end()));
 }
 
-template <record_type R>
-void write_int(spdlog::logger &logger, std::ostream &stream, uint16_t val) {
+template <record_type R> void write_int(spdlog::logger &logger, gds_buffer &buf, uint16_t val) {
     std::array<uint16_t, 1> tmp{val};
-    write<R>(stream, tmp.size(), tmp.begin(), tmp.end());
+    write<R>(buf, tmp.size(), tmp.begin(), tmp.end());
 }
 
+/** Writes the points as an XY record, with the first point repeated at the end.
+ */
 template <typename iT>
-void write_points(spdlog::logger &logger, std::ostream &stream, std::size_t num_pts, iT begin,
-                  iT end) {
-    auto start_iter = point_xy_iter(begin);
-    auto xval = start_iter.x();
-    auto yval = start_iter.y();
-    write<record_type::XY>(stream, 2 * (num_pts + 1), std::move(start_iter), point_xy_iter(end));
-    // write first point
-    write_bytes(stream, xval);
-    write_bytes(stream, yval);
+void write_points(spdlog::logger &logger, gds_buffer &buf, std::size_t num_pts, iT begin, iT end) {
+    auto num_data = 2 * (num_pts + 1);
+    if (num_pts == 0 || num_data > MAX_XY_SIZE)
+        throw std::runtime_error("Cannot write polygon with " + std::to_string(num_pts) +
+                                 " points to GDS.");
+
+    auto size = static_cast<size_type>(sizeof(uint32_t) * (num_data + 1));
+    auto ptr = store_big_endian(buf.extend(size), size);
+    ptr = store_big_endian(ptr, static_cast<uint16_t>(record_type::XY));
+    auto first = ptr;
+    for (; begin != end; ++begin) {
+        ptr = store_big_endian(ptr, interpret_as<uint32_t>(begin->x()));
+        ptr = store_big_endian(ptr, interpret_as<uint32_t>(begin->y()));
+    }
+    std::memcpy(ptr, first, 2 * sizeof(uint32_t));
 }
 
 std::tuple<uint32_t, uint16_t> get_angle_flag(orientation orient) {
@@ -154,24 +145,24 @@ std::tuple<uint32_t, uint16_t> get_angle_flag(orientation orient) {
     }
 }
 
-void write_transform(spdlog::logger &logger, std::ostream &stream, const transformation &xform,
+void write_transform(spdlog::logger &logger, gds_buffer &buf, const transformation &xform,
                      double mag, cnt_t nx, cnt_t ny, offset_t spx, offset_t spy) {
     auto [angle, bit_flag] = get_angle_flag(orient(xform));
 
-    write_int<record_type::STRANS>(logger, stream, bit_flag);
+    write_int<record_type::STRANS>(logger, buf, bit_flag);
     if (mag != 1.0) {
         std::array<uint64_t, 1> data{double_to_gds(mag)};
-        write<record_type::MAG>(stream, data.size(), data.begin(), data.end());
+        write<record_type::MAG>(buf, data.size(), data.begin(), data.end());
     }
     if (angle != 0) {
         std::array<uint64_t, 1> data{double_to_gds((double)angle)};
-        write<record_type::ANGLE>(stream, data.size(), data.begin(), data.end());
+        write<record_type::ANGLE>(buf, data.size(), data.begin(), data.end());
     }
     if (nx > 1 || ny > 1) {
         // convert BAG array parameters to GDS array parameters
         auto [gds_nx, gds_ny, gds_spx, gds_spy] = cbag::convert_array(xform, nx, ny, spx, spy);
         std::array<uint16_t, 2> nxy{static_cast<uint16_t>(gds_nx), static_cast<uint16_t>(gds_ny)};
-        write<record_type::COLROW>(stream, nxy.size(), nxy.begin(), nxy.end());
+        write<record_type::COLROW>(buf, nxy.size(), nxy.begin(), nxy.end());
         auto [x1, y1] = location(xform);
         decltype(spx) x2 = gds_spx * gds_nx;
         decltype(spx) y2 = 0;
@@ -182,117 +173,117 @@ void write_transform(spdlog::logger &logger, std::ostream &stream, const transfo
         std::array<uint32_t, 6> xy{interpret_as<uint32_t>(x1), interpret_as<uint32_t>(y1),
                                    interpret_as<uint32_t>(x2), interpret_as<uint32_t>(y2),
                                    interpret_as<uint32_t>(x3), interpret_as<uint32_t>(y3)};
-        write<record_type::XY>(stream, xy.size(), xy.begin(), xy.end());
+        write<record_type::XY>(buf, xy.size(), xy.begin(), xy.end());
     } else {
         std::array<uint32_t, 2> xy{interpret_as<uint32_t>(x(xform)),
                                    interpret_as<uint32_t>(y(xform))};
-        write<record_type::XY>(stream, xy.size(), xy.begin(), xy.end());
+        write<record_type::XY>(buf, xy.size(), xy.begin(), xy.end());
     }
 }
 
-void write_header(spdlog::logger &logger, std::ostream &stream) {
-    write_int<record_type::HEADER>(logger, stream, VERSION);
+void write_header(spdlog::logger &logger, gds_buffer &buf) {
+    write_int<record_type::HEADER>(logger, buf, VERSION);
 }
 
-void write_units(spdlog::logger &logger, std::ostream &stream, double resolution,
-                 double user_unit) {
+void write_units(spdlog::logger &logger, gds_buffer &buf, double resolution, double user_unit) {
     std::array<uint64_t, 2> data{double_to_gds(resolution), double_to_gds(resolution * user_unit)};
-    write<record_type::UNITS>(stream, data.size(), data.begin(), data.end());
+    write<record_type::UNITS>(buf, data.size(), data.begin(), data.end());
 }
 
-void write_lib_begin(spdlog::logger &logger, std::ostream &stream,
-                     const std::vector<tval_t> &time_vec) {
-    write_grp_begin<record_type::BGNLIB>(logger, stream, time_vec);
+void write_lib_begin(spdlog::logger &logger, gds_buffer &buf, const std::vector<tval_t> &time_vec) {
+    write_grp_begin<record_type::BGNLIB>(logger, buf, time_vec);
 }
 
-void write_lib_name(spdlog::logger &logger, std::ostream &stream, const std::string &name) {
-    write_name<record_type::LIBNAME>(logger, stream, name);
+void write_lib_name(spdlog::logger &logger, gds_buffer &buf, const std::string &name) {
+    write_name<record_type::LIBNAME>(logger, buf, name);
 }
 
-void write_lib_end(spdlog::logger &logger, std::ostream &stream) {
-    write_empty<record_type::ENDLIB>(logger, stream);
+void write_lib_end(spdlog::logger &logger, gds_buffer &buf) {
+    write_empty<record_type::ENDLIB>(logger, buf);
 }
 
-void write_struct_begin(spdlog::logger &logger, std::ostream &stream,
+void write_struct_begin(spdlog::logger &logger, gds_buffer &buf,
                         const std::vector<tval_t> &time_vec) {
-    write_grp_begin<record_type::BGNSTR>(logger, stream, time_vec);
+    write_grp_begin<record_type::BGNSTR>(logger, buf, time_vec);
 }
 
-void write_struct_name(spdlog::logger &logger, std::ostream &stream, const std::string &name) {
-    write_name<record_type::STRNAME>(logger, stream, name);
+void write_struct_name(spdlog::logger &logger, gds_buffer &buf, const std::string &name) {
+    write_name<record_type::STRNAME>(logger, buf, name);
 }
 
-void write_struct_end(spdlog::logger &logger, std::ostream &stream) {
-    write_empty<record_type::ENDSTR>(logger, stream);
+void write_struct_end(spdlog::logger &logger, gds_buffer &buf) {
+    write_empty<record_type::ENDSTR>(logger, buf);
 }
 
-void write_element_end(spdlog::logger &logger, std::ostream &stream) {
-    write_empty<record_type::ENDEL>(logger, stream);
+void write_element_end(spdlog::logger &logger, gds_buffer &buf) {
+    write_empty<record_type::ENDEL>(logger, buf);
 }
 
-void write_prop_inst_name(spdlog::logger &logger, std::ostream &stream, const std::string &name) {
-    write_int<record_type::PROPATTR>(logger, stream, PROP_INST_NAME);
-    write_name<record_type::PROPVALUE>(logger, stream, name);
+void write_prop_inst_name(spdlog::logger &logger, gds_buffer &buf, const std::string &name) {
+    write_int<record_type::PROPATTR>(logger, buf, PROP_INST_NAME);
+    write_name<record_type::PROPVALUE>(logger, buf, name);
 }
 
-void write_polygon(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose,
+void write_polygon(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
                    const layout::polygon &poly) {
-    write_empty<record_type::BOUNDARY>(logger, stream);
-    write_int<record_type::LAYER>(logger, stream, layer);
-    write_int<record_type::DATATYPE>(logger, stream, purpose);
-    write_points(logger, stream, poly.size(), poly.begin(), poly.end());
-    write_element_end(logger, stream);
+    write_empty<record_type::BOUNDARY>(logger, buf);
+    write_int<record_type::LAYER>(logger, buf, layer);
+    write_int<record_type::DATATYPE>(logger, buf, purpose);
+    write_points(logger, buf, poly.size(), poly.begin(), poly.end());
+    write_element_end(logger, buf);
 }
 
-void write_box(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose,
+void write_box(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
                const box_t &b) {
-    write_empty<record_type::BOX>(logger, stream);
-    write_int<record_type::LAYER>(logger, stream, layer);
-    write_int<record_type::BOXTYPE>(logger, stream, purpose);
+    write_empty<record_type::BOX>(logger, buf);
+    write_int<record_type::LAYER>(logger, buf, layer);
+    write_int<record_type::BOXTYPE>(logger, buf, purpose);
 
     auto x0 = interpret_as<uint32_t>(xl(b));
     auto x1 = interpret_as<uint32_t>(xh(b));
     auto y0 = interpret_as<uint32_t>(yl(b));
     auto y1 = interpret_as<uint32_t>(yh(b));
     std::array<uint32_t, 10> xy{x0, y0, x1, y0, x1, y1, x0, y1, x0, y0};
-    write<record_type::XY>(stream, xy.size(), xy.begin(), xy.end());
-    write_element_end(logger, stream);
+    write<record_type::XY>(buf, xy.size(), xy.begin(), xy.end());
+    write_element_end(logger, buf);
 }
 
-void write_arr_instance(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+void write_arr_instance(spdlog::logger &logger, gds_buffer &buf, const std::string &cell_name,
                         const std::string &inst_name, const transformation &xform, cnt_t nx,
                         cnt_t ny, offset_t spx, offset_t spy) {
-    write_empty<record_type::AREF>(logger, stream);
-    write_name<record_type::SNAME>(logger, stream, cell_name);
-    write_transform(logger, stream, xform, 1.0, nx, ny, spx, spy);
-    write_prop_inst_name(logger, stream, inst_name);
-    write_element_end(logger, stream);
+    write_empty<record_type::AREF>(logger, buf);
+    write_name<record_type::SNAME>(logger, buf, cell_name);
+    write_transform(logger, buf, xform, 1.0, nx, ny, spx, spy);
+    if (!inst_name.empty())
+        write_prop_inst_name(logger, buf, inst_name);
+    write_element_end(logger, buf);
 }
 
-void write_instance(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+void write_instance(spdlog::logger &logger, gds_buffer &buf, const std::string &cell_name,
                     const std::string &inst_name, const transformation &xform, cnt_t nx, cnt_t ny,
                     offset_t spx, offset_t spy) {
     if (nx > 1 || ny > 1) {
-        write_arr_instance(logger, stream, cell_name, inst_name, xform, nx, ny, spx, spy);
+        write_arr_instance(logger, buf, cell_name, inst_name, xform, nx, ny, spx, spy);
     } else {
-        write_empty<record_type::SREF>(logger, stream);
-        write_name<record_type::SNAME>(logger, stream, cell_name);
-        write_transform(logger, stream, xform);
-        write_prop_inst_name(logger, stream, inst_name);
-        write_element_end(logger, stream);
+        write_empty<record_type::SREF>(logger, buf);
+        write_name<record_type::SNAME>(logger, buf, cell_name);
+        write_transform(logger, buf, xform);
+        if (!inst_name.empty())
+            write_prop_inst_name(logger, buf, inst_name);
+        write_element_end(logger, buf);
     }
 }
 
-void write_text(spdlog::logger &logger, std::ostream &stream, glay_t layer, gpurp_t purpose,
+void write_text(spdlog::logger &logger, gds_buffer &buf, glay_t layer, gpurp_t purpose,
                 const std::string &text, const transformation &xform, offset_t height,
                 double resolution) {
-    write_empty<record_type::TEXT>(logger, stream);
-    write_int<record_type::LAYER>(logger, stream, layer);
-    write_int<record_type::TEXTTYPE>(logger, stream, purpose);
-    write_int<record_type::PRESENTATION>(logger, stream, TEXT_PRESENTATION);
-    write_transform(logger, stream, xform, height * resolution);
-    write_name<record_type::STRING>(logger, stream, text);
-    write_element_end(logger, stream);
+    write_empty<record_type::TEXT>(logger, buf);
+    write_int<record_type::LAYER>(logger, buf, layer);
+    write_int<record_type::TEXTTYPE>(logger, buf, purpose);
+    write_int<record_type::PRESENTATION>(logger, buf, TEXT_PRESENTATION);
+    write_transform(logger, buf, xform, height * resolution);
+    write_name<record_type::STRING>(logger, buf, text);
+    write_element_end(logger, buf);
 }
 
 } // namespace gdsii
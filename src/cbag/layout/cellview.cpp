@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <tuple>
+#include <type_traits>
 
 #include <cbag/util/binary_iterator.h>
 
+#include <cbag/common/box_t_util.h>
 #include <cbag/common/transformation_util.h>
 #include <cbag/layout/cellview.h>
 #include <cbag/layout/grid_object.h>
@@ -44,7 +47,7 @@ class poly45_writer {
     void record_last() const {
         if (has_value) {
             auto[spx, spy] = get_margins(grid, key, lev, last);
-            index.insert(last, spx, spy);
+            index.insert(last, spx, spy, key);
         }
     }
 
@@ -54,12 +57,90 @@ class poly45_writer {
 };
 
 struct cellview::helper {
-    static void add_inst(cellview &self, const instance &inst) {
+    static void hash_xform(std::size_t &seed, const transformation &xform) {
+        auto [x, y] = location(xform);
+        boost::hash_combine(seed, x);
+        boost::hash_combine(seed, y);
+        boost::hash_combine(seed, orient_code(xform));
+    }
+
+    static void hash_box(std::size_t &seed, const box_t &box) {
+        boost::hash_combine(seed, xl(box));
+        boost::hash_combine(seed, yl(box));
+        boost::hash_combine(seed, xh(box));
+        boost::hash_combine(seed, yh(box));
+    }
+
+    template <typename T> static void hash_points(std::size_t &seed, const T &obj) {
+        for (const auto &pt : obj) {
+            boost::hash_combine(seed, pt.x());
+            boost::hash_combine(seed, pt.y());
+        }
+    }
+
+    // the hash of a shape as it is added, so removing the shape can subtract it
+    template <typename T> static std::size_t get_shape_hash(const layer_t &key, const T &obj) {
+        auto seed = boost::hash_value(key);
+        if constexpr (std::is_same_v<T, box_t>) {
+            hash_box(seed, obj);
+        } else if constexpr (std::is_same_v<T, polygon45_set>) {
+            std::vector<polygon45> poly_list;
+            obj.get(poly_list);
+            for (const auto &poly : poly_list) {
+                hash_points(seed, poly);
+            }
+        } else {
+            hash_points(seed, obj);
+        }
+        return seed;
+    }
+
+    static std::size_t get_inst_hash(const std::string &inst_name, const instance &inst,
+                                     const str_map_t *rename_map = nullptr) {
+        auto seed = boost::hash_value(inst_name);
+        boost::hash_combine(seed, inst.get_cell_name(rename_map));
+        hash_xform(seed, inst.xform);
+        boost::hash_combine(seed, inst.nx);
+        boost::hash_combine(seed, inst.ny);
+        boost::hash_combine(seed, inst.spx);
+        boost::hash_combine(seed, inst.spy);
+        return seed;
+    }
+
+    static std::size_t get_via_hash(const via &v) {
+        auto seed = boost::hash_value(v.get_via_id());
+        hash_xform(seed, v.xform);
+        auto &params = v.get_params();
+        for (const auto &vec : {params.cut_dim, params.cut_spacing, params.enc[0], params.enc[1],
+                                params.off[0], params.off[1]}) {
+            boost::hash_combine(seed, vec[0]);
+            boost::hash_combine(seed, vec[1]);
+        }
+        boost::hash_combine(seed, params.num[0]);
+        boost::hash_combine(seed, params.num[1]);
+        return seed;
+    }
+
+    static std::size_t get_blockage_hash(const blockage &obj) {
+        auto seed = boost::hash_value(obj.get_layer());
+        boost::hash_combine(seed, static_cast<int>(obj.get_type()));
+        hash_points(seed, obj);
+        return seed;
+    }
+
+    static std::size_t get_boundary_hash(const boundary &obj) {
+        auto seed = boost::hash_value(static_cast<int>(obj.get_type()));
+        hash_points(seed, obj);
+        return seed;
+    }
+
+    static const std::string &add_inst(cellview &self, const instance &inst) {
         auto &inst_name = inst.get_inst_name();
         if (!inst_name.empty()) {
             // test if given name is valid
-            if (self.inst_map.emplace(inst_name, inst).second)
-                return;
+            auto [iter, success] = self.inst_map.emplace(inst_name, inst);
+            if (success)
+                return iter->first;
         }
         auto map_end = self.inst_map.end();
         cbag::util::binary_iterator<cnt_t> iter(self.inst_name_cnt);
@@ -73,7 +154,7 @@ struct cellview::helper {
         }
 
         self.inst_name_cnt = *(iter.get_save());
-        self.inst_map.emplace("X" + std::to_string(self.inst_name_cnt), inst);
+        return self.inst_map.emplace("X" + std::to_string(self.inst_name_cnt), inst).first->first;
     }
 
     static geometry &make_geometry(cellview &self, layer_t key) {
@@ -84,27 +165,126 @@ struct cellview::helper {
         return iter->second;
     }
 
-    static std::shared_ptr<geo_index> &get_geo_index(cellview &self, level_t lev) {
-        return self.index_list[lev - self.get_grid()->get_bot_level()];
-    }
-
-    template <typename T> static void add_shape(cellview &self, layer_t key, const T &obj) {
+    template <typename T>
+    static geo_handle add_shape(cellview &self, layer_t key, const T &obj) {
         auto &geo = make_geometry(self, key);
         geo.add_shape(obj);
+        self.content_hash += get_shape_hash(key, obj);
 
         auto lev_opt = self.get_tech()->get_level(key);
         if (lev_opt) {
-            auto &grid = *self.get_grid();
-            auto &index = get_geo_index(self, *lev_opt);
-            if constexpr (std::is_base_of_v<polygon45_set, std::decay_t<T>>) {
-                poly45_writer writer(*index, grid, key, *lev_opt);
-                obj.get(writer);
-                writer.record_last();
-            } else {
-                auto[spx, spy] = get_margins(grid, key, *lev_opt, obj);
-                index->insert(obj, spx, spy);
+            if (self.lazy_index) {
+                auto idx = *lev_opt - self.get_grid()->get_bot_level();
+                self.pending_list[idx].emplace_back(pending_shape{key, obj});
+                return {};
             }
+            return index_shape(self, *lev_opt, key, obj);
         }
+        return {};
+    }
+
+    template <typename T>
+    static geo_handle index_shape(const cellview &self, level_t lev, layer_t key, const T &obj) {
+        auto &grid = *self.get_grid();
+        auto &index = self.index_list[lev - grid.get_bot_level()];
+        if constexpr (std::is_base_of_v<polygon45_set, std::decay_t<T>>) {
+            poly45_writer writer(*index, grid, key, lev);
+            obj.get(writer);
+            writer.record_last();
+            return {};
+        } else {
+            auto[spx, spy] = get_margins(grid, key, lev, obj);
+            return index->insert(obj, spx, spy, key);
+        }
+    }
+
+    static void index_inst(const cellview &self, level_t lev, const pending_inst &inst) {
+        auto &parent_index = self.index_list[lev - self.get_grid()->get_bot_level()];
+        auto &inst_index = inst.master->get_geo_index(lev);
+        inst_index->finalize();
+        parent_index->insert(inst_index, inst.xform, inst.nx, inst.ny, inst.spx, inst.spy);
+    }
+
+    static void index_pending(const cellview &self, level_t lev) {
+        auto &pending = self.pending_list[lev - self.get_grid()->get_bot_level()];
+        for (const auto &obj : pending) {
+            std::visit(
+                overload{
+                    [&self, lev](const pending_shape &v) {
+                        std::visit(
+                            [&self, lev, &v](const auto &shape) {
+                                index_shape(self, lev, v.key, shape);
+                            },
+                            v.val);
+                    },
+                    [&self, lev](const pending_inst &v) { index_inst(self, lev, v); },
+                },
+                obj);
+        }
+        std::vector<pending_object>().swap(pending);
+    }
+
+    static level_t get_edit_level(cellview &self, layer_t key) {
+        auto lev_opt = self.get_tech()->get_level(key);
+        if (!lev_opt)
+            throw std::invalid_argument("Cannot edit shapes on a layer without routing level.");
+        return *lev_opt;
+    }
+
+    // subtract a removed shape from the layer geometry, then add back the overlapping shapes
+    static void erase_geometry(cellview &self, layer_t key, const geo_index &index,
+                               const geo_object::value_type &val) {
+        auto &geo = make_geometry(self, key);
+        geo.remove_shape(val);
+        std::visit(overload{
+                       [](const geo_instance &v) {},
+                       [&self, &key](const auto &v) {
+                           self.content_hash -= get_shape_hash(key, v);
+                       },
+                   },
+                   val);
+
+        auto bnd = get_bnd_box(val, 0, 0);
+        box_t box(bnd.min_corner().get<0>(), bnd.min_corner().get<1>(),
+                  bnd.max_corner().get<0>(), bnd.max_corner().get<1>());
+        for (auto iter = index.begin_query(box, 0, 0); iter != geo_query_iter(); ++iter) {
+            if (iter->key == key) {
+                std::visit(overload{
+                               [](const geo_instance &v) {},
+                               [&geo](const auto &v) { geo.add_shape(v); },
+                           },
+                           iter->val);
+            }
+        }
+    }
+
+    static bool remove_shape(cellview &self, layer_t key, const geo_handle &h) {
+        auto lev = get_edit_level(self, key);
+        auto &index = self.get_geo_index(lev);
+        auto obj = index->find(h);
+        if (!obj || obj->key != key)
+            return false;
+        auto val = obj->val;
+        index->remove(h);
+        erase_geometry(self, key, *index, val);
+        return true;
+    }
+
+    template <typename T>
+    static geo_handle update_shape(cellview &self, layer_t key, const geo_handle &h,
+                                   const T &obj) {
+        auto lev = get_edit_level(self, key);
+        auto &index = self.get_geo_index(lev);
+        auto old_obj = index->find(h);
+        if (!old_obj || old_obj->key != key)
+            throw std::invalid_argument("Cannot update a removed shape.");
+        auto val = old_obj->val;
+        auto[spx, spy] = get_margins(*self.get_grid(), key, lev, obj);
+        auto ans = index->update(h, obj, spx, spy);
+        erase_geometry(self, key, *index, val);
+        make_geometry(self, key).add_shape(obj);
+        self.content_hash += get_shape_hash(key, obj);
+        return ans;
     }
 };
 
@@ -116,14 +296,57 @@ cellview::cellview(std::shared_ptr<const routing_grid> grid, std::string cell_na
     for (decltype(num) idx = 0; idx < num; ++idx) {
         index_list.emplace_back(std::make_shared<geo_index>());
     }
+    pending_list.resize(num);
 }
 
 bool cellview::operator==(const cellview &rhs) const noexcept {
-    return geo_mode == rhs.geo_mode && *grid_ptr == *(rhs.grid_ptr) && cell_name == rhs.cell_name &&
-           geo_map == rhs.geo_map && inst_map == rhs.inst_map && pin_map == rhs.pin_map &&
-           via_list == rhs.via_list && lay_block_map == rhs.lay_block_map &&
-           area_block_list == rhs.area_block_list && boundary_list == rhs.boundary_list &&
-           label_list == rhs.label_list;
+    return cell_name == rhs.cell_name && has_same_content(rhs);
+}
+
+bool cellview::has_same_content(const cellview &rhs) const noexcept {
+    return geo_mode == rhs.geo_mode && *grid_ptr == *(rhs.grid_ptr) && geo_map == rhs.geo_map &&
+           inst_map == rhs.inst_map && pin_map == rhs.pin_map && via_list == rhs.via_list &&
+           lay_block_map == rhs.lay_block_map && area_block_list == rhs.area_block_list &&
+           boundary_list == rhs.boundary_list && label_list == rhs.label_list;
+}
+
+std::size_t cellview::get_hash() const noexcept {
+    auto seed = content_hash;
+    boost::hash_combine(seed, static_cast<int>(geo_mode));
+    return seed;
+}
+
+bool cellview::has_same_content(const cellview &rhs, const str_map_t &rename_map,
+                                const str_map_t &rhs_rename_map) const noexcept {
+    auto same_inst = [&](const auto &item) {
+        auto iter = rhs.inst_map.find(item.first);
+        if (iter == rhs.inst_map.end())
+            return false;
+        auto &lhs = item.second;
+        auto &rhs_inst = iter->second;
+        if (lhs.is_reference() || rhs_inst.is_reference())
+            return lhs == rhs_inst;
+        return lhs.get_cell_name(&rename_map) == rhs_inst.get_cell_name(&rhs_rename_map) &&
+               lhs.get_inst_name() == rhs_inst.get_inst_name() && lhs.xform == rhs_inst.xform &&
+               lhs.nx == rhs_inst.nx && lhs.ny == rhs_inst.ny && lhs.spx == rhs_inst.spx &&
+               lhs.spy == rhs_inst.spy;
+    };
+    return geo_mode == rhs.geo_mode && *grid_ptr == *(rhs.grid_ptr) && geo_map == rhs.geo_map &&
+           pin_map == rhs.pin_map && via_list == rhs.via_list &&
+           lay_block_map == rhs.lay_block_map && area_block_list == rhs.area_block_list &&
+           boundary_list == rhs.boundary_list && label_list == rhs.label_list &&
+           inst_map.size() == rhs.inst_map.size() &&
+           std::all_of(inst_map.begin(), inst_map.end(), same_inst);
+}
+
+std::size_t cellview::get_hash(const str_map_t &rename_map) const noexcept {
+    auto seed = content_hash;
+    for (const auto &[inst_name, inst] : inst_map) {
+        seed -= helper::get_inst_hash(inst_name, inst);
+        seed += helper::get_inst_hash(inst_name, inst, &rename_map);
+    }
+    boost::hash_combine(seed, static_cast<int>(geo_mode));
+    return seed;
 }
 
 void cellview::set_geometry_mode(geometry_mode new_mode) {
@@ -132,6 +355,20 @@ void cellview::set_geometry_mode(geometry_mode new_mode) {
     geo_mode = new_mode;
 }
 
+void cellview::set_index_algorithm(index_algorithm alg, std::size_t max_elements) {
+    if (!empty())
+        throw std::runtime_error("Cannot change index algorithm of non-empty layout.");
+    for (auto &index : index_list) {
+        index = std::make_shared<geo_index>(alg, max_elements);
+    }
+    idx_alg = alg;
+    idx_max_elements = max_elements;
+}
+
+index_algorithm cellview::get_index_algorithm() const noexcept { return idx_alg; }
+
+std::size_t cellview::get_index_max_elements() const noexcept { return idx_max_elements; }
+
 auto cellview::find_geometry(layer_t key) const -> decltype(geo_map.find(key)) {
     return geo_map.find(key);
 }
@@ -146,7 +383,36 @@ bool cellview::empty() const noexcept {
 }
 
 const std::shared_ptr<geo_index> &cellview::get_geo_index(level_t lev) const {
-    return index_list[lev - get_grid()->get_bot_level()];
+    auto idx = lev - get_grid()->get_bot_level();
+    if (!pending_list[idx].empty())
+        helper::index_pending(*this, lev);
+    return index_list[idx];
+}
+
+void cellview::set_lazy_index(bool enable) {
+    if (!enable) {
+        auto &grid = *get_grid();
+        for (auto lev = grid.get_bot_level(); lev <= grid.get_top_level(); ++lev) {
+            get_geo_index(lev);
+        }
+    }
+    lazy_index = enable;
+}
+
+bool cellview::is_lazy_index() const noexcept { return lazy_index; }
+
+void cellview::finalize() {
+    auto &grid = *get_grid();
+    for (auto lev = grid.get_bot_level(); lev <= grid.get_top_level(); ++lev) {
+        get_geo_index(lev)->finalize();
+    }
+}
+
+void cellview::enable_flat_cache() {
+    auto &grid = *get_grid();
+    for (auto lev = grid.get_bot_level(); lev <= grid.get_top_level(); ++lev) {
+        get_geo_index(lev)->enable_flat_cache();
+    }
 }
 
 auto cellview::begin_inst() const -> decltype(inst_map.cbegin()) { return inst_map.cbegin(); }
@@ -183,15 +449,26 @@ void cellview::add_pin(lay_t lay_id, std::string &&net, std::string &&label, box
     if (iter == pin_map.end()) {
         iter = pin_map.emplace(lay_id, std::vector<pin>()).first;
     }
-    iter->second.emplace_back(std::move(bbox), std::move(net), std::move(label));
+    auto &obj = iter->second.emplace_back(std::move(bbox), std::move(net), std::move(label));
+    auto seed = boost::hash_value(lay_id);
+    helper::hash_box(seed, obj);
+    boost::hash_combine(seed, obj.get_net());
+    boost::hash_combine(seed, obj.get_label());
+    content_hash += seed;
 }
 
 void cellview::add_label(layer_t &&key, transformation &&xform, std::string &&label,
                          offset_t height) {
-    label_list.emplace_back(std::move(key), std::move(xform), std::move(label), height);
+    auto &obj = label_list.emplace_back(std::move(key), std::move(xform), std::move(label), height);
+    auto seed = boost::hash_value(obj.get_key());
+    helper::hash_xform(seed, obj.get_xform());
+    boost::hash_combine(seed, obj.get_text());
+    boost::hash_combine(seed, obj.get_height());
+    content_hash += seed;
 }
 
 void cellview::add_object(const blockage &obj) {
+    content_hash += helper::get_blockage_hash(obj);
     if (obj.get_type() == blockage_type::placement) {
         // area blockage
         area_block_list.push_back(obj);
@@ -205,12 +482,19 @@ void cellview::add_object(const blockage &obj) {
     }
 }
 
-void cellview::add_object(const boundary &obj) { boundary_list.push_back(obj); }
+void cellview::add_object(const boundary &obj) {
+    content_hash += helper::get_boundary_hash(obj);
+    boundary_list.push_back(obj);
+}
 
-void cellview::add_object(boundary &&obj) { boundary_list.push_back(std::move(obj)); }
+void cellview::add_object(boundary &&obj) {
+    content_hash += helper::get_boundary_hash(obj);
+    boundary_list.push_back(std::move(obj));
+}
 
 void cellview::add_object(const via_wrapper &obj) {
     via_list.push_back(obj.v);
+    content_hash += helper::get_via_hash(obj.v);
     if (obj.add_layers) {
         auto[bot_key, unused, top_key] = get_tech()->get_via_layer_purpose(obj.v.get_via_id());
         (void)unused;
@@ -222,48 +506,86 @@ void cellview::add_object(const via_wrapper &obj) {
 }
 
 void cellview::add_object(const instance &obj) {
-    helper::add_inst(*this, obj);
+    content_hash += helper::get_inst_hash(helper::add_inst(*this, obj), obj);
     auto master = obj.get_cellview();
     if (master != nullptr) {
         // NOTE: all routing_grids are guaranteed to have the same levels.
         auto &grid = *get_grid();
-        transformation xform_copy(obj.xform);
-        auto tot_dx = obj.spx * obj.nx;
-        auto tot_dy = obj.spy * obj.ny;
+        pending_inst inst{master, obj.xform, obj.nx, obj.ny, obj.spx, obj.spy};
         for (auto cur_lev = grid.get_bot_level(); cur_lev <= grid.get_top_level(); ++cur_lev) {
-            auto &parent_index = helper::get_geo_index(*this, cur_lev);
-            auto &inst_index = master->get_geo_index(cur_lev);
-            for (decltype(obj.nx) ix = 0; ix < obj.nx; ++ix, move_by(xform_copy, obj.spx, 0)) {
-                for (decltype(obj.ny) iy = 0; iy < obj.ny; ++iy, move_by(xform_copy, 0, obj.spy)) {
-                    parent_index->insert(inst_index, xform_copy);
-                }
-                move_by(xform_copy, 0, -tot_dy);
-            }
-            move_by(xform_copy, -tot_dx, 0);
+            if (lazy_index)
+                pending_list[cur_lev - grid.get_bot_level()].push_back(inst);
+            else
+                helper::index_inst(*this, cur_lev, inst);
         }
     }
 }
 
-void cellview::add_shape(layer_t key, const box_t &obj) { helper::add_shape(*this, key, obj); }
-void cellview::add_shape(layer_t key, const polygon90 &obj) { helper::add_shape(*this, key, obj); }
-void cellview::add_shape(layer_t key, const polygon45 &obj) { helper::add_shape(*this, key, obj); }
-void cellview::add_shape(layer_t key, const polygon &obj) { helper::add_shape(*this, key, obj); }
+geo_handle cellview::add_shape(layer_t key, const box_t &obj) {
+    return helper::add_shape(*this, key, obj);
+}
+geo_handle cellview::add_shape(layer_t key, const polygon90 &obj) {
+    return helper::add_shape(*this, key, obj);
+}
+geo_handle cellview::add_shape(layer_t key, const polygon45 &obj) {
+    return helper::add_shape(*this, key, obj);
+}
+geo_handle cellview::add_shape(layer_t key, const polygon &obj) {
+    return helper::add_shape(*this, key, obj);
+}
 void cellview::add_shape(layer_t key, const polygon45_set &obj) {
     helper::add_shape(*this, key, obj);
 }
 
+void cellview::add_shapes(layer_t key, const std::vector<box_t> &obj_list) {
+    helper::make_geometry(*this, key).add_shapes(obj_list);
+    for (const auto &obj : obj_list) {
+        content_hash += helper::get_shape_hash(key, obj);
+    }
+
+    auto lev_opt = get_tech()->get_level(key);
+    if (lev_opt) {
+        auto idx = *lev_opt - get_grid()->get_bot_level();
+        for (const auto &obj : obj_list) {
+            if (lazy_index)
+                pending_list[idx].emplace_back(pending_shape{key, obj});
+            else
+                helper::index_shape(*this, *lev_opt, key, obj);
+        }
+    }
+}
+
+bool cellview::remove_shape(layer_t key, const geo_handle &h) {
+    return helper::remove_shape(*this, key, h);
+}
+
+geo_handle cellview::update_shape(layer_t key, const geo_handle &h, const box_t &obj) {
+    return helper::update_shape(*this, key, h, obj);
+}
+geo_handle cellview::update_shape(layer_t key, const geo_handle &h, const polygon90 &obj) {
+    return helper::update_shape(*this, key, h, obj);
+}
+geo_handle cellview::update_shape(layer_t key, const geo_handle &h, const polygon45 &obj) {
+    return helper::update_shape(*this, key, h, obj);
+}
+geo_handle cellview::update_shape(layer_t key, const geo_handle &h, const polygon &obj) {
+    return helper::update_shape(*this, key, h, obj);
+}
+
 void cellview::add_warr(const track_id &tid, std::array<offset_t, 2> coord) {
     auto &grid = *get_grid();
     auto lev = tid.get_level();
-    auto &index = helper::get_geo_index(*this, lev);
     for (auto iter = begin_rect(grid, tid, coord), stop = end_rect(grid, tid, coord); iter != stop;
          ++iter) {
         auto[key, box] = *iter;
         auto &geo = helper::make_geometry(*this, key);
         geo.add_shape(box);
+        content_hash += helper::get_shape_hash(key, box);
 
-        auto[spx, spy] = get_margins(grid, key, lev, box);
-        index->insert(box, spx, spy);
+        if (lazy_index)
+            pending_list[lev - grid.get_bot_level()].emplace_back(pending_shape{key, box});
+        else
+            helper::index_shape(*this, lev, key, box);
     }
 }
 
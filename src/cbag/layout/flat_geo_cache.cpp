@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstdint>
+
+#include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/layout/flat_geo_cache.h>
+#include <cbag/layout/geo_index.h>
+#include <cbag/layout/geo_iterator.h>
+
+namespace cbag {
+namespace layout {
+
+// number of bounding boxes tested in one pass of the search loop
+constexpr std::size_t flat_block_size = 32;
+
+flat_geo_cache::flat_geo_cache() = default;
+
+flat_geo_cache::flat_geo_cache(geo_iterator iter, uint64_t version,
+                               std::vector<geo_master_version> masters)
+    : version(version), master_list(std::move(masters)) {
+    for (; iter.has_next(); ++iter) {
+        auto view = *iter;
+        auto box = view.get_bnd_box();
+        xl_list.push_back(xl(box));
+        yl_list.push_back(yl(box));
+        xh_list.push_back(xh(box));
+        yh_list.push_back(yh(box));
+        obj_list.push_back(view.get_object());
+        xform_list.push_back(view.get_xform());
+    }
+}
+
+std::size_t flat_geo_cache::size() const { return obj_list.size(); }
+
+bool flat_geo_cache::is_current(uint64_t cur_version) const {
+    return version == cur_version &&
+           std::all_of(master_list.begin(), master_list.end(), [](const auto &item) {
+               return item.first->get_version() == item.second;
+           });
+}
+
+std::size_t flat_geo_cache::find_next(std::size_t start, const box_t &r) const {
+    auto n = size();
+    auto rxl = xl(r);
+    auto ryl = yl(r);
+    auto rxh = xh(r);
+    auto ryh = yh(r);
+    auto xl_ptr = xl_list.data();
+    auto yl_ptr = yl_list.data();
+    auto xh_ptr = xh_list.data();
+    auto yh_ptr = yh_list.data();
+    while (start < n) {
+        auto stop = std::min(start + flat_block_size, n);
+        // branch-free so the compiler can vectorize the comparisons
+        uint32_t mask = 0;
+        for (auto idx = start; idx < stop; ++idx) {
+            uint32_t hit = (xl_ptr[idx] <= rxh) & (xh_ptr[idx] >= rxl) & (yl_ptr[idx] <= ryh) &
+                           (yh_ptr[idx] >= ryl);
+            mask |= hit << (idx - start);
+        }
+        if (mask != 0)
+            return start + __builtin_ctz(mask);
+        start = stop;
+    }
+    return n;
+}
+
+bool flat_geo_cache::intersects(std::size_t idx, const box_t &r, offset_t spx, offset_t spy) const {
+    return geo_view(&obj_list[idx], xform_list[idx]).intersects(r, spx, spy);
+}
+
+geo_view flat_geo_cache::get_view(std::size_t idx, const cbag::transformation &xform) const {
+    return {&obj_list[idx], get_transform_by(xform_list[idx], xform)};
+}
+
+} // namespace layout
+} // namespace cbag
@@ -1,17 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <optional>
+
 #include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/layout/flat_geo_cache.h>
 #include <cbag/layout/geo_index.h>
 #include <cbag/layout/geo_iterator.h>
 #include <cbag/layout/geometry.h>
 #include <cbag/layout/tech.h>
+#include <cbag/util/math.h>
+#include <cbag/util/parallel.h>
 
 namespace cbag {
 namespace layout {
 
-geo_index::geo_index() = default;
+// maximum number of queries sharing one traversal
+constexpr std::size_t batch_max_size = 64;
+
+// number of tiles per thread in a tiled query
+constexpr std::size_t tiles_per_thread = 4;
+
+// interleaves the bits of x and y
+uint64_t morton_code(uint32_t x, uint32_t y) {
+    auto spread = [](uint64_t v) {
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        v = (v | (v << 2)) & 0x3333333333333333ULL;
+        return (v | (v << 1)) & 0x5555555555555555ULL;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+int64_t get_batch_area(const box_t &box) {
+    return (static_cast<int64_t>(xh(box)) - xl(box) + 1) *
+           (static_cast<int64_t>(yh(box)) - yl(box) + 1);
+}
+
+// groups query indices into spatially coherent batches
+std::vector<std::vector<std::size_t>> get_query_batches(const std::vector<box_t> &box_list) {
+    auto n = box_list.size();
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+
+    // sort queries along a Z-order curve, so that consecutive queries are close together
+    auto tot_box = box_t::get_invalid_box();
+    for (const auto &box : box_list) {
+        merge(tot_box, box);
+    }
+    std::vector<uint64_t> keys(n);
+    if (n > 0) {
+        auto x0 = static_cast<int64_t>(xl(tot_box)) * 2;
+        auto y0 = static_cast<int64_t>(yl(tot_box)) * 2;
+        auto span = std::max(static_cast<int64_t>(xh(tot_box)) * 2 - x0,
+                             static_cast<int64_t>(yh(tot_box)) * 2 - y0);
+        int shift = 0;
+        while ((span >> shift) > 0xFFFF)
+            ++shift;
+        for (std::size_t idx = 0; idx < n; ++idx) {
+            auto &box = box_list[idx];
+            auto cx = static_cast<int64_t>(xl(box)) + xh(box) - x0;
+            auto cy = static_cast<int64_t>(yl(box)) + yh(box) - y0;
+            keys[idx] = morton_code(static_cast<uint32_t>(cx >> shift),
+                                    static_cast<uint32_t>(cy >> shift));
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+
+    // greedily merge consecutive queries as long as the merged box is not mostly empty space
+    std::vector<std::vector<std::size_t>> ans;
+    box_t cur_box;
+    int64_t cur_area = 0;
+    for (auto idx : order) {
+        auto &box = box_list[idx];
+        auto area = get_batch_area(box);
+        if (!ans.empty() && ans.back().size() < batch_max_size) {
+            auto new_box = get_merge(cur_box, box);
+            auto new_area = cur_area + area;
+            if (get_batch_area(new_box) <= 2 * new_area) {
+                ans.back().push_back(idx);
+                cur_box = new_box;
+                cur_area = new_area;
+                continue;
+            }
+        }
+        ans.emplace_back(1, idx);
+        cur_box = box;
+        cur_area = area;
+    }
+    return ans;
+}
+
+geo_index::geo_index(index_algorithm alg, std::size_t max_elements) : index(alg, max_elements) {}
+
+index_algorithm geo_index::get_algorithm() const { return index.get_algorithm(); }
+
+std::size_t geo_index::get_max_elements() const { return index.get_max_elements(); }
+
+void geo_index::flush() const {
+    if (!dirty.load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard<std::mutex> guard(flush_lock);
+    if (!dirty.load(std::memory_order_relaxed))
+        return;
+
+    if (staged.size() < index.size()) {
+        // only a few new objects, insert them one by one
+        index.insert(staged);
+    } else {
+        // rebuild the whole tree with the packing algorithm
+        index.rebuild(std::move(staged));
+    }
+    std::vector<geo_object>().swap(staged);
+    dirty.store(false, std::memory_order_release);
+}
+
+void geo_index::add_masters(std::vector<geo_master_version> &ans) const {
+    for (auto iter = index.qbegin_intersects(index.bounds()); !iter.is_end(); ++iter) {
+        auto inst = iter->get_instance();
+        if (!inst)
+            continue;
+        auto &master = inst->get_master();
+        if (std::none_of(ans.begin(), ans.end(),
+                         [&master](const auto &item) { return item.first == master; })) {
+            master->flush();
+            ans.emplace_back(master, master->version);
+            master->add_masters(ans);
+        }
+    }
+}
+
+std::shared_ptr<const flat_geo_cache> geo_index::make_flat_cache() const {
+    // query the R-tree directly, as this is called while holding flush_lock
+    auto box = index.bounds();
+    box_t r(box.min_corner().get<0>(), box.min_corner().get<1>(), box.max_corner().get<0>(),
+            box.max_corner().get<1>());
+    std::vector<geo_master_version> master_list;
+    add_masters(master_list);
+    return std::make_shared<const flat_geo_cache>(
+        geo_iterator(r, 0, 0, index.qbegin_intersects(box), cbag::make_xform()), version,
+        std::move(master_list));
+}
+
+bool geo_index::empty() const {
+    // dirty implies staged objects, otherwise the R-tree is not being modified
+    return !dirty.load(std::memory_order_acquire) && index.empty();
+}
+
+bool geo_index::is_finalized() const { return !dirty; }
 
-bool geo_index::empty() const { return index.empty(); }
+uint64_t geo_index::get_version() const { return version; }
 
 box_t geo_index::get_bbox() const {
+    flush();
     box_t ans;
     auto box = index.bounds();
     set(ans, box.min_corner().get<0>(), box.min_corner().get<1>(), box.max_corner().get<0>(),
@@ -19,22 +165,177 @@ box_t geo_index::get_bbox() const {
     return ans;
 }
 
+geo_query_iter geo_index::begin_query(const box_t &r, offset_t spx, offset_t spy) const {
+    flush();
+    return index.qbegin_intersects(
+        bg_box(bg_point(xl(r) - spx, yl(r) - spy), bg_point(xh(r) + spx, yh(r) + spy)));
+}
+
 geo_iterator geo_index::begin_intersect(const box_t &r, offset_t spx, offset_t spy,
                                         const cbag::transformation &xform) const {
+    return {r, spx, spy, begin_query(r, spx, spy), xform};
+}
+
+std::vector<std::vector<geo_view>> geo_index::query_batch(const std::vector<geo_query> &queries,
+                                                          const cbag::transformation &xform,
+                                                          std::size_t num_threads) const {
+    flush();
+
+    std::vector<box_t> box_list;
+    box_list.reserve(queries.size());
+    for (const auto &q : queries) {
+        box_list.push_back(get_expand(q.box, std::max(q.spx, 0), std::max(q.spy, 0)));
+    }
+    auto batch_list = get_query_batches(box_list);
+
+    // every geometry found by a query is also found by the traversal of the merged query box
+    std::vector<std::vector<geo_view>> ans(queries.size());
+    util::parallel_for(batch_list.size(), num_threads, [&](std::size_t batch_idx) {
+        const auto &batch = batch_list[batch_idx];
+        auto tot_box = box_list[batch[0]];
+        for (auto idx : batch) {
+            merge(tot_box, box_list[idx]);
+        }
+        auto ident = cbag::make_xform();
+        for (auto iter = begin_intersect(tot_box, 0, 0, ident); iter.has_next(); ++iter) {
+            auto view = *iter;
+            std::optional<cbag::transformation> view_xform;
+            for (auto idx : batch) {
+                const auto &q = queries[idx];
+                if (view.intersects(q.box, q.spx, q.spy)) {
+                    if (!view_xform)
+                        view_xform = get_transform_by(view.get_xform(), xform);
+                    ans[idx].emplace_back(&view.get_object(), *view_xform);
+                }
+            }
+        }
+    });
+    return ans;
+}
+
+std::vector<geo_view> geo_index::query_tiled(const box_t &r, offset_t spx, offset_t spy,
+                                             const cbag::transformation &xform,
+                                             std::size_t num_threads) const {
+    flush();
+
+    // split the box into roughly square tiles, a few per thread for load balancing
+    auto w = static_cast<int64_t>(xh(r)) - xl(r);
+    auto h = static_cast<int64_t>(yh(r)) - yl(r);
+    auto num_tiles = static_cast<int64_t>(std::max(num_threads, static_cast<std::size_t>(1)) *
+                                          tiles_per_thread);
+    auto nx = static_cast<int64_t>(std::lround(
+        std::sqrt(static_cast<double>(num_tiles) * std::max(w, int64_t(1)) /
+                  std::max(h, int64_t(1)))));
+    nx = std::clamp(nx, int64_t(1), std::min(num_tiles, std::max(w, int64_t(1))));
+    auto ny = std::clamp(util::ceil_div(num_tiles, nx), int64_t(1), std::max(h, int64_t(1)));
+    std::vector<coord_t> x_list(nx + 1);
+    std::vector<coord_t> y_list(ny + 1);
+    for (int64_t idx = 0; idx <= nx; ++idx) {
+        x_list[idx] = static_cast<coord_t>(xl(r) + w * idx / nx);
+    }
+    for (int64_t idx = 0; idx <= ny; ++idx) {
+        y_list[idx] = static_cast<coord_t>(yl(r) + h * idx / ny);
+    }
+    auto get_tile = [&x_list, &y_list](int64_t ix, int64_t iy) {
+        return box_t(x_list[ix], y_list[iy], x_list[ix + 1], y_list[iy + 1]);
+    };
+
+    std::vector<std::vector<geo_view>> tile_results(nx * ny);
+    auto ident = cbag::make_xform();
+    util::parallel_for(tile_results.size(), num_threads, [&](std::size_t tile_idx) {
+        int64_t ix = tile_idx % nx;
+        int64_t iy = tile_idx / nx;
+        auto &ans = tile_results[tile_idx];
+        for (auto iter = begin_intersect(get_tile(ix, iy), spx, spy, ident); iter.has_next();
+             ++iter) {
+            auto view = *iter;
+            // only report the geometry from the first tile, in row-major order, that finds it
+            auto bnd = get_expand(view.get_bnd_box(), std::max(spx, 0), std::max(spy, 0));
+            bool is_first = true;
+            for (int64_t jy = 0; jy <= iy && is_first; ++jy) {
+                if (y_list[jy] > yh(bnd) || y_list[jy + 1] < yl(bnd))
+                    continue;
+                auto jx_stop = (jy == iy) ? ix : nx;
+                for (int64_t jx = 0; jx < jx_stop && is_first; ++jx) {
+                    if (x_list[jx] <= xh(bnd) && x_list[jx + 1] >= xl(bnd))
+                        is_first = !view.intersects(get_tile(jx, jy), spx, spy);
+                }
+            }
+            if (is_first)
+                ans.emplace_back(&view.get_object(), get_transform_by(view.get_xform(), xform));
+        }
+    });
+
+    std::vector<geo_view> ans;
+    for (auto &tile_ans : tile_results) {
+        ans.insert(ans.end(), tile_ans.begin(), tile_ans.end());
+    }
+    return ans;
+}
+
+void geo_index::finalize() { flush(); }
+
+void geo_index::enable_flat_cache() {
+    if (use_flat_cache)
+        return;
+    use_flat_cache = true;
+    get_flat_cache();
+}
+
+std::shared_ptr<const flat_geo_cache> geo_index::get_flat_cache() const {
+    if (!use_flat_cache)
+        return nullptr;
+    flush();
+    // queries load the cache while another thread may replace an out of date one
+    auto ans = std::atomic_load(&flat_cache);
+    if (ans && ans->is_current(version))
+        return ans;
+
+    std::lock_guard<std::mutex> guard(flush_lock);
+    ans = std::atomic_load(&flat_cache);
+    if (!ans || !ans->is_current(version)) {
+        ans = make_flat_cache();
+        std::atomic_store(&flat_cache, ans);
+    }
+    return ans;
+}
+
+geo_handle geo_index::insert(const std::shared_ptr<const geo_index> &master,
+                             const cbag::transformation &xform, cnt_t nx, cnt_t ny, offset_t spx,
+                             offset_t spy) {
+    if (nx == 0 || ny == 0 || master->empty())
+        return {};
+    return insert(geo_instance(master, xform, nx, ny, spx, spy), 0, 0);
+}
+
+geo_handle geo_index::insert_object(geo_object &&obj) {
+    geo_handle ans{obj.id, obj.bnd_box};
+    staged.push_back(std::move(obj));
+    ++version;
+    dirty = true;
+    return ans;
+}
 
-    return {r,
-            spx,
-            spy,
-            index.qbegin(bgi::intersects(
-                bg_box(bg_point(xl(r) - spx, yl(r) - spy), bg_point(xh(r) + spx, yh(r) + spy)))),
-            index.qend(),
-            xform};
+const geo_object *geo_index::find(const geo_handle &h) const {
+    if (!h.is_valid())
+        return nullptr;
+    flush();
+    for (auto iter = index.qbegin_intersects(h.bnd_box); !iter.is_end(); ++iter) {
+        if (iter->id == h.id)
+            return &(*iter);
+    }
+    return nullptr;
 }
 
-void geo_index::insert(const std::shared_ptr<const geo_index> &master,
-                       const cbag::transformation &xform) {
-    if (!master->empty())
-        index.insert(geo_object(geo_instance(master, xform), 0, 0));
+bool geo_index::remove(const geo_handle &h) {
+    auto obj = find(h);
+    if (!obj)
+        return false;
+    // copy the object first, as remove() invalidates the reference
+    geo_object val = *obj;
+    index.remove(val);
+    ++version;
+    return true;
 }
 
 } // namespace layout
@@ -0,0 +1,160 @@
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <cbag/layout/geo_index_impl.h>
+#include <cbag/util/overload.h>
+
+namespace cbag {
+namespace layout {
+
+geo_query_iter::geo_query_iter() = default;
+
+geo_query_iter::geo_query_iter(geo_rtree_default::const_query_iterator &&iter)
+    : val(std::move(iter)) {}
+
+geo_query_iter::geo_query_iter(geo_rtree_linear::const_query_iterator &&iter)
+    : val(std::move(iter)) {}
+
+geo_query_iter::geo_query_iter(geo_rtree_quadratic::const_query_iterator &&iter)
+    : val(std::move(iter)) {}
+
+geo_query_iter::geo_query_iter(geo_rtree_rstar::const_query_iterator &&iter)
+    : val(std::move(iter)) {}
+
+bool geo_query_iter::is_end() const {
+    return std::visit(
+        overload{
+            [](const std::monostate &v) { return true; },
+            [](const auto &v) { return v == std::decay_t<decltype(v)>(); },
+        },
+        val);
+}
+
+geo_query_iter &geo_query_iter::operator++() {
+    std::visit(
+        overload{
+            [](std::monostate &v) {},
+            [](auto &v) { ++v; },
+        },
+        val);
+    return *this;
+}
+
+geo_query_iter::reference geo_query_iter::operator*() const { return *operator->(); }
+
+geo_query_iter::pointer geo_query_iter::operator->() const {
+    return std::visit(
+        overload{
+            [](const std::monostate &v) -> pointer {
+                throw std::out_of_range("Cannot dereference end geo_query_iter.");
+            },
+            [](const auto &v) -> pointer { return &(*v); },
+        },
+        val);
+}
+
+bool geo_query_iter::operator==(const geo_query_iter &rhs) const {
+    auto lhs_end = is_end();
+    auto rhs_end = rhs.is_end();
+    if (lhs_end || rhs_end)
+        return lhs_end == rhs_end;
+    if (val.index() != rhs.val.index())
+        return false;
+    return std::visit(
+        [&rhs](const auto &v) {
+            return v == std::get<std::decay_t<decltype(v)>>(rhs.val);
+        },
+        val);
+}
+
+bool geo_query_iter::operator!=(const geo_query_iter &rhs) const { return !(*this == rhs); }
+
+std::variant<geo_rtree_default, geo_rtree_linear, geo_rtree_quadratic, geo_rtree_rstar>
+make_geo_rtree(index_algorithm alg, std::size_t max_elements) {
+    if (max_elements < 4)
+        throw std::invalid_argument("R-tree nodes must hold at least 4 elements, got " +
+                                    std::to_string(max_elements));
+    if (alg == index_algorithm::QUADRATIC &&
+        max_elements == geo_rtree_default::parameters_type::max_elements)
+        return geo_rtree_default();
+    switch (alg) {
+    case index_algorithm::LINEAR:
+        return geo_rtree_linear(bgi::dynamic_linear(max_elements, max_elements / 2));
+    case index_algorithm::QUADRATIC:
+        return geo_rtree_quadratic(bgi::dynamic_quadratic(max_elements, max_elements / 2));
+    case index_algorithm::RSTAR:
+        return geo_rtree_rstar(bgi::dynamic_rstar(max_elements, max_elements * 3 / 10));
+    default:
+        throw std::invalid_argument("Unknown index algorithm: " +
+                                    std::to_string(static_cast<enum_t>(alg)));
+    }
+}
+
+geo_index_impl::geo_index_impl(index_algorithm alg, std::size_t max_elements)
+    : tree(make_geo_rtree(alg, max_elements)) {}
+
+index_algorithm geo_index_impl::get_algorithm() const {
+    return std::visit(overload{
+                          [](const geo_rtree_linear &t) { return index_algorithm::LINEAR; },
+                          [](const geo_rtree_rstar &t) { return index_algorithm::RSTAR; },
+                          [](const auto &t) { return index_algorithm::QUADRATIC; },
+                      },
+                      tree);
+}
+
+std::size_t geo_index_impl::get_max_elements() const {
+    return std::visit([](const auto &t) { return t.parameters().get_max_elements(); }, tree);
+}
+
+bool geo_index_impl::empty() const {
+    return std::visit([](const auto &t) { return t.empty(); }, tree);
+}
+
+std::size_t geo_index_impl::size() const {
+    return std::visit([](const auto &t) { return t.size(); }, tree);
+}
+
+bg_box geo_index_impl::bounds() const {
+    return std::visit([](const auto &t) { return t.bounds(); }, tree);
+}
+
+geo_query_iter geo_index_impl::qbegin_intersects(const bg_box &r) const {
+    return std::visit(
+        [&r](const auto &t) {
+            return geo_query_iter(geo_rtree_query<std::decay_t<decltype(t)>>(t, r));
+        },
+        tree);
+}
+
+geo_query_iter geo_index_impl::qbegin_nearest(const bg_box &r, std::size_t k) const {
+    return std::visit(
+        [&r, k](const auto &t) {
+            return geo_query_iter(t.qbegin(bgi::nearest(r, static_cast<unsigned int>(k))));
+        },
+        tree);
+}
+
+void geo_index_impl::insert(const std::vector<geo_object> &obj_list) {
+    std::visit([&obj_list](auto &t) { t.insert(obj_list.begin(), obj_list.end()); }, tree);
+}
+
+bool geo_index_impl::remove(const geo_object &obj) {
+    return std::visit([&obj](auto &t) { return t.remove(obj) > 0; }, tree);
+}
+
+void geo_index_impl::rebuild(std::vector<geo_object> &&obj_list) {
+    std::visit(
+        [&obj_list](auto &t) {
+            obj_list.reserve(obj_list.size() + t.size());
+            obj_list.insert(obj_list.end(), t.begin(), t.end());
+            std::decay_t<decltype(t)> packed(std::make_move_iterator(obj_list.begin()),
+                                             std::make_move_iterator(obj_list.end()),
+                                             t.parameters());
+            t = std::move(packed);
+        },
+        tree);
+}
+
+} // namespace layout
+} // namespace cbag
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <variant>
+#include <vector>
+
+#include <boost/polygon/polygon.hpp>
+
+#include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/layout/geo_index.h>
+#include <cbag/layout/geo_iterator.h>
+#include <cbag/util/overload.h>
+
+namespace cbag {
+namespace layout {
+
+using dpoint = std::array<double, 2>;
+
+// squared euclidean distance between two boxes, 0 if they touch or overlap
+double get_dist2(const box_t &a, const box_t &b) {
+    auto dx = std::max(static_cast<double>(std::max(xl(a), xl(b))) - std::min(xh(a), xh(b)), 0.0);
+    auto dy = std::max(static_cast<double>(std::max(yl(a), yl(b))) - std::min(yh(a), yh(b)), 0.0);
+    return dx * dx + dy * dy;
+}
+
+// squared distance from a point to a box, 0 if the box contains it
+double get_dist2(const dpoint &p, const box_t &b) {
+    auto dx = std::max({xl(b) - p[0], p[0] - xh(b), 0.0});
+    auto dy = std::max({yl(b) - p[1], p[1] - yh(b), 0.0});
+    return dx * dx + dy * dy;
+}
+
+// squared distance from a point to the segment from a to b
+double get_dist2(const dpoint &p, const dpoint &a, const dpoint &b) {
+    auto dx = b[0] - a[0];
+    auto dy = b[1] - a[1];
+    auto len2 = dx * dx + dy * dy;
+    auto t = (len2 == 0) ? 0.0
+                         : std::clamp(((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / len2, 0.0, 1.0);
+    auto ex = a[0] + t * dx - p[0];
+    auto ey = a[1] + t * dy - p[1];
+    return ex * ex + ey * ey;
+}
+
+// true if the segment from a to b touches the box
+bool touches(const dpoint &a, const dpoint &b, const box_t &r) {
+    // clip the segment parameter range to each slab of the box
+    double t0 = 0, t1 = 1;
+    for (std::size_t dim = 0; dim < 2; ++dim) {
+        auto lo = static_cast<double>((dim == 0) ? xl(r) : yl(r));
+        auto hi = static_cast<double>((dim == 0) ? xh(r) : yh(r));
+        auto d = b[dim] - a[dim];
+        if (d == 0) {
+            if (a[dim] < lo || a[dim] > hi)
+                return false;
+        } else {
+            auto ta = (lo - a[dim]) / d;
+            auto tb = (hi - a[dim]) / d;
+            t0 = std::max(t0, std::min(ta, tb));
+            t1 = std::min(t1, std::max(ta, tb));
+            if (t0 > t1)
+                return false;
+        }
+    }
+    return true;
+}
+
+// squared distance from the box to a polygon, 0 if they touch or overlap
+template <typename T> double get_poly_dist2(const box_t &r, const T &poly) {
+    if (bp::contains(poly, bp::point_data<coord_t>(xl(r), yl(r))))
+        return 0;
+    auto ans = std::numeric_limits<double>::infinity();
+    double rxl = xl(r), ryl = yl(r), rxh = xh(r), ryh = yh(r);
+    std::array<dpoint, 4> corners = {dpoint{rxl, ryl}, dpoint{rxh, ryl}, dpoint{rxh, ryh},
+                                     dpoint{rxl, ryh}};
+    std::optional<dpoint> first, prev;
+    auto add_edge = [&](const dpoint &a, const dpoint &b) {
+        if (touches(a, b, r)) {
+            ans = 0;
+            return;
+        }
+        // the closest points of disjoint convex shapes include a vertex of one of them
+        ans = std::min({ans, get_dist2(a, r), get_dist2(b, r)});
+        for (const auto &c : corners) {
+            ans = std::min(ans, get_dist2(c, a, b));
+        }
+    };
+    for (const auto &pt : poly) {
+        dpoint cur{static_cast<double>(bp::x(pt)), static_cast<double>(bp::y(pt))};
+        if (prev)
+            add_edge(*prev, cur);
+        else
+            first = cur;
+        prev = cur;
+    }
+    if (first)
+        add_edge(*prev, *first);
+    return ans;
+}
+
+// squared distance from the box to the geometry including its spacing margins
+double get_exact_dist2(const box_t &r, const geo_view &view) {
+    auto &obj = view.get_object();
+    auto spx = obj.spx;
+    auto spy = obj.spy;
+    if (flips_xy(view.get_xform()))
+        std::swap(spx, spy);
+    // the distance to the geometry grown by the margins is the distance from the grown box
+    auto test_box = get_expand(r, spx, spy);
+    return std::visit(overload{
+                          [&test_box](const box_t &v) { return get_dist2(test_box, v); },
+                          [&test_box](const auto &v) { return get_poly_dist2(test_box, v); },
+                      },
+                      view.get_union().val);
+}
+
+/** Best-first search over a geo_index hierarchy.
+ *
+ *  The queue holds four kinds of items, all keyed by a lower bound of their distance to the
+ *  query box: geometries with their exact distance, geometries keyed by their bounding box,
+ *  nearest-neighbor query streams of a single cellview, and sub-arrays of an instance array.
+ *  Items other than exact geometries are expanded or refined lazily when they reach the top, so
+ *  geometries come out in increasing distance order.
+ */
+class nearest_search {
+  private:
+    enum item_type : uint8_t {
+        GEOMETRY = 0,
+        BOUND = 1,
+        STREAM = 2,
+        ARRAY = 3,
+    };
+
+    struct item {
+        double dist2;
+        item_type type;
+        // the stream index for STREAM items
+        std::size_t stream_idx = 0;
+        // the geometry for GEOMETRY and BOUND items, and the instance array for ARRAY items
+        const geo_object *obj = nullptr;
+        // the transformation from the object's cellview to the query coordinate system
+        cbag::transformation xform;
+        std::array<std::array<cnt_t, 2>, 2> range = {};
+
+        bool operator>(const item &rhs) const {
+            return dist2 > rhs.dist2 || (dist2 == rhs.dist2 && type > rhs.type);
+        }
+    };
+
+    struct stream {
+        geo_query_iter cur;
+        cbag::transformation xform;
+    };
+
+    box_t box;
+    std::vector<stream> stream_list;
+    std::priority_queue<item, std::vector<item>, std::greater<item>> queue;
+
+    void add_stream(const geo_index &index, const cbag::transformation &xform) {
+        auto local_box = get_transform(box, get_invert(xform));
+        stream_list.push_back({index.begin_nearest(local_box), xform});
+        push_stream(stream_list.size() - 1);
+    }
+
+    void push_stream(std::size_t idx) {
+        auto &s = stream_list[idx];
+        if (s.cur != geo_query_iter()) {
+            auto dist2 = get_dist2(box, geo_view(&(*s.cur), s.xform).get_bnd_box());
+            queue.push({dist2, STREAM, idx});
+        }
+    }
+
+    void push_array(const geo_object *obj, const cbag::transformation &xform,
+                    const std::array<std::array<cnt_t, 2>, 2> &range) {
+        auto &inst = std::get<geo_instance>(obj->val);
+        auto dist2 = get_dist2(box, get_transform(inst.get_bbox(range), xform));
+        queue.push({dist2, ARRAY, 0, obj, xform, range});
+    }
+
+    void expand_stream(std::size_t idx) {
+        auto &s = stream_list[idx];
+        const geo_object *obj = &(*s.cur);
+        auto xform = s.xform;
+        ++s.cur;
+        push_stream(idx);
+
+        if (auto inst = std::get_if<geo_instance>(&obj->val)) {
+            push_array(obj, xform, {{{0, inst->get_nx()}, {0, inst->get_ny()}}});
+        } else {
+            // the bounding box distance of a rectangle is exact, polygons are refined later
+            auto dist2 = get_dist2(box, geo_view(obj, xform).get_bnd_box());
+            auto type = std::holds_alternative<box_t>(obj->val) ? GEOMETRY : BOUND;
+            queue.push({dist2, type, 0, obj, xform});
+        }
+    }
+
+    void expand_array(const item &top) {
+        auto &inst = std::get<geo_instance>(top.obj->val);
+        auto &[x_range, y_range] = top.range;
+        auto nx = x_range[1] - x_range[0];
+        auto ny = y_range[1] - y_range[0];
+        if (nx == 1 && ny == 1) {
+            add_stream(*inst.get_master(),
+                       get_transform_by(inst.get_xform(x_range[0], y_range[0]), top.xform));
+            return;
+        }
+        // split the sub-array in half along its longer dimension
+        auto lo = top.range;
+        auto hi = top.range;
+        if (nx >= ny) {
+            lo[0][1] = hi[0][0] = x_range[0] + nx / 2;
+        } else {
+            lo[1][1] = hi[1][0] = y_range[0] + ny / 2;
+        }
+        push_array(top.obj, top.xform, lo);
+        push_array(top.obj, top.xform, hi);
+    }
+
+  public:
+    nearest_search(const geo_index &index, const box_t &box) : box(box) {
+        add_stream(index, cbag::make_xform());
+    }
+
+    // finds the next closest geometry, returns false if there is none
+    bool next(geo_view &ans, double &dist2) {
+        while (!queue.empty()) {
+            auto top = queue.top();
+            queue.pop();
+            switch (top.type) {
+            case GEOMETRY:
+                ans = geo_view(top.obj, top.xform);
+                dist2 = top.dist2;
+                return true;
+            case BOUND:
+                top.dist2 = get_exact_dist2(box, geo_view(top.obj, top.xform));
+                top.type = GEOMETRY;
+                queue.push(top);
+                break;
+            case STREAM:
+                expand_stream(top.stream_idx);
+                break;
+            default:
+                expand_array(top);
+            }
+        }
+        return false;
+    }
+};
+
+geo_query_iter geo_index::begin_nearest(const box_t &r) const {
+    flush();
+    if (index.empty())
+        return {};
+    return index.qbegin_nearest(bg_box(bg_point(xl(r), yl(r)), bg_point(xh(r), yh(r))),
+                                index.size());
+}
+
+std::vector<geo_view> geo_index::get_nearest(const box_t &r, std::size_t k,
+                                             const cbag::transformation &xform) const {
+    std::vector<geo_view> ans;
+    if (k == 0)
+        return ans;
+
+    nearest_search search(*this, r);
+    geo_view view;
+    double dist2;
+    while (ans.size() < k && search.next(view, dist2)) {
+        ans.emplace_back(&view.get_object(), get_transform_by(view.get_xform(), xform));
+    }
+    return ans;
+}
+
+double geo_index::get_min_distance(const box_t &r) const {
+    nearest_search search(*this, r);
+    geo_view view;
+    double dist2;
+    if (!search.next(view, dist2))
+        return std::numeric_limits<double>::infinity();
+    return std::sqrt(dist2);
+}
+
+} // namespace layout
+} // namespace cbag
@@ -1,37 +1,75 @@
+#include <algorithm>
+
 #include <cbag/common/box_t_util.h>
 #include <cbag/common/transformation_util.h>
 #include <cbag/layout/geo_index.h>
 #include <cbag/layout/geo_instance.h>
-#include <cbag/layout/geo_iterator.h>
+#include <cbag/util/math.h>
 
 namespace cbag {
 namespace layout {
 
 geo_instance::geo_instance() = default;
 
-geo_instance::geo_instance(std::shared_ptr<const geo_index> master, cbag::transformation xform)
-    : master(std::move(master)), xform(std::move(xform)) {}
+geo_instance::geo_instance(std::shared_ptr<const geo_index> master, cbag::transformation xform,
+                           cnt_t nx, cnt_t ny, offset_t spx, offset_t spy)
+    : master(std::move(master)), xform(std::move(xform)), nx(nx), ny(ny), spx(spx), spy(spy) {}
+
+bool geo_instance::empty() const { return nx == 0 || ny == 0 || master->empty(); }
+
+const std::shared_ptr<const geo_index> &geo_instance::get_master() const { return master; }
+
+const transformation &geo_instance::get_xform() const { return xform; }
+
+cnt_t geo_instance::get_nx() const { return nx; }
 
-bool geo_instance::empty() const { return master->empty(); }
+cnt_t geo_instance::get_ny() const { return ny; }
 
-box_t geo_instance::get_bbox() const {
-    box_t ans = master->get_bbox();
-    return transform(ans, xform);
+transformation geo_instance::get_xform(cnt_t ix, cnt_t iy) const {
+    return get_move_by(xform, static_cast<offset_t>(ix) * spx, static_cast<offset_t>(iy) * spy);
 }
 
-geo_iterator geo_instance::begin_intersect(const box_t &r, offset_t spx, offset_t spy) const {
-    auto spx_new = spx;
-    auto spy_new = spy;
-    auto test_r = get_transform(r, get_invert(xform));
-    if (flips_xy(xform)) {
-        spx_new = spy;
-        spy_new = spx;
+box_t geo_instance::get_bbox() const { return get_bbox({{{0, nx}, {0, ny}}}); }
+
+box_t geo_instance::get_bbox(const std::array<std::array<cnt_t, 2>, 2> &range) const {
+    auto &[x_range, y_range] = range;
+    box_t ans = get_transform(master->get_bbox(), get_xform(x_range[0], y_range[0]));
+    auto dx = static_cast<offset_t>(x_range[1] - x_range[0] - 1) * spx;
+    auto dy = static_cast<offset_t>(y_range[1] - y_range[0] - 1) * spy;
+    if (dx != 0 || dy != 0)
+        merge(ans, get_move_by(ans, dx, dy));
+    return ans;
+}
+
+std::array<cnt_t, 2> get_index_range(coord_t lo, coord_t hi, coord_t r_lo, coord_t r_hi,
+                                     offset_t sp, cnt_t n) {
+    // find all k in [0, n) such that [lo + k * sp, hi + k * sp] intersects [r_lo, r_hi]
+    int64_t k_lo = 0;
+    int64_t k_hi = static_cast<int64_t>(n) - 1;
+    if (sp == 0) {
+        if (hi < r_lo || lo > r_hi)
+            return {0, 0};
+    } else if (sp > 0) {
+        k_lo = std::max(k_lo, util::ceil_div(static_cast<int64_t>(r_lo) - hi, sp));
+        k_hi = std::min(k_hi, util::floor_div(static_cast<int64_t>(r_hi) - lo, sp));
+    } else {
+        k_lo = std::max(k_lo, util::ceil_div(static_cast<int64_t>(lo) - r_hi, -sp));
+        k_hi = std::min(k_hi, util::floor_div(static_cast<int64_t>(hi) - r_lo, -sp));
     }
-    return master->begin_intersect(test_r, spx_new, spy_new, xform);
+    if (k_lo > k_hi)
+        return {0, 0};
+    return {static_cast<cnt_t>(k_lo), static_cast<cnt_t>(k_hi + 1)};
+}
+
+std::array<std::array<cnt_t, 2>, 2> geo_instance::get_index_range(const box_t &r) const {
+    auto base = get_transform(master->get_bbox(), xform);
+    return {layout::get_index_range(xl(base), xh(base), xl(r), xh(r), spx, nx),
+            layout::get_index_range(yl(base), yh(base), yl(r), yh(r), spy, ny)};
 }
 
 bool geo_instance::operator==(const geo_instance &rhs) const {
-    return master == rhs.master && xform == rhs.xform;
+    return master == rhs.master && xform == rhs.xform && nx == rhs.nx && ny == rhs.ny &&
+           spx == rhs.spx && spy == rhs.spy;
 }
 
 } // namespace layout
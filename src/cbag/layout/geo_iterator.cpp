@@ -1,9 +1,13 @@
 #include <algorithm>
+#include <string>
 
 #include <boost/polygon/polygon.hpp>
 
 #include <cbag/common/box_t_adapt.h>
 #include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/layout/flat_geo_cache.h>
+#include <cbag/layout/geo_index.h>
 #include <cbag/layout/geo_iterator.h>
 #include <cbag/util/overload.h>
 
@@ -12,65 +16,162 @@ using namespace boost::polygon::operators;
 namespace cbag {
 namespace layout {
 
-struct geo_iterator::helper {
+geo_view::geo_view() = default;
 
-    struct xform_visitor {
-      public:
-        const cbag::transformation &xform;
+geo_view::geo_view(const geo_object *obj, cbag::transformation xform)
+    : obj(obj), xform(std::move(xform)) {}
 
-        xform_visitor(const cbag::transformation &xform) : xform(xform) {}
+geo_union_enum geo_view::index() const { return static_cast<geo_union_enum>(obj->val.index()); }
 
-        template <typename T> void operator()(T &v) { bp::transform(v, xform); }
-    };
+const geo_object &geo_view::get_object() const { return *obj; }
+
+const cbag::transformation &geo_view::get_xform() const { return xform; }
+
+box_t geo_view::get_bbox() const {
+    box_t ans{obj->bnd_box.min_corner().get<0>() + obj->spx,
+              obj->bnd_box.min_corner().get<1>() + obj->spy,
+              obj->bnd_box.max_corner().get<0>() - obj->spx,
+              obj->bnd_box.max_corner().get<1>() - obj->spy};
+    return transform(ans, xform);
+}
+
+box_t geo_view::get_bnd_box() const {
+    return get_transform(box_t(obj->bnd_box.min_corner().get<0>(),
+                               obj->bnd_box.min_corner().get<1>(),
+                               obj->bnd_box.max_corner().get<0>(),
+                               obj->bnd_box.max_corner().get<1>()),
+                         xform);
+}
+
+bool geo_view::intersects(const box_t &r, offset_t spx, offset_t spy) const {
+    auto obj_spx = obj->spx;
+    auto obj_spy = obj->spy;
+    if (flips_xy(xform))
+        std::swap(obj_spx, obj_spy);
+    auto test_box = get_expand(r, std::max(spx, obj_spx), std::max(spy, obj_spy));
+    if (!is_physical(get_intersect(test_box, get_bbox())))
+        return false;
+    if (index() == geo_union_enum::RECT)
+        return true;
+    return std::visit(overload{
+                          [](const box_t &v) { return true; },
+                          [&test_box](const auto &v) { return !bp::empty(v & test_box); },
+                      },
+                      get_union().val);
+}
+
+geo_union geo_view::get_union() const {
+    geo_union ans;
+    std::visit(
+        overload{
+            [](const geo_instance &v) {
+                throw std::logic_error("geo_view cannot reference a geo_instance.");
+            },
+            [&ans](const auto &v) { ans.val = v; },
+        },
+        obj->val);
+    std::visit([this](auto &v) { bp::transform(v, xform); }, ans.val);
+    return ans;
+}
+
+struct geo_iterator::helper {
 
     struct geo_visitor {
       public:
         geo_iterator &self;
+        frame &top;
 
-        geo_visitor(geo_iterator &self) : self(self) {}
+        geo_visitor(geo_iterator &self, frame &top) : self(self), top(top) {}
 
         bool operator()(const geo_instance &v) {
-            self.inner =
-                std::make_shared<geo_iterator>(v.begin_intersect(self.box, self.spx, self.spy));
+            auto range = v.get_index_range(get_expand(top.box, top.spx, top.spy));
+            if (range[0][0] == range[0][1] || range[1][0] == range[1][1]) {
+                ++top.cur;
+            } else {
+                top.inst = &v;
+                top.inst_range = range;
+                top.inst_idx = {range[0][0], range[1][0]};
+            }
             return true;
         }
 
+        bool operator()(const box_t &v) {
+            auto test_box = get_expand(top.box, std::max(top.spx, top.cur->spx),
+                                       std::max(top.spy, top.cur->spy));
+            if (!is_physical(intersect(test_box, v))) {
+                ++top.cur;
+                return true;
+            }
+            return false;
+        }
+
         template <typename T> bool operator()(const T &v) {
-            auto test_box = get_expand(self.box, std::max(self.spx, self.cur->spx),
-                                       std::max(self.spy, self.cur->spy));
+            auto test_box = get_expand(top.box, std::max(top.spx, top.cur->spx),
+                                       std::max(top.spy, top.cur->spy));
             if (bp::empty(v & test_box)) {
-                ++self.cur;
+                ++top.cur;
                 return true;
             }
-            self.cur_val = geo_union(v);
-            std::visit(xform_visitor(self.xform), self.cur_val.val);
             return false;
         }
     };
 
-    // advance the iterator to the next point that
+    // push a frame for the next array element of the instance being expanded in the top frame
+    static void push_element(geo_iterator &self) {
+        // push first, as a heap frame may move the frames below it
+        auto &next = self.push_frame();
+        auto &top = self.get_frame(self.depth - 2);
+        auto &[ix, iy] = top.inst_idx;
+        auto inst_xform = top.inst->get_xform(ix, iy);
+        next.box = get_transform(top.box, get_invert(inst_xform));
+        if (flips_xy(inst_xform)) {
+            next.spx = top.spy;
+            next.spy = top.spx;
+        } else {
+            next.spx = top.spx;
+            next.spy = top.spy;
+        }
+        next.xform = get_transform_by(inst_xform, top.xform);
+        auto &master = top.inst->get_master();
+        next.flat = master->get_flat_cache();
+        if (next.flat) {
+            next.flat_idx = next.flat->find_next(0, get_expand(next.box, next.spx, next.spy));
+            next.cur = geo_query_iter();
+        } else {
+            next.cur = master->begin_query(next.box, next.spx, next.spy);
+        }
+        next.inst = nullptr;
+
+        if (++iy == top.inst_range[1][1]) {
+            iy = top.inst_range[1][0];
+            ++ix;
+        }
+    }
+
+    // advance the iterator to the next geometry that intersects the query box
     static void get_val_reference(geo_iterator &self) {
-        for (auto repeat = true; repeat;) {
-            if (self.inner == nullptr) {
-                // no inner loop
-                if (self.cur == self.end) {
-                    return;
+        while (self.depth > 0) {
+            auto &top = self.get_frame(self.depth - 1);
+            if (top.inst) {
+                if (top.inst_idx[0] == top.inst_range[0][1]) {
+                    top.inst = nullptr;
+                    ++top.cur;
                 } else {
-                    // still has item, check intersection
-                    repeat = std::visit(geo_visitor(self), self.cur->val);
+                    push_element(self);
                 }
-            } else {
-                // has inner loop
-                if (self.inner->has_next()) {
-                    // get inner item
-                    self.cur_val = *(*self.inner);
-                    std::visit(xform_visitor(self.xform), self.cur_val.val);
+            } else if (top.flat) {
+                if (top.flat_idx == top.flat->size()) {
+                    --self.depth;
+                } else if (top.flat->intersects(top.flat_idx, top.box, top.spx, top.spy)) {
                     return;
                 } else {
-                    // no more inner items
-                    self.inner.reset();
-                    ++self.cur;
+                    top.flat_idx = top.flat->find_next(top.flat_idx + 1,
+                                                       get_expand(top.box, top.spx, top.spy));
                 }
+            } else if (top.cur == geo_query_iter()) {
+                --self.depth;
+            } else if (!std::visit(geo_visitor(self, top), top.cur->val)) {
+                return;
             }
         }
     }
@@ -79,37 +180,83 @@ struct geo_iterator::helper {
 geo_iterator::geo_iterator() = default;
 
 geo_iterator::geo_iterator(const box_t &box, offset_t spx, offset_t spy, geo_query_iter &&cur,
-                           geo_query_iter &&end, const cbag::transformation &xform)
-    : box(box), spx(spx), spy(spy), cur(std::move(cur)), end(std::move(end)), xform(xform) {
+                           const cbag::transformation &xform) {
+    auto &top = push_frame();
+    top.cur = std::move(cur);
+    top.xform = xform;
+    top.box = box;
+    top.spx = spx;
+    top.spy = spy;
     helper::get_val_reference(*this);
 }
 
-bool geo_iterator::has_next() const { return cur != end; }
+geo_iterator::geo_iterator(const geo_iterator &rhs) { assign_frames(rhs); }
+
+geo_iterator &geo_iterator::operator=(const geo_iterator &rhs) {
+    if (this != &rhs)
+        assign_frames(rhs);
+    return *this;
+}
+
+geo_iterator::frame &geo_iterator::get_frame(std::size_t idx) {
+    return (idx < num_inline) ? stack[idx] : heap_stack[idx - num_inline];
+}
+
+const geo_iterator::frame &geo_iterator::get_frame(std::size_t idx) const {
+    return (idx < num_inline) ? stack[idx] : heap_stack[idx - num_inline];
+}
+
+geo_iterator::frame &geo_iterator::push_frame() {
+    // heap frames are kept when popped, so they can be reused
+    if (depth >= num_inline && heap_stack.size() == depth - num_inline)
+        heap_stack.emplace_back();
+    return get_frame(depth++);
+}
+
+void geo_iterator::assign_frames(const geo_iterator &rhs) {
+    depth = rhs.depth;
+    auto num_stack = std::min(depth, num_inline);
+    std::copy(rhs.stack.begin(), rhs.stack.begin() + num_stack, stack.begin());
+    heap_stack.assign(rhs.heap_stack.begin(), rhs.heap_stack.begin() + (depth - num_stack));
+}
+
+bool geo_iterator::has_next() const { return depth > 0; }
 
 geo_iterator &geo_iterator::operator++() {
-    if (inner == nullptr) {
-        ++cur;
-    } else {
-        ++(*inner);
-    }
+    auto &top = get_frame(depth - 1);
+    if (top.flat)
+        top.flat_idx = top.flat->find_next(top.flat_idx + 1, get_expand(top.box, top.spx, top.spy));
+    else
+        ++top.cur;
     helper::get_val_reference(*this);
     return *this;
 }
 
-geo_iterator geo_iterator::operator++(int) {
-    auto ans = *this;
+geo_iterator::postfix_proxy geo_iterator::operator++(int) {
+    postfix_proxy ans(**this);
     ++(*this);
     return ans;
 }
 
-geo_iterator::reference geo_iterator::operator*() const { return cur_val; }
+geo_iterator::reference geo_iterator::operator*() const {
+    auto &top = get_frame(depth - 1);
+    if (top.flat)
+        return top.flat->get_view(top.flat_idx, top.xform);
+    return {&(*top.cur), top.xform};
+}
 
 bool geo_iterator::operator==(const geo_iterator &rhs) const {
-    auto a = has_next();
-    auto b = rhs.has_next();
-    return (!a && !b) ||
-           (a && b && box == rhs.box && spx == rhs.spx && spy == rhs.spy && cur == rhs.cur &&
-            end == rhs.end && xform == rhs.xform && inner == rhs.inner);
+    if (depth != rhs.depth)
+        return false;
+    for (std::size_t idx = 0; idx < depth; ++idx) {
+        auto &a = get_frame(idx);
+        auto &b = rhs.get_frame(idx);
+        if (!(a.cur == b.cur && a.box == b.box && a.spx == b.spx && a.spy == b.spy &&
+              a.xform == b.xform && a.inst == b.inst && a.inst_idx == b.inst_idx &&
+              a.flat == b.flat && a.flat_idx == b.flat_idx))
+            return false;
+    }
+    return true;
 }
 
 bool geo_iterator::operator!=(const geo_iterator &rhs) const { return !(*this == rhs); }
@@ -5,6 +5,8 @@
 #include <cbag/layout/geometry.h>
 #include <cbag/layout/routing_grid_util.h>
 
+using namespace boost::polygon::operators;
+
 namespace cbag {
 namespace layout {
 
@@ -108,5 +110,35 @@ void geometry::add_shape(const polygon45_set &obj) {
         data);
 }
 
+void geometry::add_shapes(const std::vector<box_t> &obj_list) {
+    std::visit([&obj_list](auto &d) { d.insert(obj_list.begin(), obj_list.end()); }, data);
+}
+
+void geometry::remove_shape(const geo_object::value_type &obj) {
+    std::visit(
+        [](auto &d, const auto &v) {
+            using set_type = std::decay_t<decltype(d)>;
+            using shape_type = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<shape_type, geo_instance>) {
+                throw std::invalid_argument("Cannot remove an instance from geometry.");
+            } else if constexpr ((std::is_same_v<set_type, polygon90_set> &&
+                                  !std::is_same_v<shape_type, box_t> &&
+                                  !std::is_same_v<shape_type, polygon90>) ||
+                                 (std::is_same_v<set_type, polygon45_set> &&
+                                  std::is_same_v<shape_type, polygon>)) {
+                throw std::invalid_argument("Cannot remove shape; incorrect cellview layout mode.");
+            } else {
+                set_type tmp;
+                tmp.insert(v);
+                d -= tmp;
+            }
+        },
+        data, obj);
+}
+
+const polygon90_set *geometry::get_polygon90_set() const noexcept {
+    return std::get_if<polygon90_set>(&data);
+}
+
 } // namespace layout
 } // namespace cbag
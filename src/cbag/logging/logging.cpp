@@ -2,6 +2,7 @@
 #include <cbag/logging/logging.h>
 
 #include "spdlog/details/signal_handler.h"
+#include <spdlog/sinks/dist_sink.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
@@ -41,4 +42,15 @@ std::shared_ptr<spdlog::logger> get_cbag_logger() {
     return spdlog::get("cbag");
 }
 
+std::shared_ptr<spdlog::logger> make_worker_logger(spdlog::logger &logger) {
+    auto sink = std::make_shared<spdlog::sinks::dist_sink_mt>();
+    for (const auto &s : logger.sinks()) {
+        sink->add_sink(s);
+    }
+    auto ans = std::make_shared<spdlog::logger>(logger.name(), std::move(sink));
+    ans->set_level(logger.level());
+    ans->flush_on(logger.flush_level());
+    return ans;
+}
+
 } // namespace cbag
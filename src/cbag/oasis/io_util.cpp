@@ -0,0 +1,480 @@
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include <fmt/core.h>
+
+#include <cbag/oasis/io_util.h>
+
+namespace cbag {
+namespace oasis {
+
+uint8_t oas_cursor::read_byte() {
+    if (cur == stop)
+        throw std::runtime_error("Unexpected end of OASIS data.");
+    return static_cast<uint8_t>(*(cur++));
+}
+
+std::string_view oas_cursor::read_chars(std::size_t n) {
+    if (n > static_cast<std::size_t>(stop - cur))
+        throw std::runtime_error("Unexpected end of OASIS data.");
+    std::string_view ans(cur, n);
+    cur += n;
+    return ans;
+}
+
+std::vector<point> oas_repetition::get_offsets() const {
+    if (!is_regular())
+        return offset_list;
+    std::vector<point> ans;
+    ans.reserve(static_cast<std::size_t>(nx) * ny);
+    for (cnt_t iy = 0; iy < ny; ++iy) {
+        for (cnt_t ix = 0; ix < nx; ++ix) {
+            ans.push_back({static_cast<coord_t>(ix * spx), static_cast<coord_t>(iy * spy)});
+        }
+    }
+    return ans;
+}
+
+uint64_t read_uint(oas_cursor &cur) {
+    uint64_t ans = 0;
+    for (unsigned int shft = 0; shft < 64; shft += 7) {
+        auto b = cur.read_byte();
+        ans |= static_cast<uint64_t>(b & 0x7f) << shft;
+        if ((b & 0x80) == 0)
+            return ans;
+    }
+    throw std::runtime_error("OASIS unsigned integer overflow.");
+}
+
+int64_t read_sint(oas_cursor &cur) {
+    auto val = read_uint(cur);
+    auto mag = static_cast<int64_t>(val >> 1);
+    return ((val & 1) != 0) ? -mag : mag;
+}
+
+template <typename T> T read_little_endian(oas_cursor &cur) {
+    auto data = cur.read_chars(sizeof(T));
+    unsigned char bytes[sizeof(T)];
+    for (std::size_t idx = 0; idx < sizeof(T); ++idx) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        bytes[idx] = static_cast<unsigned char>(data[idx]);
+#else
+        bytes[idx] = static_cast<unsigned char>(data[sizeof(T) - 1 - idx]);
+#endif
+    }
+    T ans;
+    std::memcpy(&ans, bytes, sizeof(T));
+    return ans;
+}
+
+double read_real(oas_cursor &cur) { return read_real(cur, read_uint(cur)); }
+
+double read_real(oas_cursor &cur, uint64_t type) {
+    switch (type) {
+    case 0:
+        return static_cast<double>(read_uint(cur));
+    case 1:
+        return -static_cast<double>(read_uint(cur));
+    case 2:
+        return 1.0 / static_cast<double>(read_uint(cur));
+    case 3:
+        return -1.0 / static_cast<double>(read_uint(cur));
+    case 4:
+    case 5: {
+        auto num = static_cast<double>(read_uint(cur));
+        auto den = static_cast<double>(read_uint(cur));
+        return (type == 4) ? num / den : -num / den;
+    }
+    case 6:
+        return read_little_endian<float>(cur);
+    case 7:
+        return read_little_endian<double>(cur);
+    default:
+        throw std::runtime_error(fmt::format("Unknown OASIS real type {}.", type));
+    }
+}
+
+std::string_view read_string(oas_cursor &cur) { return cur.read_chars(read_uint(cur)); }
+
+// moves pt by mag in one of the eight octangular directions
+void move_octangular(point &pt, uint64_t dir, int64_t mag) {
+    constexpr int dx_list[] = {1, 0, -1, 0, 1, -1, -1, 1};
+    constexpr int dy_list[] = {0, 1, 0, -1, 1, 1, -1, -1};
+    pt[0] += static_cast<coord_t>(dx_list[dir] * mag);
+    pt[1] += static_cast<coord_t>(dy_list[dir] * mag);
+}
+
+point read_gdelta(oas_cursor &cur) {
+    auto val = read_uint(cur);
+    point ans{0, 0};
+    if ((val & 1) == 0) {
+        move_octangular(ans, (val >> 1) & 7, static_cast<int64_t>(val >> 4));
+    } else {
+        auto dx = static_cast<int64_t>(val >> 2);
+        ans[0] = static_cast<coord_t>(((val & 2) != 0) ? -dx : dx);
+        ans[1] = static_cast<coord_t>(read_sint(cur));
+    }
+    return ans;
+}
+
+std::vector<point> read_point_list(oas_cursor &cur, bool is_polygon) {
+    auto type = read_uint(cur);
+    auto num = read_uint(cur);
+    std::vector<point> ans;
+    ans.reserve(num + 2);
+    point pt{0, 0};
+    ans.push_back(pt);
+    point delta{0, 0};
+    for (uint64_t idx = 0; idx < num; ++idx) {
+        switch (type) {
+        case 0:
+        case 1: {
+            auto val = static_cast<coord_t>(read_sint(cur));
+            if ((idx % 2 == 0) == (type == 0))
+                pt[0] += val;
+            else
+                pt[1] += val;
+            break;
+        }
+        case 2: {
+            auto val = read_uint(cur);
+            move_octangular(pt, val & 3, static_cast<int64_t>(val >> 2));
+            break;
+        }
+        case 3: {
+            auto val = read_uint(cur);
+            move_octangular(pt, val & 7, static_cast<int64_t>(val >> 3));
+            break;
+        }
+        case 4: {
+            auto d = read_gdelta(cur);
+            pt[0] += d[0];
+            pt[1] += d[1];
+            break;
+        }
+        case 5: {
+            auto d = read_gdelta(cur);
+            delta[0] += d[0];
+            delta[1] += d[1];
+            pt[0] += delta[0];
+            pt[1] += delta[1];
+            break;
+        }
+        default:
+            throw std::runtime_error(fmt::format("Unknown OASIS point list type {}.", type));
+        }
+        ans.push_back(pt);
+    }
+    if (is_polygon && type < 2) {
+        // the implied vertex continues the alternating directions back to the start
+        if ((num % 2 == 0) == (type == 0))
+            ans.push_back({0, pt[1]});
+        else
+            ans.push_back({pt[0], 0});
+    }
+    return ans;
+}
+
+// returns the offsets of a one dimensional repetition with the given steps
+std::vector<point> get_step_offsets(const std::vector<point> &step_list) {
+    std::vector<point> ans{{0, 0}};
+    for (const auto &step : step_list) {
+        auto &last = ans.back();
+        ans.push_back({last[0] + step[0], last[1] + step[1]});
+    }
+    return ans;
+}
+
+oas_repetition read_repetition(oas_cursor &cur, const oas_repetition &last) {
+    auto type = read_uint(cur);
+    oas_repetition ans;
+    std::vector<point> step_list;
+    switch (type) {
+    case 0:
+        return last;
+    case 1:
+        ans.nx = static_cast<cnt_t>(read_uint(cur) + 2);
+        ans.ny = static_cast<cnt_t>(read_uint(cur) + 2);
+        ans.spx = static_cast<offset_t>(read_uint(cur));
+        ans.spy = static_cast<offset_t>(read_uint(cur));
+        return ans;
+    case 2:
+        ans.nx = static_cast<cnt_t>(read_uint(cur) + 2);
+        ans.spx = static_cast<offset_t>(read_uint(cur));
+        return ans;
+    case 3:
+        ans.ny = static_cast<cnt_t>(read_uint(cur) + 2);
+        ans.spy = static_cast<offset_t>(read_uint(cur));
+        return ans;
+    case 4:
+    case 5:
+    case 6:
+    case 7: {
+        auto num = read_uint(cur) + 1;
+        auto grid = (type == 5 || type == 7) ? static_cast<coord_t>(read_uint(cur)) : 1;
+        auto is_x = (type == 4 || type == 5);
+        for (uint64_t idx = 0; idx < num; ++idx) {
+            auto val = static_cast<coord_t>(read_uint(cur)) * grid;
+            step_list.push_back(is_x ? point{val, 0} : point{0, val});
+        }
+        ans.offset_list = get_step_offsets(step_list);
+        return ans;
+    }
+    case 8: {
+        auto n = static_cast<cnt_t>(read_uint(cur) + 2);
+        auto m = static_cast<cnt_t>(read_uint(cur) + 2);
+        auto nd = read_gdelta(cur);
+        auto md = read_gdelta(cur);
+        if (nd[1] == 0 && md[0] == 0) {
+            ans.nx = n;
+            ans.ny = m;
+            ans.spx = nd[0];
+            ans.spy = md[1];
+        } else if (nd[0] == 0 && md[1] == 0) {
+            ans.nx = m;
+            ans.ny = n;
+            ans.spx = md[0];
+            ans.spy = nd[1];
+        } else {
+            for (coord_t j = 0; j < static_cast<coord_t>(m); ++j) {
+                for (coord_t i = 0; i < static_cast<coord_t>(n); ++i) {
+                    ans.offset_list.push_back({i * nd[0] + j * md[0], i * nd[1] + j * md[1]});
+                }
+            }
+        }
+        return ans;
+    }
+    case 9: {
+        auto n = static_cast<cnt_t>(read_uint(cur) + 2);
+        auto d = read_gdelta(cur);
+        if (d[1] == 0) {
+            ans.nx = n;
+            ans.spx = d[0];
+        } else if (d[0] == 0) {
+            ans.ny = n;
+            ans.spy = d[1];
+        } else {
+            for (coord_t i = 0; i < static_cast<coord_t>(n); ++i) {
+                ans.offset_list.push_back({i * d[0], i * d[1]});
+            }
+        }
+        return ans;
+    }
+    case 10:
+    case 11: {
+        auto num = read_uint(cur) + 1;
+        auto grid = (type == 11) ? static_cast<coord_t>(read_uint(cur)) : 1;
+        for (uint64_t idx = 0; idx < num; ++idx) {
+            auto d = read_gdelta(cur);
+            step_list.push_back({d[0] * grid, d[1] * grid});
+        }
+        ans.offset_list = get_step_offsets(step_list);
+        return ans;
+    }
+    default:
+        throw std::runtime_error(fmt::format("Unknown OASIS repetition type {}.", type));
+    }
+}
+
+std::string read_cblock(oas_cursor &cur) {
+    auto comp_type = read_uint(cur);
+    if (comp_type != 0)
+        throw std::runtime_error(fmt::format("Unknown OASIS CBLOCK compression {}.", comp_type));
+    auto uncomp_size = read_uint(cur);
+    auto comp_size = read_uint(cur);
+    auto data = cur.read_chars(comp_size);
+
+    std::string ans(uncomp_size, '\0');
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    // negative window bits for raw deflate data
+    if (inflateInit2(&strm, -15) != Z_OK)
+        throw std::runtime_error("Cannot initialize CBLOCK decompression.");
+    std::unique_ptr<z_stream, int (*)(z_stream *)> guard(&strm, inflateEnd);
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    strm.avail_in = static_cast<uInt>(data.size());
+    strm.next_out = reinterpret_cast<Bytef *>(ans.data());
+    strm.avail_out = static_cast<uInt>(ans.size());
+    auto ret = inflate(&strm, Z_FINISH);
+    if (ret != Z_STREAM_END || strm.avail_out != 0)
+        throw std::runtime_error("Corrupt OASIS CBLOCK data.");
+    return ans;
+}
+
+void write_byte(std::string &buf, uint8_t val) { buf.push_back(static_cast<char>(val)); }
+
+void write_uint(std::string &buf, uint64_t val) {
+    do {
+        auto b = static_cast<uint8_t>(val & 0x7f);
+        val >>= 7;
+        if (val != 0)
+            b |= 0x80;
+        write_byte(buf, b);
+    } while (val != 0);
+}
+
+void write_sint(std::string &buf, int64_t val) {
+    auto mag = static_cast<uint64_t>((val < 0) ? -val : val);
+    write_uint(buf, (mag << 1) | ((val < 0) ? 1 : 0));
+}
+
+void write_real(std::string &buf, double val) {
+    if (val == std::floor(val) && std::abs(val) < 1e18) {
+        write_uint(buf, (val < 0) ? 1 : 0);
+        write_uint(buf, static_cast<uint64_t>(std::abs(val)));
+        return;
+    }
+    write_uint(buf, 7);
+    unsigned char bytes[sizeof(double)];
+    std::memcpy(bytes, &val, sizeof(double));
+    for (std::size_t idx = 0; idx < sizeof(double); ++idx) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        write_byte(buf, bytes[idx]);
+#else
+        write_byte(buf, bytes[sizeof(double) - 1 - idx]);
+#endif
+    }
+}
+
+void write_string(std::string &buf, std::string_view val) {
+    write_uint(buf, val.size());
+    buf.append(val.data(), val.size());
+}
+
+// returns the octangular direction and magnitude of a delta, or a negative direction if the delta
+// is not octangular
+std::tuple<int, uint64_t> get_direction(coord_t dx, coord_t dy) {
+    auto adx = static_cast<uint64_t>(std::abs(static_cast<int64_t>(dx)));
+    auto ady = static_cast<uint64_t>(std::abs(static_cast<int64_t>(dy)));
+    if (dy == 0)
+        return {(dx >= 0) ? 0 : 2, adx};
+    if (dx == 0)
+        return {(dy > 0) ? 1 : 3, ady};
+    if (adx != ady)
+        return {-1, 0};
+    if (dx > 0)
+        return {(dy > 0) ? 4 : 7, adx};
+    return {(dy > 0) ? 5 : 6, adx};
+}
+
+void write_gdelta(std::string &buf, coord_t dx, coord_t dy) {
+    auto[dir, mag] = get_direction(dx, dy);
+    if (dir >= 0) {
+        write_uint(buf, (mag << 4) | (static_cast<uint64_t>(dir) << 1));
+    } else {
+        auto adx = static_cast<uint64_t>(std::abs(static_cast<int64_t>(dx)));
+        write_uint(buf, (adx << 2) | ((dx < 0) ? 2 : 0) | 1);
+        write_sint(buf, dy);
+    }
+}
+
+void write_point_list(std::string &buf, const std::vector<point> &pt_list) {
+    // 2 for manhattan, 3 for octangular, 4 for all-angle
+    uint64_t type = 2;
+    for (std::size_t idx = 1; idx < pt_list.size(); ++idx) {
+        auto dir = std::get<0>(get_direction(pt_list[idx][0] - pt_list[idx - 1][0],
+                                             pt_list[idx][1] - pt_list[idx - 1][1]));
+        if (dir < 0) {
+            type = 4;
+            break;
+        }
+        if (dir > 3)
+            type = 3;
+    }
+
+    write_uint(buf, type);
+    write_uint(buf, pt_list.size() - 1);
+    for (std::size_t idx = 1; idx < pt_list.size(); ++idx) {
+        auto dx = pt_list[idx][0] - pt_list[idx - 1][0];
+        auto dy = pt_list[idx][1] - pt_list[idx - 1][1];
+        if (type == 4) {
+            write_gdelta(buf, dx, dy);
+        } else {
+            auto[dir, mag] = get_direction(dx, dy);
+            write_uint(buf, (mag << type) | static_cast<uint64_t>(dir));
+        }
+    }
+}
+
+void write_repetition(std::string &buf, const oas_repetition &rep) {
+    if (!rep.is_regular()) {
+        auto &offset_list = rep.offset_list;
+        if (offset_list.size() < 2)
+            throw std::invalid_argument("OASIS repetition needs at least 2 elements.");
+        write_uint(buf, 10);
+        write_uint(buf, offset_list.size() - 2);
+        for (std::size_t idx = 1; idx < offset_list.size(); ++idx) {
+            write_gdelta(buf, offset_list[idx][0] - offset_list[idx - 1][0],
+                         offset_list[idx][1] - offset_list[idx - 1][1]);
+        }
+        return;
+    }
+
+    if (rep.nx > 1 && rep.ny > 1) {
+        if (rep.spx >= 0 && rep.spy >= 0) {
+            write_uint(buf, 1);
+            write_uint(buf, rep.nx - 2);
+            write_uint(buf, rep.ny - 2);
+            write_uint(buf, rep.spx);
+            write_uint(buf, rep.spy);
+        } else {
+            write_uint(buf, 8);
+            write_uint(buf, rep.nx - 2);
+            write_uint(buf, rep.ny - 2);
+            write_gdelta(buf, rep.spx, 0);
+            write_gdelta(buf, 0, rep.spy);
+        }
+    } else if (rep.nx > 1) {
+        if (rep.spx >= 0) {
+            write_uint(buf, 2);
+            write_uint(buf, rep.nx - 2);
+            write_uint(buf, rep.spx);
+        } else {
+            write_uint(buf, 9);
+            write_uint(buf, rep.nx - 2);
+            write_gdelta(buf, rep.spx, 0);
+        }
+    } else if (rep.ny > 1) {
+        if (rep.spy >= 0) {
+            write_uint(buf, 3);
+            write_uint(buf, rep.ny - 2);
+            write_uint(buf, rep.spy);
+        } else {
+            write_uint(buf, 9);
+            write_uint(buf, rep.ny - 2);
+            write_gdelta(buf, 0, rep.spy);
+        }
+    } else {
+        throw std::invalid_argument("OASIS repetition needs at least 2 elements.");
+    }
+}
+
+void write_cblock(std::string &buf, std::string_view data) {
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK)
+        throw std::runtime_error("Cannot initialize CBLOCK compression.");
+    std::unique_ptr<z_stream, int (*)(z_stream *)> guard(&strm, deflateEnd);
+    std::string comp(deflateBound(&strm, static_cast<uLong>(data.size())), '\0');
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    strm.avail_in = static_cast<uInt>(data.size());
+    strm.next_out = reinterpret_cast<Bytef *>(comp.data());
+    strm.avail_out = static_cast<uInt>(comp.size());
+    if (deflate(&strm, Z_FINISH) != Z_STREAM_END)
+        throw std::runtime_error("CBLOCK compression failed.");
+    comp.resize(comp.size() - strm.avail_out);
+
+    write_byte(buf, static_cast<uint8_t>(record_type::CBLOCK));
+    write_uint(buf, 0);
+    write_uint(buf, data.size());
+    write_uint(buf, comp.size());
+    buf.append(comp);
+}
+
+} // namespace oasis
+} // namespace cbag
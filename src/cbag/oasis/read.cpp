@@ -0,0 +1,717 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <optional>
+#include <unordered_map>
+#include <variant>
+
+#include <fmt/core.h>
+
+#include <cbag/util/overload.h>
+
+#include <cbag/common/transformation_util.h>
+#include <cbag/gdsii/read_util.h>
+#include <cbag/oasis/io_util.h>
+#include <cbag/oasis/read.h>
+
+namespace cbag {
+namespace oasis {
+
+// a name given either directly or as a reference number into a name table
+using oas_name = std::variant<uint64_t, std::string>;
+using name_table = std::unordered_map<uint64_t, std::string>;
+
+// the name tables, indexed by table_index
+enum table_index : std::size_t {
+    TABLE_CELL = 0,
+    TABLE_TEXT = 1,
+    TABLE_PROPNAME = 2,
+    TABLE_PROPSTRING = 3,
+};
+
+struct oas_placement {
+    oas_name cell;
+    transformation xform;
+    double mag = 1.0;
+    oas_repetition rep;
+    // the names and first string values of the properties of this placement
+    std::vector<std::pair<oas_name, oas_name>> prop_list;
+};
+
+struct oas_text {
+    gdsii::gds_layer_t key;
+    oas_name text;
+    point loc;
+};
+
+/** The contents of one OASIS cell, kept until all names are known.
+ */
+struct oas_cell {
+    oas_name name;
+    gdsii::gds_shape_map shape_map;
+    std::vector<std::tuple<gdsii::gds_layer_t, gdsii::gds_path>> path_list;
+    std::vector<oas_placement> inst_list;
+    std::vector<oas_text> text_list;
+};
+
+/** The modal variables, reset at the start of every cell.
+ */
+struct oas_modal {
+    bool xy_relative = false;
+    std::optional<oas_name> placement_cell;
+    point placement_pt = {0, 0};
+    uint64_t layer = 0;
+    uint64_t datatype = 0;
+    uint64_t textlayer = 0;
+    uint64_t texttype = 0;
+    point text_pt = {0, 0};
+    std::optional<oas_name> text_string;
+    point geometry_pt = {0, 0};
+    uint64_t geometry_w = 0;
+    uint64_t geometry_h = 0;
+    std::vector<point> polygon_pt_list;
+    uint64_t path_halfwidth = 0;
+    int64_t path_start_ext = 0;
+    int64_t path_end_ext = 0;
+    std::vector<point> path_pt_list;
+    oas_repetition rep;
+    std::optional<oas_name> prop_name;
+    std::vector<oas_name> prop_value_list;
+};
+
+oas_name read_name(oas_cursor &cur, bool is_ref) {
+    if (is_ref)
+        return read_uint(cur);
+    return std::string(read_string(cur));
+}
+
+void skip_interval(oas_cursor &cur) {
+    auto type = read_uint(cur);
+    switch (type) {
+    case 0:
+        break;
+    case 1:
+    case 2:
+    case 3:
+        read_uint(cur);
+        break;
+    case 4:
+        read_uint(cur);
+        read_uint(cur);
+        break;
+    default:
+        throw std::runtime_error(fmt::format("Unknown OASIS interval type {}.", type));
+    }
+}
+
+transformation get_xform(bool flip, double angle) {
+    auto ans = make_xform();
+    if (flip)
+        set_orient(ans, oMX);
+    auto quarter = std::lround(angle / 90);
+    if (std::abs(angle - quarter * 90.0) > 1e-9)
+        throw std::runtime_error(fmt::format("OASIS rotation angle not supported: {}", angle));
+    switch (((quarter % 4) + 4) % 4) {
+    case 1:
+        transform_by(ans, make_xform(0, 0, oR90));
+        break;
+    case 2:
+        transform_by(ans, make_xform(0, 0, oR180));
+        break;
+    case 3:
+        transform_by(ans, make_xform(0, 0, oR270));
+        break;
+    default:
+        break;
+    }
+    return ans;
+}
+
+// adds the vertices moved by the offset as one shape, either a box or a polygon
+void add_polygon(gdsii::gds_shape_buffer &buf, const std::vector<point> &pt_list,
+                 const point &offset) {
+    auto start = buf.pt_list.size();
+    for (const auto &pt : pt_list) {
+        buf.pt_list.push_back({pt[0] + offset[0], pt[1] + offset[1]});
+    }
+    if (auto box = gdsii::get_rectangle(buf.pt_list.data() + start, pt_list.size())) {
+        buf.box_list.push_back(*box);
+        buf.pt_list.resize(start);
+    } else {
+        buf.poly_end_list.push_back(buf.pt_list.size());
+    }
+}
+
+// returns the vertices of a trapezoid, with repeated vertices of degenerate trapezoids removed
+std::vector<point> get_trapezoid(bool vertical, coord_t w, coord_t h, coord_t delta_a,
+                                 coord_t delta_b) {
+    std::vector<point> ans;
+    if (vertical) {
+        ans = {point{0, std::max(delta_a, 0)}, point{0, h + std::min(delta_b, 0)},
+               point{w, h - std::max(delta_b, 0)}, point{w, -std::min(delta_a, 0)}};
+    } else {
+        ans = {point{std::max(delta_a, 0), h}, point{w + std::min(delta_b, 0), h},
+               point{w - std::max(delta_b, 0), 0}, point{-std::min(delta_a, 0), 0}};
+    }
+    ans.erase(std::unique(ans.begin(), ans.end()), ans.end());
+    if (ans.size() > 1 && ans.front() == ans.back())
+        ans.pop_back();
+    return ans;
+}
+
+/** Parses OASIS records into per-cell data.  CBLOCK contents are parsed recursively with the
+ *  same state, as a compressed block may end in the middle of a cell.
+ */
+class oas_parser {
+  private:
+    spdlog::logger &logger;
+    std::vector<oas_cell> cell_list;
+    std::array<name_table, 4> table_list;
+    std::array<uint64_t, 4> implicit_cnt = {0, 0, 0, 0};
+    oas_modal modal;
+    // the index of the placement that properties are attached to
+    std::optional<std::size_t> last_inst;
+    std::size_t num_skipped = 0;
+
+  public:
+    explicit oas_parser(spdlog::logger &logger) : logger(logger) {}
+
+    /** Parses records until the END record or the end of data.  Returns true if END was found.
+     */
+    bool parse(oas_cursor &cur) {
+        while (!cur.empty()) {
+            auto rtype = static_cast<record_type>(cur.read_byte());
+            if (rtype != record_type::PROPERTY && rtype != record_type::PROPERTY_REPEAT &&
+                rtype != record_type::PAD && rtype != record_type::CBLOCK)
+                last_inst.reset();
+
+            switch (rtype) {
+            case record_type::PAD:
+                break;
+            case record_type::START:
+                read_start(cur);
+                break;
+            case record_type::END:
+                return true;
+            case record_type::CELLNAME_IMPLICIT:
+            case record_type::CELLNAME:
+            case record_type::TEXTSTRING_IMPLICIT:
+            case record_type::TEXTSTRING:
+            case record_type::PROPNAME_IMPLICIT:
+            case record_type::PROPNAME:
+            case record_type::PROPSTRING_IMPLICIT:
+            case record_type::PROPSTRING: {
+                auto code = static_cast<std::size_t>(rtype) - 3;
+                read_table_name(cur, code / 2, code % 2 == 1);
+                break;
+            }
+            case record_type::LAYERNAME:
+            case record_type::LAYERNAME_TEXT:
+                read_string(cur);
+                skip_interval(cur);
+                skip_interval(cur);
+                break;
+            case record_type::CELL_REF:
+            case record_type::CELL:
+                cell_list.emplace_back();
+                cell_list.back().name = read_name(cur, rtype == record_type::CELL_REF);
+                modal = oas_modal();
+                break;
+            case record_type::XYABSOLUTE:
+                modal.xy_relative = false;
+                break;
+            case record_type::XYRELATIVE:
+                modal.xy_relative = true;
+                break;
+            case record_type::PLACEMENT:
+            case record_type::PLACEMENT_MAG:
+                read_placement(cur, rtype == record_type::PLACEMENT_MAG);
+                break;
+            case record_type::TEXT:
+                read_text(cur);
+                break;
+            case record_type::RECTANGLE:
+                read_rectangle(cur);
+                break;
+            case record_type::POLYGON:
+                read_polygon(cur);
+                break;
+            case record_type::PATH:
+                read_path(cur);
+                break;
+            case record_type::TRAPEZOID:
+            case record_type::TRAPEZOID_A:
+            case record_type::TRAPEZOID_B:
+                read_trapezoid(cur, rtype != record_type::TRAPEZOID_B,
+                               rtype != record_type::TRAPEZOID_A);
+                break;
+            case record_type::CTRAPEZOID:
+                skip_ctrapezoid(cur);
+                break;
+            case record_type::CIRCLE:
+                skip_circle(cur);
+                break;
+            case record_type::PROPERTY:
+                read_property(cur);
+                break;
+            case record_type::PROPERTY_REPEAT:
+                add_property();
+                break;
+            case record_type::XNAME_IMPLICIT:
+            case record_type::XNAME:
+                read_uint(cur);
+                read_string(cur);
+                if (rtype == record_type::XNAME)
+                    read_uint(cur);
+                break;
+            case record_type::XELEMENT:
+                read_uint(cur);
+                read_string(cur);
+                break;
+            case record_type::XGEOMETRY:
+                skip_xgeometry(cur);
+                break;
+            case record_type::CBLOCK: {
+                auto data = read_cblock(cur);
+                oas_cursor block(data.data(), data.size());
+                if (parse(block))
+                    return true;
+                break;
+            }
+            default:
+                throw std::runtime_error(
+                    fmt::format("Unrecognized OASIS record type: {}", static_cast<int>(rtype)));
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::shared_ptr<layout::cellview>>
+    get_cellviews(const gdsii::gds_rlookup &rmap,
+                  const std::shared_ptr<const layout::routing_grid> &g) {
+        if (num_skipped > 0)
+            logger.warn("Skipped {} OASIS circles, compact trapezoids and extension geometries.",
+                        num_skipped);
+
+        std::unordered_map<std::string, std::size_t> idx_map;
+        for (std::size_t idx = 0; idx < cell_list.size(); ++idx) {
+            auto &cell_name = resolve(cell_list[idx].name, TABLE_CELL);
+            if (!idx_map.emplace(cell_name, idx).second)
+                throw std::runtime_error(fmt::format("Duplicate OASIS cell {}.", cell_name));
+        }
+
+        std::vector<std::shared_ptr<layout::cellview>> ans(cell_list.size());
+        std::vector<bool> visiting(cell_list.size(), false);
+        for (std::size_t idx = 0; idx < cell_list.size(); ++idx) {
+            make_cellview(idx, idx_map, rmap, g, ans, visiting);
+        }
+        return ans;
+    }
+
+  private:
+    oas_cell &get_cell() {
+        if (cell_list.empty())
+            throw std::runtime_error("OASIS element found outside of a cell.");
+        return cell_list.back();
+    }
+
+    const std::string &resolve(const oas_name &name, std::size_t table) const {
+        return std::visit(
+            overload{
+                [](const std::string &v) -> const std::string & { return v; },
+                [this, table](uint64_t v) -> const std::string & {
+                    auto iter = table_list[table].find(v);
+                    if (iter == table_list[table].end())
+                        throw std::runtime_error(
+                            fmt::format("Undefined OASIS name reference {} in table {}.", v,
+                                        table));
+                    return iter->second;
+                },
+            },
+            name);
+    }
+
+    void read_start(oas_cursor &cur) {
+        auto version = read_string(cur);
+        if (version != VERSION)
+            logger.warn("Unknown OASIS version {}.", version);
+        // cellviews always use the resolution of the technology, like GDS
+        read_real(cur);
+        if (read_uint(cur) == 0) {
+            for (int idx = 0; idx < 12; ++idx) {
+                read_uint(cur);
+            }
+        }
+    }
+
+    void read_table_name(oas_cursor &cur, std::size_t table, bool has_ref) {
+        auto name = std::string(read_string(cur));
+        auto refnum = has_ref ? read_uint(cur) : implicit_cnt[table]++;
+        table_list[table][refnum] = std::move(name);
+    }
+
+    void read_xy(oas_cursor &cur, uint8_t info, uint8_t x_bit, uint8_t y_bit, point &pt) {
+        if ((info & x_bit) != 0) {
+            auto val = static_cast<coord_t>(read_sint(cur));
+            pt[0] = modal.xy_relative ? pt[0] + val : val;
+        }
+        if ((info & y_bit) != 0) {
+            auto val = static_cast<coord_t>(read_sint(cur));
+            pt[1] = modal.xy_relative ? pt[1] + val : val;
+        }
+    }
+
+    std::vector<point> read_offsets(oas_cursor &cur, bool has_rep) {
+        if (!has_rep)
+            return {point{0, 0}};
+        modal.rep = read_repetition(cur, modal.rep);
+        return modal.rep.get_offsets();
+    }
+
+    void read_layer(oas_cursor &cur, uint8_t info) {
+        if ((info & 0x01) != 0)
+            modal.layer = read_uint(cur);
+        if ((info & 0x02) != 0)
+            modal.datatype = read_uint(cur);
+    }
+
+    gdsii::gds_layer_t get_layer() const {
+        return {static_cast<gdsii::glay_t>(modal.layer),
+                static_cast<gdsii::gpurp_t>(modal.datatype)};
+    }
+
+    void read_placement(oas_cursor &cur, bool has_mag) {
+        auto info = cur.read_byte();
+        auto &cell = get_cell();
+        if ((info & 0x80) != 0)
+            modal.placement_cell = read_name(cur, (info & 0x40) != 0);
+        double mag = 1.0;
+        double angle = 0.0;
+        if (has_mag) {
+            if ((info & 0x04) != 0)
+                mag = read_real(cur);
+            if ((info & 0x02) != 0)
+                angle = read_real(cur);
+        } else {
+            angle = 90.0 * ((info >> 1) & 0x03);
+        }
+        read_xy(cur, info, 0x20, 0x10, modal.placement_pt);
+        oas_repetition rep;
+        if ((info & 0x08) != 0) {
+            modal.rep = read_repetition(cur, modal.rep);
+            rep = modal.rep;
+        }
+        if (!modal.placement_cell)
+            throw std::runtime_error("OASIS placement has no cell.");
+
+        auto xform = get_xform((info & 0x01) != 0, angle);
+        move_by(xform, modal.placement_pt[0], modal.placement_pt[1]);
+        cell.inst_list.push_back(
+            oas_placement{*modal.placement_cell, std::move(xform), mag, std::move(rep), {}});
+        last_inst = cell.inst_list.size() - 1;
+    }
+
+    void read_text(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        auto &cell = get_cell();
+        if ((info & 0x40) != 0)
+            modal.text_string = read_name(cur, (info & 0x20) != 0);
+        if ((info & 0x01) != 0)
+            modal.textlayer = read_uint(cur);
+        if ((info & 0x02) != 0)
+            modal.texttype = read_uint(cur);
+        read_xy(cur, info, 0x10, 0x08, modal.text_pt);
+        auto offset_list = read_offsets(cur, (info & 0x04) != 0);
+        if (!modal.text_string)
+            throw std::runtime_error("OASIS text has no string.");
+
+        auto key = gdsii::gds_layer_t{static_cast<gdsii::glay_t>(modal.textlayer),
+                                      static_cast<gdsii::gpurp_t>(modal.texttype)};
+        for (const auto &offset : offset_list) {
+            cell.text_list.push_back(oas_text{key, *modal.text_string,
+                                              point{modal.text_pt[0] + offset[0],
+                                                    modal.text_pt[1] + offset[1]}});
+        }
+    }
+
+    void read_rectangle(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        auto &cell = get_cell();
+        read_layer(cur, info);
+        if ((info & 0x40) != 0)
+            modal.geometry_w = read_uint(cur);
+        if ((info & 0x80) != 0)
+            modal.geometry_h = modal.geometry_w;
+        else if ((info & 0x20) != 0)
+            modal.geometry_h = read_uint(cur);
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        auto offset_list = read_offsets(cur, (info & 0x04) != 0);
+
+        auto &buf = cell.shape_map[get_layer()];
+        auto x0 = modal.geometry_pt[0];
+        auto y0 = modal.geometry_pt[1];
+        auto w = static_cast<coord_t>(modal.geometry_w);
+        auto h = static_cast<coord_t>(modal.geometry_h);
+        for (const auto &offset : offset_list) {
+            auto xl = x0 + offset[0];
+            auto yl = y0 + offset[1];
+            buf.box_list.emplace_back(xl, yl, xl + w, yl + h);
+        }
+    }
+
+    void read_polygon(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        auto &cell = get_cell();
+        read_layer(cur, info);
+        if ((info & 0x20) != 0)
+            modal.polygon_pt_list = read_point_list(cur, true);
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        auto offset_list = read_offsets(cur, (info & 0x04) != 0);
+
+        auto &buf = cell.shape_map[get_layer()];
+        for (const auto &offset : offset_list) {
+            add_polygon(buf, modal.polygon_pt_list,
+                        point{modal.geometry_pt[0] + offset[0], modal.geometry_pt[1] + offset[1]});
+        }
+    }
+
+    int64_t read_extension(oas_cursor &cur, uint64_t scheme, int64_t last) {
+        switch (scheme) {
+        case 1:
+            return 0;
+        case 2:
+            return static_cast<int64_t>(modal.path_halfwidth);
+        case 3:
+            return read_sint(cur);
+        default:
+            return last;
+        }
+    }
+
+    void read_path(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        auto &cell = get_cell();
+        read_layer(cur, info);
+        if ((info & 0x40) != 0)
+            modal.path_halfwidth = read_uint(cur);
+        if ((info & 0x80) != 0) {
+            auto scheme = read_uint(cur);
+            modal.path_start_ext = read_extension(cur, (scheme >> 2) & 0x03, modal.path_start_ext);
+            modal.path_end_ext = read_extension(cur, scheme & 0x03, modal.path_end_ext);
+        }
+        if ((info & 0x20) != 0)
+            modal.path_pt_list = read_point_list(cur, false);
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        auto offset_list = read_offsets(cur, (info & 0x04) != 0);
+
+        for (const auto &offset : offset_list) {
+            gdsii::gds_path path;
+            path.path_type = 4;
+            path.width = static_cast<int32_t>(2 * modal.path_halfwidth);
+            path.bgn_extn = static_cast<int32_t>(modal.path_start_ext);
+            path.end_extn = static_cast<int32_t>(modal.path_end_ext);
+            path.pt_list.reserve(modal.path_pt_list.size());
+            auto dx = modal.geometry_pt[0] + offset[0];
+            auto dy = modal.geometry_pt[1] + offset[1];
+            for (const auto &pt : modal.path_pt_list) {
+                path.pt_list.push_back({pt[0] + dx, pt[1] + dy});
+            }
+            cell.path_list.emplace_back(get_layer(), std::move(path));
+        }
+    }
+
+    void read_trapezoid(oas_cursor &cur, bool has_a, bool has_b) {
+        auto info = cur.read_byte();
+        auto &cell = get_cell();
+        read_layer(cur, info);
+        if ((info & 0x40) != 0)
+            modal.geometry_w = read_uint(cur);
+        if ((info & 0x20) != 0)
+            modal.geometry_h = read_uint(cur);
+        auto delta_a = has_a ? static_cast<coord_t>(read_sint(cur)) : 0;
+        auto delta_b = has_b ? static_cast<coord_t>(read_sint(cur)) : 0;
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        auto offset_list = read_offsets(cur, (info & 0x04) != 0);
+
+        auto pt_list = get_trapezoid((info & 0x80) != 0, static_cast<coord_t>(modal.geometry_w),
+                                     static_cast<coord_t>(modal.geometry_h), delta_a, delta_b);
+        if (pt_list.size() < 3)
+            return;
+        auto &buf = cell.shape_map[get_layer()];
+        for (const auto &offset : offset_list) {
+            add_polygon(buf, pt_list,
+                        point{modal.geometry_pt[0] + offset[0], modal.geometry_pt[1] + offset[1]});
+        }
+    }
+
+    void skip_ctrapezoid(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        read_layer(cur, info);
+        if ((info & 0x80) != 0)
+            read_uint(cur);
+        if ((info & 0x40) != 0)
+            modal.geometry_w = read_uint(cur);
+        if ((info & 0x20) != 0)
+            modal.geometry_h = read_uint(cur);
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        read_offsets(cur, (info & 0x04) != 0);
+        ++num_skipped;
+    }
+
+    void skip_circle(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        read_layer(cur, info);
+        if ((info & 0x20) != 0)
+            read_uint(cur);
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        read_offsets(cur, (info & 0x04) != 0);
+        ++num_skipped;
+    }
+
+    void skip_xgeometry(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        read_uint(cur);
+        read_layer(cur, info);
+        read_string(cur);
+        read_xy(cur, info, 0x10, 0x08, modal.geometry_pt);
+        read_offsets(cur, (info & 0x04) != 0);
+        ++num_skipped;
+    }
+
+    void read_property(oas_cursor &cur) {
+        auto info = cur.read_byte();
+        if ((info & 0x04) != 0)
+            modal.prop_name = read_name(cur, (info & 0x02) != 0);
+        if ((info & 0x08) == 0) {
+            uint64_t num = info >> 4;
+            if (num == 15)
+                num = read_uint(cur);
+            // only string values are kept
+            modal.prop_value_list.clear();
+            for (uint64_t idx = 0; idx < num; ++idx) {
+                auto type = read_uint(cur);
+                if (type <= 7) {
+                    read_real(cur, type);
+                } else if (type == 8) {
+                    read_uint(cur);
+                } else if (type == 9) {
+                    read_sint(cur);
+                } else if (type <= 12) {
+                    modal.prop_value_list.emplace_back(std::string(read_string(cur)));
+                } else if (type <= 15) {
+                    modal.prop_value_list.emplace_back(read_uint(cur));
+                } else {
+                    throw std::runtime_error(
+                        fmt::format("Unknown OASIS property value type {}.", type));
+                }
+            }
+        }
+        add_property();
+    }
+
+    void add_property() {
+        if (!last_inst || !modal.prop_name || modal.prop_value_list.empty())
+            return;
+        get_cell().inst_list[*last_inst].prop_list.emplace_back(*modal.prop_name,
+                                                                modal.prop_value_list[0]);
+    }
+
+    std::string get_inst_name(const oas_placement &inst) const {
+        for (const auto & [ name, value ] : inst.prop_list) {
+            if (resolve(name, TABLE_PROPNAME) == PROP_INST_NAME)
+                return resolve(value, TABLE_PROPSTRING);
+        }
+        return "";
+    }
+
+    std::shared_ptr<layout::cellview>
+    make_cellview(std::size_t idx, const std::unordered_map<std::string, std::size_t> &idx_map,
+                  const gdsii::gds_rlookup &rmap,
+                  const std::shared_ptr<const layout::routing_grid> &g,
+                  std::vector<std::shared_ptr<layout::cellview>> &cv_list,
+                  std::vector<bool> &visiting) {
+        if (cv_list[idx])
+            return cv_list[idx];
+        auto &cell = cell_list[idx];
+        auto &cell_name = resolve(cell.name, TABLE_CELL);
+        if (visiting[idx])
+            throw std::runtime_error(
+                fmt::format("Circular reference to OASIS cell {}.", cell_name));
+        visiting[idx] = true;
+
+        SPDLOG_LOGGER_TRACE(&logger, "OASIS cellview name: {}", cell_name);
+        auto cv_ptr = std::make_shared<layout::cellview>(g, cell_name, geometry_mode::POLY);
+        auto inst_cnt = static_cast<std::size_t>(0);
+        for (const auto &inst : cell.inst_list) {
+            auto &master_name = resolve(inst.cell, TABLE_CELL);
+            auto iter = idx_map.find(master_name);
+            if (iter == idx_map.end())
+                throw std::runtime_error(
+                    fmt::format("Cannot find layout cellview {} in OASIS file.", master_name));
+            auto master = make_cellview(iter->second, idx_map, rmap, g, cv_list, visiting);
+
+            auto inst_name = get_inst_name(inst);
+            if (inst_name.empty()) {
+                inst_name = "X" + std::to_string(inst_cnt);
+                ++inst_cnt;
+            }
+            std::vector<layout::instance> obj_list;
+            auto &rep = inst.rep;
+            if (rep.is_regular()) {
+                obj_list.emplace_back(std::move(inst_name), master, inst.xform, rep.nx, rep.ny,
+                                      rep.spx, rep.spy);
+            } else {
+                // irregular repetitions become one instance per element
+                for (std::size_t k = 0; k < rep.offset_list.size(); ++k) {
+                    auto &offset = rep.offset_list[k];
+                    obj_list.emplace_back(fmt::format("{}_{}", inst_name, k), master,
+                                          get_move_by(inst.xform, offset[0], offset[1]));
+                }
+            }
+            for (const auto &obj : obj_list) {
+                if (inst.mag == 1.0)
+                    cv_ptr->add_object(obj);
+                else
+                    gdsii::add_magnified(logger, *cv_ptr, obj, inst.mag);
+            }
+        }
+
+        for (const auto &text : cell.text_list) {
+            auto map_val = rmap.get_mapping(text.key);
+            if (auto key_ptr = std::get_if<layer_t>(&map_val)) {
+                cv_ptr->add_label(layer_t(*key_ptr), make_xform(text.loc[0], text.loc[1]),
+                                  std::string(resolve(text.text, TABLE_TEXT)), 0);
+            } else {
+                logger.warn("Cannot add OASIS text on layer/datatype ({}, {}), skipping.",
+                            text.key.first, text.key.second);
+            }
+        }
+
+        gdsii::add_shapes(logger, *cv_ptr, cell.shape_map, rmap);
+        for (auto & [ gds_key, path ] : cell.path_list) {
+            gdsii::add_path(logger, *cv_ptr, gds_key, std::move(path), rmap);
+        }
+
+        cv_list[idx] = cv_ptr;
+        return cv_ptr;
+    }
+};
+
+std::vector<std::shared_ptr<layout::cellview>>
+read_oas(spdlog::logger &logger, std::string_view data, const gdsii::gds_rlookup &rmap,
+         const std::shared_ptr<const layout::routing_grid> &g) {
+    if (data.substr(0, MAGIC_SIZE) != MAGIC)
+        throw std::runtime_error("Not an OASIS file.");
+    if (data.size() <= MAGIC_SIZE ||
+        static_cast<record_type>(data[MAGIC_SIZE]) != record_type::START)
+        throw std::runtime_error("OASIS file does not begin with a START record.");
+
+    oas_parser parser(logger);
+    oas_cursor cur(data.data() + MAGIC_SIZE, data.size() - MAGIC_SIZE);
+    if (!parser.parse(cur))
+        throw std::runtime_error("OASIS file has no END record.");
+    return parser.get_cellviews(rmap, g);
+}
+
+} // namespace oasis
+} // namespace cbag
@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <tuple>
+
+#include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/gdsii/read_util.h>
+#include <cbag/gdsii/write_util.h>
+#include <cbag/layout/cellview.h>
+#include <cbag/layout/polygon.h>
+#include <cbag/layout/via_util.h>
+#include <cbag/oasis/io_util.h>
+#include <cbag/oasis/write.h>
+
+namespace cbag {
+namespace oasis {
+
+using gdsii::gds_layer_t;
+using box_map = std::map<gds_layer_t, std::vector<box_t>>;
+using poly_map = std::map<gds_layer_t, std::vector<std::vector<point>>>;
+
+// all properties are written with this name reference number
+constexpr uint64_t PROP_INST_NAME_REF = 0;
+
+/** Writes elements of one cell, omitting values that equal the OASIS modal variables.
+ *  Coordinates are written relative to the previous element of the same kind.
+ */
+class oas_cell_writer {
+  private:
+    std::string &buf;
+    std::optional<uint64_t> placement_cell;
+    std::optional<uint64_t> layer;
+    std::optional<uint64_t> datatype;
+    std::optional<uint64_t> textlayer;
+    std::optional<uint64_t> texttype;
+    std::optional<std::string> text_string;
+    std::optional<uint64_t> geometry_w;
+    std::optional<uint64_t> geometry_h;
+    std::vector<point> polygon_pt_list;
+    point placement_pt = {0, 0};
+    point text_pt = {0, 0};
+    point geometry_pt = {0, 0};
+
+  public:
+    explicit oas_cell_writer(std::string &buf) : buf(buf) {
+        write_byte(buf, static_cast<uint8_t>(record_type::XYRELATIVE));
+    }
+
+    void write_placement(uint64_t cell_ref, const transformation &xform,
+                         const oas_repetition &rep, const std::string &inst_name) {
+        auto[angle, bit_flag] = gdsii::get_angle_flag(orient(xform));
+        auto info = static_cast<uint8_t>(((angle / 90) << 1) | ((bit_flag != 0) ? 0x01 : 0x00));
+        info |= update(placement_cell, cell_ref, 0xc0);
+        auto[dx, dy] = update_xy(placement_pt, location(xform), info, 0x20, 0x10);
+        if (!rep.is_single())
+            info |= 0x08;
+
+        write_byte(buf, static_cast<uint8_t>(record_type::PLACEMENT));
+        write_byte(buf, info);
+        if ((info & 0x80) != 0)
+            write_uint(buf, cell_ref);
+        write_xy(info, 0x20, 0x10, dx, dy);
+        if ((info & 0x08) != 0)
+            write_repetition(buf, rep);
+
+        write_byte(buf, static_cast<uint8_t>(record_type::PROPERTY));
+        // one value, explicit name reference
+        write_byte(buf, 0x16);
+        write_uint(buf, PROP_INST_NAME_REF);
+        // a-string value
+        write_uint(buf, 10);
+        write_string(buf, inst_name);
+    }
+
+    void write_text(const gds_layer_t &key, const std::string &text, const point &loc) {
+        uint8_t info = 0;
+        if (!text_string || *text_string != text) {
+            text_string = text;
+            info |= 0x40;
+        }
+        info |= update(textlayer, key.first, 0x01);
+        info |= update(texttype, key.second, 0x02);
+        auto[dx, dy] = update_xy(text_pt, loc, info, 0x10, 0x08);
+
+        write_byte(buf, static_cast<uint8_t>(record_type::TEXT));
+        write_byte(buf, info);
+        if ((info & 0x40) != 0)
+            write_string(buf, text);
+        if ((info & 0x01) != 0)
+            write_uint(buf, key.first);
+        if ((info & 0x02) != 0)
+            write_uint(buf, key.second);
+        write_xy(info, 0x10, 0x08, dx, dy);
+    }
+
+    void write_rectangle(const gds_layer_t &key, offset_t w, offset_t h, const point &loc,
+                         const oas_repetition &rep) {
+        auto uw = static_cast<uint64_t>(w);
+        auto uh = static_cast<uint64_t>(h);
+        uint8_t info = update_layer(key);
+        if (w == h) {
+            info |= 0x80 | update(geometry_w, uw, 0x40);
+            geometry_h = uh;
+        } else {
+            info |= update(geometry_w, uw, 0x40) | update(geometry_h, uh, 0x20);
+        }
+        auto[dx, dy] = update_xy(geometry_pt, loc, info, 0x10, 0x08);
+        if (!rep.is_single())
+            info |= 0x04;
+
+        write_byte(buf, static_cast<uint8_t>(record_type::RECTANGLE));
+        write_byte(buf, info);
+        write_layer(info, key);
+        if ((info & 0x40) != 0)
+            write_uint(buf, uw);
+        if ((info & 0x20) != 0)
+            write_uint(buf, uh);
+        write_xy(info, 0x10, 0x08, dx, dy);
+        if ((info & 0x04) != 0)
+            write_repetition(buf, rep);
+    }
+
+    void write_polygon(const gds_layer_t &key, const std::vector<point> &pt_list) {
+        auto &p0 = pt_list[0];
+        std::vector<point> rel_list;
+        rel_list.reserve(pt_list.size());
+        for (const auto &pt : pt_list) {
+            rel_list.push_back({pt[0] - p0[0], pt[1] - p0[1]});
+        }
+
+        uint8_t info = update_layer(key);
+        if (rel_list != polygon_pt_list) {
+            polygon_pt_list = std::move(rel_list);
+            info |= 0x20;
+        }
+        auto[dx, dy] = update_xy(geometry_pt, p0, info, 0x10, 0x08);
+
+        write_byte(buf, static_cast<uint8_t>(record_type::POLYGON));
+        write_byte(buf, info);
+        write_layer(info, key);
+        if ((info & 0x20) != 0)
+            write_point_list(buf, polygon_pt_list);
+        write_xy(info, 0x10, 0x08, dx, dy);
+    }
+
+  private:
+    static uint8_t update(std::optional<uint64_t> &modal, uint64_t val, uint8_t bits) {
+        if (modal && *modal == val)
+            return 0;
+        modal = val;
+        return bits;
+    }
+
+    uint8_t update_layer(const gds_layer_t &key) {
+        return update(layer, key.first, 0x01) | update(datatype, key.second, 0x02);
+    }
+
+    static std::tuple<offset_t, offset_t> update_xy(point &modal, const point &pt, uint8_t &info,
+                                                    uint8_t x_bit, uint8_t y_bit) {
+        offset_t dx = pt[0] - modal[0];
+        offset_t dy = pt[1] - modal[1];
+        if (dx != 0)
+            info |= x_bit;
+        if (dy != 0)
+            info |= y_bit;
+        modal = pt;
+        return {dx, dy};
+    }
+
+    void write_layer(uint8_t info, const gds_layer_t &key) {
+        if ((info & 0x01) != 0)
+            write_uint(buf, key.first);
+        if ((info & 0x02) != 0)
+            write_uint(buf, key.second);
+    }
+
+    void write_xy(uint8_t info, uint8_t x_bit, uint8_t y_bit, offset_t dx, offset_t dy) {
+        if ((info & x_bit) != 0)
+            write_sint(buf, dx);
+        if ((info & y_bit) != 0)
+            write_sint(buf, dy);
+    }
+};
+
+/** Collects the polygons of a geometry, separating out rectangles.
+ */
+class shape_collector {
+  public:
+    using value_type = layout::polygon;
+
+  private:
+    std::vector<box_t> &box_list;
+    std::vector<std::vector<point>> &poly_list;
+    value_type last;
+
+  public:
+    shape_collector(std::vector<box_t> &box_list, std::vector<std::vector<point>> &poly_list)
+        : box_list(box_list), poly_list(poly_list) {}
+
+    void push_back(value_type &&v) {
+        record_last();
+        last = std::move(v);
+    }
+
+    void insert(value_type *ptr, const value_type &v) {
+        record_last();
+        last = v;
+    }
+
+    void record_last() const {
+        if (last.size() > 0) {
+            std::vector<point> pt_list;
+            pt_list.reserve(last.size());
+            for (const auto &pt : last) {
+                pt_list.push_back({pt.x(), pt.y()});
+            }
+            if (auto box = gdsii::get_rectangle(pt_list.data(), pt_list.size()))
+                box_list.push_back(*box);
+            else
+                poly_list.push_back(std::move(pt_list));
+        }
+    }
+
+    value_type &back() { return last; }
+
+    value_type *end() const { return nullptr; }
+};
+
+uint64_t get_cell_ref(cell_ref_map &ref_map, const std::string &cell_name) {
+    return ref_map.emplace(cell_name, ref_map.size()).first->second;
+}
+
+/** Writes the rectangles of one layer, combining rectangles of the same size on a regular pitch
+ *  into rows, and rows with the same columns on a regular pitch into arrays.
+ */
+void write_rectangles(oas_cell_writer &w, const gds_layer_t &key,
+                      const std::vector<box_t> &box_list) {
+    std::map<std::pair<offset_t, offset_t>, std::vector<point>> size_map;
+    for (const auto &box : box_list) {
+        size_map[{width(box), height(box)}].push_back({xl(box), yl(box)});
+    }
+
+    for (auto & [ dim, pt_list ] : size_map) {
+        gdsii::for_each_array(std::move(pt_list), std::numeric_limits<std::size_t>::max(),
+                              [&w, &key, &dim = dim](const point &origin, cnt_t nx, cnt_t ny,
+                                                     offset_t spx, offset_t spy) {
+                                  oas_repetition rep;
+                                  rep.nx = nx;
+                                  rep.ny = ny;
+                                  rep.spx = spx;
+                                  rep.spy = spy;
+                                  w.write_rectangle(key, dim.first, dim.second, origin, rep);
+                              });
+    }
+}
+
+std::vector<point> get_points(const layout::polygon &poly) {
+    std::vector<point> ans;
+    ans.reserve(poly.size());
+    for (const auto &pt : poly) {
+        ans.push_back({pt.x(), pt.y()});
+    }
+    if (ans.size() > 1 && ans.front() == ans.back())
+        ans.pop_back();
+    return ans;
+}
+
+void add_via(spdlog::logger &logger, box_map &rect_map, const layout::tech &tech,
+             const gdsii::gds_lookup &lookup, const layout::via &v) {
+    auto[lay1_key, cut_key, lay2_key] = tech.get_via_layer_purpose(v.get_via_id());
+    for (const auto &key : {lay1_key, cut_key, lay2_key}) {
+        if (!lookup.get_gds_layer(key)) {
+            logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping via.",
+                        key.first, key.second);
+            return;
+        }
+    }
+    rect_map[*lookup.get_gds_layer(lay1_key)].push_back(layout::get_bot_box(v));
+    rect_map[*lookup.get_gds_layer(lay2_key)].push_back(layout::get_top_box(v));
+    get_via_cuts(v, std::back_inserter(rect_map[*lookup.get_gds_layer(cut_key)]));
+}
+
+void write_oas_start(std::ostream &stream, double resolution, double user_unit) {
+    std::string buf(MAGIC, MAGIC_SIZE);
+    write_byte(buf, static_cast<uint8_t>(record_type::START));
+    write_string(buf, VERSION);
+    // grid steps per micron, rounded to an integer when it is one up to floating point error
+    auto unit = 1e-6 / (resolution * user_unit);
+    auto unit_int = std::round(unit);
+    write_real(buf, (std::abs(unit - unit_int) < 1e-9 * unit) ? unit_int : unit);
+    // table offsets are in START, and are all zero as there are no strict tables
+    write_uint(buf, 0);
+    for (int idx = 0; idx < 12; ++idx) {
+        write_uint(buf, 0);
+    }
+    stream.write(buf.data(), buf.size());
+}
+
+void write_oas_stop(std::ostream &stream, const cell_ref_map &ref_map) {
+    std::vector<const std::string *> name_list(ref_map.size(), nullptr);
+    for (const auto & [ name, ref ] : ref_map) {
+        name_list[ref] = &name;
+    }
+
+    std::string buf;
+    for (std::size_t ref = 0; ref < name_list.size(); ++ref) {
+        write_byte(buf, static_cast<uint8_t>(record_type::CELLNAME));
+        write_string(buf, *name_list[ref]);
+        write_uint(buf, ref);
+    }
+    write_byte(buf, static_cast<uint8_t>(record_type::PROPNAME));
+    write_string(buf, PROP_INST_NAME);
+    write_uint(buf, PROP_INST_NAME_REF);
+
+    // the END record is padded to a fixed size, and has no validation
+    write_byte(buf, static_cast<uint8_t>(record_type::END));
+    std::string padding(END_SIZE - 4, '\0');
+    write_string(buf, padding);
+    write_uint(buf, 0);
+    stream.write(buf.data(), buf.size());
+}
+
+void write_lay_cellview(spdlog::logger &logger, std::ostream &stream, const std::string &cell_name,
+                        const layout::cellview &cv,
+                        const std::unordered_map<std::string, std::string> &rename_map,
+                        cell_ref_map &ref_map, const gdsii::gds_lookup &lookup, bool compress) {
+    auto start_time = std::chrono::steady_clock::now();
+    std::string buf;
+    write_byte(buf, static_cast<uint8_t>(record_type::CELL_REF));
+    write_uint(buf, get_cell_ref(ref_map, cell_name));
+    oas_cell_writer w(buf);
+
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout instances.");
+    for (auto iter = cv.begin_inst(); iter != cv.end_inst(); ++iter) {
+        auto &[inst_name, inst] = *iter;
+        oas_repetition rep;
+        rep.nx = inst.nx;
+        rep.ny = inst.ny;
+        rep.spx = inst.spx;
+        rep.spy = inst.spy;
+        w.write_placement(get_cell_ref(ref_map, inst.get_cell_name(&rename_map)), inst.xform, rep,
+                          inst_name);
+    }
+
+    box_map rect_map;
+    poly_map polygon_map;
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout geometries.");
+    for (auto iter = cv.begin_geometry(); iter != cv.end_geometry(); ++iter) {
+        auto &[layer_key, geo] = *iter;
+        auto gkey = lookup.get_gds_layer(layer_key);
+        if (!gkey) {
+            logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping geometry.",
+                        layer_key.first, layer_key.second);
+        } else {
+            shape_collector c(rect_map[*gkey], polygon_map[*gkey]);
+            geo.write_geometry(c);
+            c.record_last();
+        }
+    }
+
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout vias.");
+    auto tech_ptr = cv.get_tech();
+    for (auto iter = cv.begin_via(); iter != cv.end_via(); ++iter) {
+        add_via(logger, rect_map, *tech_ptr, lookup, *iter);
+    }
+
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout pins.");
+    auto purp = tech_ptr->get_pin_purpose();
+    auto make_pin_obj = tech_ptr->get_make_pin();
+    for (auto iter = cv.begin_pin(); iter != cv.end_pin(); ++iter) {
+        auto &[lay, pin_list] = *iter;
+        auto gkey = lookup.get_gds_layer(std::make_pair(lay, purp));
+        if (!gkey) {
+            logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping pins.", lay,
+                        purp);
+            continue;
+        }
+        for (const auto &pin : pin_list) {
+            if (!is_physical(pin)) {
+                logger.warn("non-physical bbox {} on pin layer ({}, {}), skipping.",
+                            to_string(pin), lay, purp);
+                continue;
+            }
+            w.write_text(*gkey, pin.get_label(), point{xm(pin), ym(pin)});
+            if (make_pin_obj)
+                rect_map[*gkey].push_back(pin);
+        }
+    }
+
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout labels.");
+    for (auto iter = cv.begin_label(); iter != cv.end_label(); ++iter) {
+        auto gkey = lookup.get_gds_layer(iter->get_key());
+        if (!gkey) {
+            logger.warn("Cannot find layer/purpose ({}, {}) in layer map.  Skipping label.",
+                        iter->get_key().first, iter->get_key().second);
+        } else {
+            w.write_text(*gkey, iter->get_text(), location(iter->get_xform()));
+        }
+    }
+
+    SPDLOG_LOGGER_TRACE(&logger, "Export layout boundaries.");
+    for (auto iter = cv.begin_boundary(); iter != cv.end_boundary(); ++iter) {
+        auto btype = iter->get_type();
+        auto gkey = lookup.get_gds_layer(btype);
+        if (!gkey) {
+            logger.warn("Cannot find boundary type {} in object map.  Skipping boundary.", btype);
+        } else {
+            polygon_map[*gkey].push_back(get_points(*iter));
+        }
+    }
+
+    for (const auto & [ gkey, box_list ] : rect_map) {
+        write_rectangles(w, gkey, box_list);
+    }
+    for (const auto & [ gkey, poly_list ] : polygon_map) {
+        for (const auto &pt_list : poly_list) {
+            if (pt_list.size() > 2)
+                w.write_polygon(gkey, pt_list);
+        }
+    }
+
+    auto num_bytes = buf.size();
+    if (compress) {
+        std::string block;
+        write_cblock(block, buf);
+        buf = std::move(block);
+    }
+    stream.write(buf.data(), buf.size());
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start_time;
+    logger.info("Wrote OASIS cellview {}: {} instances, {} layers, {} vias, {} bytes ({} "
+                "uncompressed) in {:.3f} s.",
+                cell_name, std::distance(cv.begin_inst(), cv.end_inst()),
+                std::distance(cv.begin_geometry(), cv.end_geometry()),
+                std::distance(cv.begin_via(), cv.end_via()), buf.size(), num_bytes,
+                diff.count());
+}
+
+} // namespace oasis
+} // namespace cbag
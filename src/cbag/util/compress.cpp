@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#ifdef CBAG_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cbag/util/compress.h>
+#include <cbag/util/io.h>
+
+namespace cbag {
+namespace util {
+
+// size of decompressed chunks and of compressed file reads
+constexpr std::size_t chunk_size = 1 << 20;
+// number of decompressed chunks buffered ahead of the parser
+constexpr std::size_t max_queue = 4;
+// space reserved before each chunk, so the end of the previous chunk can be kept for seeking back
+constexpr std::size_t max_putback = 16;
+
+using chunk_fun = std::function<bool(std::vector<char> &&)>;
+
+bool ends_with(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+compress_type get_compress_type(const std::string &fname, compress_type type) {
+    if (type != compress_type::AUTO)
+        return type;
+    if (ends_with(fname, ".gz"))
+        return compress_type::GZIP;
+    if (ends_with(fname, ".zst"))
+        return compress_type::ZSTD;
+    return compress_type::NONE;
+}
+
+std::vector<char> make_chunk() { return std::vector<char>(max_putback + chunk_size); }
+
+// reads from file into in_buf, returns the number of bytes read
+std::size_t read_input(std::istream &file, std::vector<char> &in_buf) {
+    file.read(in_buf.data(), static_cast<std::streamsize>(in_buf.size()));
+    if (file.bad())
+        throw std::runtime_error("Error reading compressed file.");
+    return static_cast<std::size_t>(file.gcount());
+}
+
+void decode_gzip(std::istream &file, const chunk_fun &push) {
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    // 32 enables gzip and zlib header detection
+    if (inflateInit2(&strm, 15 + 32) != Z_OK)
+        throw std::runtime_error("Cannot initialize gzip decompression.");
+    std::unique_ptr<z_stream, int (*)(z_stream *)> guard(&strm, inflateEnd);
+
+    std::vector<char> in_buf(chunk_size);
+    auto chunk = make_chunk();
+    strm.next_out = reinterpret_cast<Bytef *>(chunk.data() + max_putback);
+    strm.avail_out = chunk_size;
+    bool stream_end = false;
+    while (true) {
+        if (strm.avail_in == 0) {
+            auto num = read_input(file, in_buf);
+            if (num == 0)
+                break;
+            strm.next_in = reinterpret_cast<Bytef *>(in_buf.data());
+            strm.avail_in = static_cast<uInt>(num);
+        }
+        if (stream_end) {
+            // concatenated gzip members
+            inflateReset(&strm);
+            stream_end = false;
+        }
+        auto ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            stream_end = true;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            throw std::runtime_error(std::string("Corrupt gzip data: ") +
+                                     (strm.msg ? strm.msg : "unknown error"));
+        }
+        if (strm.avail_out == 0) {
+            if (!push(std::move(chunk)))
+                return;
+            chunk = make_chunk();
+            strm.next_out = reinterpret_cast<Bytef *>(chunk.data() + max_putback);
+            strm.avail_out = chunk_size;
+        }
+    }
+    if (!stream_end)
+        throw std::runtime_error("Truncated gzip data.");
+    chunk.resize(max_putback + chunk_size - strm.avail_out);
+    if (chunk.size() > max_putback)
+        push(std::move(chunk));
+}
+
+#ifdef CBAG_HAS_ZSTD
+void decode_zstd(std::istream &file, const chunk_fun &push) {
+    std::unique_ptr<ZSTD_DStream, std::size_t (*)(ZSTD_DStream *)> strm(ZSTD_createDStream(),
+                                                                         ZSTD_freeDStream);
+    if (!strm)
+        throw std::runtime_error("Cannot initialize zstd decompression.");
+    ZSTD_initDStream(strm.get());
+
+    std::vector<char> in_buf(chunk_size);
+    ZSTD_inBuffer input{in_buf.data(), 0, 0};
+    auto chunk = make_chunk();
+    ZSTD_outBuffer output{chunk.data() + max_putback, chunk_size, 0};
+    bool eof = false;
+    // nonzero while a frame is incomplete or the decoder holds buffered output
+    std::size_t ret = 1;
+    bool has_output = false;
+    while (true) {
+        if (input.pos == input.size && !eof) {
+            input.size = read_input(file, in_buf);
+            input.pos = 0;
+            eof = (input.size == 0);
+        }
+        if (eof && !has_output)
+            break;
+        ret = ZSTD_decompressStream(strm.get(), &output, &input);
+        if (ZSTD_isError(ret))
+            throw std::runtime_error(std::string("Corrupt zstd data: ") + ZSTD_getErrorName(ret));
+        // a full output buffer may leave data inside the decoder
+        has_output = (output.pos == output.size && ret != 0);
+        if (output.pos == output.size) {
+            if (!push(std::move(chunk)))
+                return;
+            chunk = make_chunk();
+            output = {chunk.data() + max_putback, chunk_size, 0};
+        }
+    }
+    if (ret != 0)
+        throw std::runtime_error("Truncated zstd data.");
+    chunk.resize(max_putback + output.pos);
+    if (output.pos > 0)
+        push(std::move(chunk));
+}
+#endif
+
+decompress_buf::decompress_buf(const std::string &fname, compress_type type)
+    : file(open_file_read(fname, true)) {
+#ifndef CBAG_HAS_ZSTD
+    if (type == compress_type::ZSTD)
+        throw std::invalid_argument("cbag is built without zstd support.");
+#endif
+    if (type != compress_type::GZIP && type != compress_type::ZSTD)
+        throw std::invalid_argument("decompress_buf requires gzip or zstd compression.");
+    worker = std::thread(&decompress_buf::run, this, type);
+}
+
+decompress_buf::~decompress_buf() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+    }
+    cond.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+void decompress_buf::run(compress_type type) {
+    try {
+        auto fun = [this](std::vector<char> &&chunk) { return push(std::move(chunk)); };
+#ifdef CBAG_HAS_ZSTD
+        if (type == compress_type::ZSTD)
+            decode_zstd(file, fun);
+        else
+#endif
+            decode_gzip(file, fun);
+    } catch (...) {
+        std::lock_guard<std::mutex> guard(lock);
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+    }
+    cond.notify_all();
+}
+
+bool decompress_buf::push(std::vector<char> &&chunk) {
+    std::unique_lock<std::mutex> guard(lock);
+    cond.wait(guard, [this]() { return stop || queue.size() < max_queue; });
+    if (stop)
+        return false;
+    queue.push_back(std::move(chunk));
+    guard.unlock();
+    cond.notify_all();
+    return true;
+}
+
+decompress_buf::int_type decompress_buf::underflow() {
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    std::vector<char> next;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        cond.wait(guard, [this]() { return done || !queue.empty(); });
+        if (queue.empty()) {
+            if (error)
+                std::rethrow_exception(error);
+            return traits_type::eof();
+        }
+        next = std::move(queue.front());
+        queue.pop_front();
+    }
+    cond.notify_all();
+
+    // keep the end of the current chunk in front of the next one
+    auto cur_size = static_cast<std::size_t>(egptr() - eback());
+    auto keep = std::min(max_putback, cur_size);
+    std::copy(egptr() - keep, egptr(), next.data() + max_putback - keep);
+    base_pos += cur_size - keep;
+    cur = std::move(next);
+    setg(cur.data() + max_putback - keep, cur.data() + max_putback, cur.data() + cur.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+decompress_buf::pos_type decompress_buf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                 std::ios_base::openmode which) {
+    auto fail = pos_type(off_type(-1));
+    if ((which & std::ios_base::in) == 0 || dir == std::ios_base::end)
+        return fail;
+    auto lo = static_cast<off_type>(base_pos);
+    auto target = (dir == std::ios_base::beg) ? off : lo + (gptr() - eback()) + off;
+    if (target < lo || target > lo + (egptr() - eback()))
+        return fail;
+    setg(eback(), eback() + (target - lo), egptr());
+    return pos_type(target);
+}
+
+decompress_buf::pos_type decompress_buf::seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+class encoder {
+  public:
+    virtual ~encoder() = default;
+
+    // compresses the data and appends the output, finishing the stream if last is true
+    virtual void encode(const char *data, std::size_t size, bool last, std::string &out) = 0;
+};
+
+class gzip_encoder : public encoder {
+  private:
+    z_stream strm;
+    std::vector<char> buf;
+
+  public:
+    gzip_encoder() : buf(chunk_size) {
+        std::memset(&strm, 0, sizeof(strm));
+        // 16 writes a gzip header instead of a zlib header
+        if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("Cannot initialize gzip compression.");
+    }
+
+    ~gzip_encoder() override { deflateEnd(&strm); }
+
+    void encode(const char *data, std::size_t size, bool last, std::string &out) override {
+        strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        strm.avail_in = static_cast<uInt>(size);
+        do {
+            strm.next_out = reinterpret_cast<Bytef *>(buf.data());
+            strm.avail_out = static_cast<uInt>(buf.size());
+            if (deflate(&strm, last ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR)
+                throw std::runtime_error("gzip compression failed.");
+            out.append(buf.data(), buf.size() - strm.avail_out);
+        } while (strm.avail_out == 0);
+    }
+};
+
+#ifdef CBAG_HAS_ZSTD
+class zstd_encoder : public encoder {
+  private:
+    std::unique_ptr<ZSTD_CCtx, std::size_t (*)(ZSTD_CCtx *)> ctx;
+    std::vector<char> buf;
+
+  public:
+    zstd_encoder() : ctx(ZSTD_createCCtx(), ZSTD_freeCCtx), buf(ZSTD_CStreamOutSize()) {
+        if (!ctx)
+            throw std::runtime_error("Cannot initialize zstd compression.");
+    }
+
+    void encode(const char *data, std::size_t size, bool last, std::string &out) override {
+        ZSTD_inBuffer input{data, size, 0};
+        while (true) {
+            ZSTD_outBuffer output{buf.data(), buf.size(), 0};
+            auto ret = ZSTD_compressStream2(ctx.get(), &output, &input,
+                                            last ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(ret))
+                throw std::runtime_error(std::string("zstd compression failed: ") +
+                                         ZSTD_getErrorName(ret));
+            out.append(buf.data(), output.pos);
+            if (last ? (ret == 0) : (input.pos == input.size))
+                return;
+        }
+    }
+};
+#endif
+
+std::unique_ptr<encoder> make_encoder(compress_type type) {
+    switch (type) {
+    case compress_type::GZIP:
+        return std::make_unique<gzip_encoder>();
+    case compress_type::ZSTD:
+#ifdef CBAG_HAS_ZSTD
+        return std::make_unique<zstd_encoder>();
+#else
+        throw std::invalid_argument("cbag is built without zstd support.");
+#endif
+    default:
+        throw std::invalid_argument("compress_buf requires gzip or zstd compression.");
+    }
+}
+
+compress_buf::compress_buf(const std::string &fname, compress_type type)
+    : file(open_file_write(fname, true)), enc(make_encoder(type)), in_buf(chunk_size) {
+    setp(in_buf.data(), in_buf.data() + in_buf.size());
+}
+
+compress_buf::~compress_buf() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void compress_buf::write_out(bool last) {
+    enc->encode(pbase(), static_cast<std::size_t>(pptr() - pbase()), last, out_buf);
+    setp(in_buf.data(), in_buf.data() + in_buf.size());
+    file.write(out_buf.data(), static_cast<std::streamsize>(out_buf.size()));
+    out_buf.clear();
+    if (file.fail())
+        throw std::runtime_error("Error writing compressed file.");
+}
+
+compress_buf::int_type compress_buf::overflow(int_type c) {
+    if (closed)
+        return traits_type::eof();
+    write_out(false);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int compress_buf::sync() {
+    if (!closed)
+        write_out(false);
+    return 0;
+}
+
+void compress_buf::close() {
+    if (!closed) {
+        closed = true;
+        write_out(true);
+        file.close();
+    }
+}
+
+decompress_istream::decompress_istream(const std::string &fname, compress_type type)
+    : std::istream(nullptr), buf(fname, type) {
+    rdbuf(&buf);
+    exceptions(std::ios_base::badbit);
+}
+
+compress_ostream::compress_ostream(const std::string &fname, compress_type type)
+    : std::ostream(nullptr), buf(fname, type) {
+    rdbuf(&buf);
+    exceptions(std::ios_base::badbit);
+}
+
+void compress_ostream::close() {
+    flush();
+    buf.close();
+}
+
+} // namespace util
+} // namespace cbag
@@ -55,5 +55,22 @@ std::filesystem::path join(const std::string &first, const std::string &second)
     return ans;
 }
 
+block_ostream::block_ostream(const std::string &fname, std::size_t block_size)
+    : std::ostream(nullptr), block(block_size) {
+    make_parent_dirs(fname);
+    // the buffer must be set before the file is opened
+    buf.pubsetbuf(block.data(), static_cast<std::streamsize>(block.size()));
+    if (!buf.open(fname, std::ios_base::out | std::ios_base::binary))
+        throw std::runtime_error("Error writing " + fname + ": " + std::strerror(errno));
+    rdbuf(&buf);
+    imbue(std::locale::classic());
+    exceptions(std::ios_base::badbit);
+}
+
+void block_ostream::close() {
+    if (!buf.close())
+        throw std::runtime_error("Error closing file.");
+}
+
 } // namespace util
 } // namespace cbag
@@ -0,0 +1,67 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cbag/util/io.h>
+#include <cbag/util/mmap_file.h>
+
+namespace cbag {
+namespace util {
+
+mmap_file::mmap_file(const std::string &fname) {
+    if (!is_file(fname))
+        throw std::invalid_argument(fname + " is not a file.");
+    auto fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Error reading " + fname + ": " + std::strerror(errno));
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        auto err = errno;
+        ::close(fd);
+        throw std::runtime_error("Error reading " + fname + ": " + std::strerror(err));
+    }
+    num_bytes = static_cast<std::size_t>(info.st_size);
+    if (num_bytes > 0) {
+        auto addr = ::mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            auto err = errno;
+            ::close(fd);
+            throw std::runtime_error("Error mapping " + fname + ": " + std::strerror(err));
+        }
+        // records are parsed front to back
+        ::madvise(addr, num_bytes, MADV_SEQUENTIAL);
+        ptr = static_cast<const char *>(addr);
+    }
+    // the mapping stays valid after the file is closed
+    ::close(fd);
+}
+
+mmap_file::mmap_file(mmap_file &&other) noexcept
+    : ptr(std::exchange(other.ptr, nullptr)), num_bytes(std::exchange(other.num_bytes, 0)) {}
+
+mmap_file &mmap_file::operator=(mmap_file &&other) noexcept {
+    if (this != &other) {
+        std::swap(ptr, other.ptr);
+        std::swap(num_bytes, other.num_bytes);
+    }
+    return *this;
+}
+
+mmap_file::~mmap_file() {
+    if (ptr != nullptr)
+        ::munmap(const_cast<char *>(ptr), num_bytes);
+}
+
+const char *mmap_file::data() const noexcept { return ptr; }
+
+std::size_t mmap_file::size() const noexcept { return num_bytes; }
+
+} // namespace util
+} // namespace cbag
@@ -0,0 +1,62 @@
+#include <utility>
+
+#include <cbag/util/parallel.h>
+
+namespace cbag {
+namespace util {
+
+thread_pool::thread_pool(std::size_t num_threads) { reserve(num_threads); }
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cond.notify_all();
+    for (auto &t : workers) {
+        t.join();
+    }
+}
+
+std::size_t thread_pool::size() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return workers.size();
+}
+
+void thread_pool::reserve(std::size_t num_threads) {
+    std::lock_guard<std::mutex> guard(lock);
+    while (workers.size() < num_threads) {
+        workers.emplace_back([this]() { run(); });
+    }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(std::move(task));
+    }
+    cond.notify_one();
+}
+
+void thread_pool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cond.wait(guard, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+thread_pool &thread_pool::get_default() {
+    static thread_pool pool;
+    return pool;
+}
+
+} // namespace util
+} // namespace cbag
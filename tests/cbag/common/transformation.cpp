@@ -15,3 +15,19 @@ TEST_CASE("transformation concatenation", "[transformation]") {
     auto ans = cbag::get_transform_by(xform1, xform2);
     REQUIRE(ans == expect);
 }
+
+TEST_CASE("array conversion ignores translation", "[transformation]") {
+    using arr_type = std::tuple<cbag::cnt_t, cbag::cnt_t, cbag::offset_t, cbag::offset_t>;
+    using data_type = std::tuple<cbag::transformation, arr_type>;
+    auto [xform, expect] = GENERATE(values<data_type>({
+        {cbag::make_xform(), arr_type{3, 2, 10, 20}},
+        {cbag::make_xform(100, 200), arr_type{3, 2, 10, 20}},
+        {cbag::make_xform(-100, 50, cbag::oMX), arr_type{3, 2, 10, -20}},
+        {cbag::make_xform(100, 200, cbag::oR90), arr_type{2, 3, 20, -10}},
+    }));
+
+    auto ans = cbag::convert_array(xform, 3, 2, 10, 20);
+    REQUIRE(ans == expect);
+    auto [nx, ny, spx, spy] = ans;
+    REQUIRE(cbag::convert_gds_array(xform, nx, ny, spx, spy) == arr_type{3, 2, 10, 20});
+}
@@ -48,9 +48,57 @@ TEST_CASE("Read/write transformation objects", "[gds]") {
     }));
 
     auto logger = get_catch_logger();
-    std::stringstream stream;
+    cbag::gdsii::gds_buffer buf;
 
-    cbag::gdsii::write_transform(*logger, stream, xform);
+    cbag::gdsii::write_transform(*logger, buf, xform);
+    std::stringstream stream(std::string(buf.data(), buf.size()));
     auto ans = cbag::gdsii::read_transform(*logger, stream);
     REQUIRE(ans == xform);
 }
+
+TEST_CASE("Read transformation objects from memory", "[gds]") {
+    auto xform = GENERATE(values<cbag::transformation>({
+        cbag::make_xform(0, 0, cbag::oR0),
+        cbag::make_xform(5, 10, cbag::oR90),
+        cbag::make_xform(-100, -100, cbag::oMX),
+        cbag::make_xform(-20, 15, cbag::oMYR90),
+    }));
+
+    auto logger = get_catch_logger();
+    cbag::gdsii::gds_buffer buf;
+
+    cbag::gdsii::write_transform(*logger, buf, xform);
+    cbag::gdsii::gds_cursor cursor(buf.data(), buf.size());
+    auto ans = cbag::gdsii::read_transform(*logger, cursor);
+    REQUIRE(ans == xform);
+    REQUIRE(cursor.remaining() == 0);
+    REQUIRE_THROWS_AS(cbag::gdsii::read_bytes<uint16_t>(cursor), std::runtime_error);
+}
+
+TEST_CASE("Absolute GDS magnification and rotation are counted", "[gds]") {
+    auto xform = cbag::make_xform(5, 10, cbag::oR90);
+    auto logger = get_catch_logger();
+    cbag::gdsii::gds_buffer buf;
+
+    cbag::gdsii::write_transform(*logger, buf, xform);
+    // set the absolute magnification and rotation bits of the STRANS record
+    auto data = std::string(buf.data(), buf.size());
+    data[5] |= 0x06;
+    std::size_t num_absolute = 0;
+    for (std::size_t idx = 0; idx < 2; ++idx) {
+        cbag::gdsii::gds_cursor cursor(data.data(), data.size());
+        auto [ans, mag] = cbag::gdsii::read_transform_mag(*logger, cursor, num_absolute);
+        REQUIRE(ans == xform);
+        REQUIRE(mag == 1.0);
+    }
+    REQUIRE(num_absolute == 2);
+}
+
+TEST_CASE("Records that are too long are not written", "[gds]") {
+    auto logger = get_catch_logger();
+    cbag::gdsii::gds_buffer buf;
+
+    REQUIRE_THROWS_AS(cbag::gdsii::write_struct_name(*logger, buf, std::string(70000, 'a')),
+                      std::runtime_error);
+    REQUIRE(buf.size() == 0);
+}
@@ -0,0 +1,702 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <cbag/common/box_t.h>
+#include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/enum/direction.h>
+#include <cbag/gdsii/library.h>
+#include <cbag/gdsii/read.h>
+#include <cbag/gdsii/scan.h>
+#include <cbag/gdsii/write.h>
+#include <cbag/gdsii/write_util.h>
+#include <cbag/layout/boundary.h>
+#include <cbag/layout/cellview.h>
+#include <cbag/layout/cellview_poly.h>
+#include <cbag/layout/cellview_util.h>
+#include <cbag/layout/instance.h>
+#include <cbag/layout/routing_grid.h>
+#include <cbag/layout/tech_util.h>
+#include <cbag/util/io.h>
+
+#include "util/layout.h"
+
+using c_cellview = cbag::layout::cellview;
+
+std::string write_test_gds(const std::shared_ptr<const cbag::layout::routing_grid> &grid,
+                           std::string fname = "tests/data/test_outputs/gds/read_test.gds") {
+    auto &tech_info = *grid->get_tech();
+    auto cv_list = make_test_cellviews(grid);
+    cbag::util::make_parent_dirs(fname);
+    cbag::gdsii::implement_gds(fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info.get_resolution(), 1e-6, cv_list);
+    return fname;
+}
+
+TEST_CASE("Memory mapped and stream GDS readers agree", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto fname = write_test_gds(grid);
+
+    std::vector<std::shared_ptr<c_cellview>> mmap_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid, std::back_inserter(mmap_list));
+
+    std::vector<std::shared_ptr<c_cellview>> stream_list;
+    auto logger = cbag::get_cbag_logger();
+    auto stream = cbag::util::open_file_read(fname, true);
+    cbag::gdsii::gds_rlookup rmap(test_layer_map, test_obj_map, *tech_info);
+    cbag::gdsii::read_gds(*logger, stream, rmap, grid, std::back_inserter(stream_list));
+
+    REQUIRE(mmap_list.size() == 9);
+    REQUIRE(stream_list.size() == mmap_list.size());
+    for (std::size_t idx = 0; idx < mmap_list.size(); ++idx) {
+        REQUIRE(*mmap_list[idx] == *stream_list[idx]);
+    }
+    auto &top = *mmap_list.back();
+    REQUIRE(std::distance(top.begin_inst(), top.end_inst()) == 9);
+}
+
+TEST_CASE("Parallel GDS reading matches serial reading", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto fname = write_test_gds(grid);
+
+    std::vector<std::shared_ptr<c_cellview>> serial_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(serial_list));
+    std::vector<std::shared_ptr<c_cellview>> par_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid, std::back_inserter(par_list),
+                          4);
+
+    REQUIRE(par_list.size() == serial_list.size());
+    for (std::size_t idx = 0; idx < par_list.size(); ++idx) {
+        REQUIRE(par_list[idx]->get_name() == serial_list[idx]->get_name());
+        REQUIRE(*par_list[idx] == *serial_list[idx]);
+    }
+}
+
+TEST_CASE("Parallel GDS writing matches serial writing", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto num_threads = GENERATE(static_cast<std::size_t>(1), static_cast<std::size_t>(4));
+    auto cv_list = make_test_cellviews(grid);
+    // renamed leaves, and a copy after the top cell that the top cell must not see
+    for (std::size_t idx = 0; idx + 1 < cv_list.size(); ++idx) {
+        cv_list[idx].first = "R_" + cv_list[idx].first;
+    }
+    cv_list.emplace_back("LATE", cv_list[0].second);
+
+    auto logger = cbag::get_cbag_logger();
+    auto time_vec = cbag::gdsii::get_gds_time();
+    cbag::gdsii::gds_lookup lookup(*tech_info, test_layer_map, test_obj_map);
+    std::ostringstream expect;
+    std::unordered_map<std::string, std::string> rename_map;
+    std::vector<std::pair<std::string, const c_cellview *>> cell_list;
+    for (const auto &[cell_name, cv_ptr] : cv_list) {
+        cbag::gdsii::write_lay_cellview(*logger, expect, cell_name, *cv_ptr, rename_map, time_vec,
+                                        lookup);
+        rename_map[cv_ptr->get_name()] = cell_name;
+        cell_list.emplace_back(cell_name, cv_ptr.get());
+    }
+
+    std::ostringstream ans;
+    cbag::gdsii::write_lay_cellviews(*logger, ans, cell_list, time_vec, lookup, num_threads);
+    REQUIRE(ans.str() == expect.str());
+}
+
+TEST_CASE("Small Manhattan polygons are written as rectangles", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+
+    auto cv = std::make_shared<c_cellview>(grid, "RECT");
+    std::vector<cbag::point> stairs = {{0, 0},     {500, 0},   {500, 100}, {400, 100},
+                                       {400, 200}, {300, 200}, {300, 300}, {200, 300},
+                                       {200, 400}, {100, 400}, {100, 500}, {0, 500}};
+    std::vector<cbag::point> l_shape = {{1000, 0},   {1300, 0},   {1300, 100},
+                                        {1100, 100}, {1100, 300}, {1000, 300}};
+    for (const auto &pt_list : {stairs, l_shape}) {
+        cbag::layout::polygon90 poly;
+        poly.set(pt_list.begin(), pt_list.end());
+        cv->add_shape(key, poly);
+    }
+    cv->add_shape(key, cbag::box_t(2000, 0, 2100, 50));
+    std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>> cv_list = {
+        {"RECT", cv}};
+
+    std::string fname = "tests/data/test_outputs/gds/rect_test.gds";
+    cbag::gdsii::gds_write_options opts;
+    opts.rect_vertices = 8;
+    cbag::gdsii::implement_gds(fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list, opts);
+
+    auto info_list = cbag::gdsii::scan_gds(fname);
+    REQUIRE(info_list.size() == 1);
+    REQUIRE(info_list[0].stats.num_boundary == 1);
+    REQUIRE(info_list[0].stats.num_box == 3);
+    REQUIRE(info_list[0].bbox == cbag::box_t(0, 0, 2100, 500));
+}
+
+TEST_CASE("Repeated vias and rectangles are written as arrays", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto via_id = tech_info->get_via_id(cbag::direction::LOWER, key,
+                                        cbag::layout::layer_t_at(*tech_info, "M2", "drawing"));
+    cbag::layout::via_param params(2, 2, 32, 32, 40, 40, 14, 14, 14, 14, 14, 14, 14, 14);
+
+    auto cv = std::make_shared<c_cellview>(grid, "ARR");
+    cbag::layout::add_rect_arr(*cv, key, cbag::box_t(0, 0, 20, 100), {10, 1}, {40, 0});
+    cbag::layout::add_via_arr(*cv, cbag::make_xform(0, 1000), via_id, params, false, {4, 3},
+                              {400, 300});
+    cbag::layout::add_via_arr(*cv, cbag::make_xform(5000, 5000), via_id, params, false, {1, 1},
+                              {0, 0});
+    std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>> cv_list = {
+        {"ARR", cv}};
+
+    std::string flat_fname = "tests/data/test_outputs/gds/arr_flat.gds";
+    std::string fname = "tests/data/test_outputs/gds/arr_test.gds";
+    cbag::gdsii::implement_gds(flat_fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list);
+    cbag::gdsii::gds_write_options opts;
+    opts.min_array_size = 4;
+    cbag::gdsii::implement_gds(fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list, opts);
+
+    // the single via is written as boxes, with its cuts arrayed
+    auto flat_info = cbag::gdsii::scan_gds(flat_fname).back();
+    auto info_list = cbag::gdsii::scan_gds(fname);
+    auto &top = info_list.back();
+    REQUIRE(top.name == "ARR");
+    REQUIRE(info_list.size() == 4);
+    REQUIRE(top.stats.num_inst == 3);
+    REQUIRE(top.stats.num_box == 2);
+    REQUIRE(top.ref_cnt.at("ARR$via0") == 12);
+    REQUIRE(top.num_flat == flat_info.num_flat);
+    REQUIRE(top.bbox == flat_info.bbox);
+    REQUIRE(top.bbox == cbag::box_t(-66, 0, 5066, 5066));
+
+    std::vector<std::shared_ptr<c_cellview>> read_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid, std::back_inserter(read_list));
+    auto &arr = *read_list.back();
+    auto num_via_arr = 0;
+    for (auto iter = arr.begin_inst(); iter != arr.end_inst(); ++iter) {
+        auto &inst = iter->second;
+        if (inst.get_cell_name(nullptr) == "ARR$via0") {
+            ++num_via_arr;
+            REQUIRE(cbag::location(inst.xform) == std::array<cbag::coord_t, 2>{0, 1000});
+            REQUIRE(inst.nx == 4);
+            REQUIRE(inst.ny == 3);
+            REQUIRE(inst.spx == 400);
+            REQUIRE(inst.spy == 300);
+        }
+    }
+    REQUIRE(num_via_arr == 1);
+}
+
+TEST_CASE("Cellviews with the same content are written once", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto num_threads = GENERATE(static_cast<std::size_t>(1), static_cast<std::size_t>(4));
+
+    // the same shapes, added in a different order
+    auto make_leaf = [&grid, &key](const std::string &name, bool reverse) {
+        auto cv = std::make_shared<c_cellview>(grid, name);
+        std::vector<cbag::box_t> box_list = {cbag::box_t(0, 0, 100, 20),
+                                             cbag::box_t(0, 100, 20, 200)};
+        if (reverse)
+            std::reverse(box_list.begin(), box_list.end());
+        for (const auto &box : box_list) {
+            cv->add_shape(key, box);
+        }
+        return cv;
+    };
+    auto leaf_a = make_leaf("LEAF_A", false);
+    auto leaf_b = make_leaf("LEAF_B", true);
+    auto leaf_c = make_leaf("LEAF_C", false);
+    leaf_c->add_shape(key, cbag::box_t(500, 0, 600, 20));
+    auto top = std::make_shared<c_cellview>(grid, "TOP");
+    top->add_object(cbag::layout::instance("X0", leaf_a, cbag::make_xform(0, 0)));
+    top->add_object(cbag::layout::instance("X1", leaf_b, cbag::make_xform(1000, 0)));
+    top->add_object(cbag::layout::instance("X2", leaf_c, cbag::make_xform(2000, 0)));
+    std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>> cv_list = {
+        {"LEAF_A", leaf_a}, {"LEAF_B", leaf_b}, {"LEAF_C", leaf_c}, {"TOP", top}};
+
+    std::string fname = "tests/data/test_outputs/gds/merge_test.gds";
+    cbag::gdsii::gds_write_options opts;
+    opts.num_threads = num_threads;
+    opts.merge_cells = true;
+    cbag::gdsii::implement_gds(fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list, opts);
+
+    auto info_list = cbag::gdsii::scan_gds(fname);
+    REQUIRE(info_list.size() == 3);
+    auto &top_info = info_list.back();
+    REQUIRE(top_info.name == "TOP");
+    REQUIRE(top_info.ref_cnt.size() == 2);
+    REQUIRE(top_info.ref_cnt.at("LEAF_A") == 2);
+    REQUIRE(top_info.ref_cnt.at("LEAF_C") == 1);
+    REQUIRE(top_info.num_flat == 7);
+}
+
+TEST_CASE("Parents of merged cellviews are merged", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto num_threads = GENERATE(static_cast<std::size_t>(1), static_cast<std::size_t>(4));
+
+    auto make_leaf = [&grid, &key](const std::string &name) {
+        auto cv = std::make_shared<c_cellview>(grid, name);
+        cv->add_shape(key, cbag::box_t(0, 0, 100, 20));
+        return cv;
+    };
+    auto make_parent = [&grid, &key](const std::string &name,
+                                     const std::shared_ptr<const c_cellview> &leaf) {
+        auto cv = std::make_shared<c_cellview>(grid, name);
+        cv->add_shape(key, cbag::box_t(0, 100, 20, 200));
+        cv->add_object(cbag::layout::instance("X0", leaf, cbag::make_xform(0, 0)));
+        return cv;
+    };
+    auto leaf_a = make_leaf("LEAF_A");
+    auto leaf_b = make_leaf("LEAF_B");
+    auto parent_a = make_parent("PARENT_A", leaf_a);
+    auto parent_b = make_parent("PARENT_B", leaf_b);
+    auto top = std::make_shared<c_cellview>(grid, "TOP");
+    top->add_object(cbag::layout::instance("X0", parent_a, cbag::make_xform(0, 0)));
+    top->add_object(cbag::layout::instance("X1", parent_b, cbag::make_xform(1000, 0)));
+    std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>> cv_list = {
+        {"LEAF_A", leaf_a},     {"LEAF_B", leaf_b}, {"PARENT_A", parent_a},
+        {"PARENT_B", parent_b}, {"TOP", top}};
+
+    std::string fname = "tests/data/test_outputs/gds/merge_parent_test.gds";
+    cbag::gdsii::gds_write_options opts;
+    opts.num_threads = num_threads;
+    opts.merge_cells = true;
+    cbag::gdsii::implement_gds(fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list, opts);
+
+    auto info_list = cbag::gdsii::scan_gds(fname);
+    REQUIRE(info_list.size() == 3);
+    REQUIRE(info_list[1].name == "PARENT_A");
+    REQUIRE(info_list[1].ref_cnt.at("LEAF_A") == 1);
+    auto &top_info = info_list.back();
+    REQUIRE(top_info.name == "TOP");
+    REQUIRE(top_info.ref_cnt.size() == 1);
+    REQUIRE(top_info.ref_cnt.at("PARENT_A") == 2);
+    REQUIRE(top_info.num_flat == 4);
+}
+
+TEST_CASE("Generated array cells do not reuse structure names", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto via_id = tech_info->get_via_id(cbag::direction::LOWER, key,
+                                        cbag::layout::layer_t_at(*tech_info, "M2", "drawing"));
+    cbag::layout::via_param params(1, 1, 32, 32, 0, 0, 14, 14, 14, 14, 14, 14, 14, 14);
+
+    // a user cell with the name the array writer would generate first
+    auto leaf = std::make_shared<c_cellview>(grid, "LEAF");
+    cbag::layout::add_rect_arr(*leaf, key, cbag::box_t(0, 0, 20, 100), {1, 1}, {0, 0});
+    auto cv = std::make_shared<c_cellview>(grid, "ARR");
+    cbag::layout::add_via_arr(*cv, cbag::make_xform(0, 0), via_id, params, false, {4, 3},
+                              {400, 300});
+    std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>> cv_list = {
+        {"ARR$via0", leaf}, {"ARR", cv}};
+
+    std::string fname = "tests/data/test_outputs/gds/arr_names.gds";
+    cbag::gdsii::gds_write_options opts;
+    opts.min_array_size = 4;
+    cbag::gdsii::implement_gds(fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list, opts);
+
+    auto info_list = cbag::gdsii::scan_gds(fname);
+    std::set<std::string> name_set;
+    for (const auto &info : info_list) {
+        name_set.insert(info.name);
+    }
+    REQUIRE(name_set.size() == info_list.size());
+    REQUIRE(info_list.front().name == "ARR$via0");
+    REQUIRE(info_list.front().stats.num_box == 1);
+    auto &top = info_list.back();
+    REQUIRE(top.ref_cnt.count("ARR$via0") == 0);
+    REQUIRE(top.ref_cnt.at("ARR$via1") == 12);
+}
+
+TEST_CASE("Compressed GDS files are read and written", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto ext = GENERATE(std::string(".gz"), std::string(".zst"));
+    auto fname = write_test_gds(grid);
+    auto comp_fname = write_test_gds(grid, fname + ext);
+
+    std::vector<std::shared_ptr<c_cellview>> expect_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(expect_list));
+    std::vector<std::shared_ptr<c_cellview>> cv_list;
+    cbag::gdsii::read_gds(comp_fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(cv_list));
+
+    REQUIRE(std::filesystem::file_size(comp_fname) < std::filesystem::file_size(fname));
+    REQUIRE(cv_list.size() == expect_list.size());
+    for (std::size_t idx = 0; idx < cv_list.size(); ++idx) {
+        REQUIRE(*cv_list[idx] == *expect_list[idx]);
+    }
+    REQUIRE_THROWS(cbag::gdsii::gds_library(comp_fname, test_layer_map, test_obj_map, grid));
+}
+
+TEST_CASE("GDS library loads cellviews on demand", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto fname = write_test_gds(grid);
+
+    std::vector<std::shared_ptr<c_cellview>> expect_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(expect_list));
+
+    cbag::gdsii::gds_library lib(fname, test_layer_map, test_obj_map, grid);
+    auto names = lib.get_cell_names();
+    REQUIRE(names.size() == expect_list.size());
+    REQUIRE(lib.get_num_loaded() == 0);
+
+    auto leaf = lib.get_cellview(names[3]);
+    REQUIRE(lib.get_num_loaded() == 1);
+    REQUIRE(*leaf == *expect_list[3]);
+    REQUIRE(lib.get_cellview(names[3]) == leaf);
+
+    auto top = lib.get_cellview(names.back(), 2);
+    REQUIRE(lib.get_num_loaded() == names.size());
+    REQUIRE(*top == *expect_list.back());
+    REQUIRE_THROWS(lib.get_cellview("NOT_A_CELL"));
+}
+
+TEST_CASE("GDS rectangles are read as boxes", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto fname = write_test_gds(grid);
+
+    std::vector<std::shared_ptr<c_cellview>> cv_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid, std::back_inserter(cv_list));
+    auto &top = *cv_list.back();
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto &index = *top.get_geo_index(*tech_info->get_level(key));
+
+    std::size_t num_box = 0, num_poly = 0;
+    auto stop = cbag::layout::geo_query_iter();
+    for (auto iter = index.begin_query(index.get_bbox(), 0, 0); iter != stop; ++iter) {
+        if (std::holds_alternative<cbag::box_t>(iter->val))
+            ++num_box;
+        else if (!std::holds_alternative<cbag::layout::geo_instance>(iter->val))
+            ++num_poly;
+    }
+    REQUIRE(num_box == 1);
+    REQUIRE(num_poly == 1);
+
+
+    std::array<cbag::point, 5> rect = {{{0, 0}, {0, 10}, {20, 10}, {20, 0}, {0, 0}}};
+    REQUIRE(cbag::gdsii::get_rectangle(rect.data(), 5) == cbag::box_t(0, 0, 20, 10));
+    std::array<cbag::point, 4> diamond = {{{0, 5}, {5, 10}, {10, 5}, {5, 0}}};
+    REQUIRE(!cbag::gdsii::get_rectangle(diamond.data(), 4));
+}
+
+TEST_CASE("GDS layer filter skips unwanted layers", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto ext = GENERATE(std::string(), std::string(".gz"));
+    auto fname = write_test_gds(grid, "tests/data/test_outputs/gds/filter_test.gds" + ext);
+    auto m1 = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto m2 = cbag::layout::layer_t_at(*tech_info, "M2", "drawing");
+
+    std::vector<std::shared_ptr<c_cellview>> expect_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(expect_list));
+    std::vector<std::shared_ptr<c_cellview>> m1_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid, std::back_inserter(m1_list), 1,
+                          cbag::compress_type::AUTO, std::vector<cbag::layer_t>{m1});
+    std::vector<std::shared_ptr<c_cellview>> m2_list;
+    cbag::gdsii::read_gds(fname, test_layer_map, test_obj_map, grid, std::back_inserter(m2_list), 1,
+                          cbag::compress_type::AUTO, std::vector<cbag::layer_t>{m2});
+
+    REQUIRE(m1_list.size() == expect_list.size());
+    REQUIRE(m2_list.size() == expect_list.size());
+    for (std::size_t idx = 0; idx < expect_list.size(); ++idx) {
+        REQUIRE(*m1_list[idx] == *expect_list[idx]);
+        REQUIRE(m2_list[idx]->begin_geometry() == m2_list[idx]->end_geometry());
+    }
+    auto &top = *m2_list.back();
+    REQUIRE(std::distance(top.begin_inst(), top.end_inst()) == 9);
+}
+
+// writes a GDS record with integer data
+template <typename T>
+void write_record(cbag::gdsii::gds_buffer &buf, cbag::gdsii::record_type rec, std::vector<T> data) {
+    using U = std::make_unsigned_t<T>;
+    std::ostringstream stream;
+    cbag::gdsii::write_bytes(stream, static_cast<uint16_t>(4 + data.size() * sizeof(T)));
+    cbag::gdsii::write_bytes(stream, static_cast<uint16_t>(rec));
+    for (auto val : data) {
+        cbag::gdsii::write_bytes(stream, static_cast<U>(val));
+    }
+    auto bytes = stream.str();
+    std::copy(bytes.begin(), bytes.end(), buf.extend(bytes.size()));
+}
+
+void write_record(cbag::gdsii::gds_buffer &buf, cbag::gdsii::record_type rec,
+                  const std::string &val) {
+    write_record(buf, rec, std::vector<uint8_t>(val.begin(), val.end()));
+}
+
+TEST_CASE("Read GDS paths, nodes, properties and magnified instances", "[gds]") {
+    using rt = cbag::gdsii::record_type;
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto logger = cbag::get_cbag_logger();
+    auto time_vec = cbag::gdsii::get_gds_time();
+
+    cbag::gdsii::gds_buffer out;
+    cbag::gdsii::write_header(*logger, out);
+    cbag::gdsii::write_lib_begin(*logger, out, time_vec);
+    cbag::gdsii::write_lib_name(*logger, out, "CBAG_TEST");
+    cbag::gdsii::write_units(*logger, out, tech_info->get_resolution(), 1e-6);
+
+    // a leaf with a flagged rectangle that has a property, and a node
+    cbag::gdsii::write_struct_begin(*logger, out, time_vec);
+    cbag::gdsii::write_struct_name(*logger, out, "LEAF");
+    write_record<int16_t>(out, rt::BOUNDARY, {});
+    write_record<int16_t>(out, rt::ELFLAGS, {0});
+    write_record<int16_t>(out, rt::LAYER, {30});
+    write_record<int16_t>(out, rt::DATATYPE, {0});
+    write_record<int32_t>(out, rt::XY, {0, 0, 100, 0, 100, 50, 0, 50, 0, 0});
+    write_record<int16_t>(out, rt::PROPATTR, {5});
+    write_record(out, rt::PROPVALUE, "VALUE0");
+    write_record<int16_t>(out, rt::ENDEL, {});
+    write_record<int16_t>(out, rt::NODE, {});
+    write_record<int16_t>(out, rt::LAYER, {30});
+    write_record<int16_t>(out, rt::NODETYPE, {0});
+    write_record<int32_t>(out, rt::XY, {0, 0});
+    write_record<int16_t>(out, rt::ENDEL, {});
+    cbag::gdsii::write_struct_end(*logger, out);
+
+    cbag::gdsii::write_struct_begin(*logger, out, time_vec);
+    cbag::gdsii::write_struct_name(*logger, out, "TOP");
+    // an extended path with a corner, and a path with a custom begin extension
+    write_record<int16_t>(out, rt::PATH, {});
+    write_record<int16_t>(out, rt::LAYER, {30});
+    write_record<int16_t>(out, rt::DATATYPE, {0});
+    write_record<int16_t>(out, rt::PATHTYPE, {2});
+    write_record<int32_t>(out, rt::WIDTH, {20});
+    write_record<int32_t>(out, rt::XY, {0, 0, 200, 0, 200, 200});
+    write_record<int16_t>(out, rt::ENDEL, {});
+    write_record<int16_t>(out, rt::PATH, {});
+    write_record<int16_t>(out, rt::LAYER, {30});
+    write_record<int16_t>(out, rt::DATATYPE, {0});
+    write_record<int16_t>(out, rt::PATHTYPE, {4});
+    write_record<int32_t>(out, rt::WIDTH, {10});
+    write_record<int32_t>(out, rt::BGNEXTN, {30});
+    write_record<int32_t>(out, rt::XY, {0, -100, 100, -100});
+    write_record<int16_t>(out, rt::ENDEL, {});
+    // a magnified instance, flattened when read
+    write_record<int16_t>(out, rt::SREF, {});
+    write_record(out, rt::SNAME, "LEAF");
+    cbag::gdsii::write_transform(*logger, out, cbag::make_xform(1000, 0), 2.0);
+    write_record<int16_t>(out, rt::ENDEL, {});
+    // an instance without STRANS, with an unknown property before its name
+    write_record<int16_t>(out, rt::SREF, {});
+    write_record(out, rt::SNAME, "LEAF");
+    write_record<int32_t>(out, rt::XY, {2000, 0});
+    write_record<int16_t>(out, rt::PROPATTR, {7});
+    write_record(out, rt::PROPVALUE, "OTHER0");
+    write_record<int16_t>(out, rt::PROPATTR, {cbag::gdsii::PROP_INST_NAME});
+    write_record(out, rt::PROPVALUE, "XLEAF0");
+    write_record<int16_t>(out, rt::ENDEL, {});
+    cbag::gdsii::write_struct_end(*logger, out);
+    cbag::gdsii::write_lib_end(*logger, out);
+
+    cbag::gdsii::gds_cursor stream(out.data(), out.size());
+    cbag::gdsii::gds_rlookup rmap(test_layer_map, test_obj_map, *tech_info);
+    std::vector<std::shared_ptr<c_cellview>> cv_list;
+    cbag::gdsii::read_gds(*logger, stream, rmap, grid, std::back_inserter(cv_list));
+    REQUIRE(cv_list.size() == 2);
+
+    auto key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto &top = *cv_list.back();
+    REQUIRE(top.find_geometry(key)->second.get_bbox() == cbag::box_t(-30, -105, 1200, 210));
+    REQUIRE(std::distance(top.begin_inst(), top.end_inst()) == 1);
+    auto &inst = top.begin_inst()->second;
+    REQUIRE(inst.get_inst_name() == "XLEAF0");
+    REQUIRE(cbag::location(inst.xform) == std::array<cbag::coord_t, 2>{2000, 0});
+}
+
+TEST_CASE("Odd width GDS paths are widened on and off the 45 degree grid", "[gds]") {
+    using rt = cbag::gdsii::record_type;
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto logger = cbag::get_cbag_logger();
+    auto time_vec = cbag::gdsii::get_gds_time();
+
+    cbag::gdsii::gds_buffer out;
+    cbag::gdsii::write_header(*logger, out);
+    cbag::gdsii::write_lib_begin(*logger, out, time_vec);
+    cbag::gdsii::write_lib_name(*logger, out, "CBAG_TEST");
+    cbag::gdsii::write_units(*logger, out, tech_info->get_resolution(), 1e-6);
+    cbag::gdsii::write_struct_begin(*logger, out, time_vec);
+    cbag::gdsii::write_struct_name(*logger, out, "TOP");
+    // a Manhattan path, and a path that is not on the 45 degree grid
+    write_record<int16_t>(out, rt::PATH, {});
+    write_record<int16_t>(out, rt::LAYER, {30});
+    write_record<int16_t>(out, rt::DATATYPE, {0});
+    write_record<int32_t>(out, rt::WIDTH, {5});
+    write_record<int32_t>(out, rt::XY, {0, 0, 100, 0});
+    write_record<int16_t>(out, rt::ENDEL, {});
+    write_record<int16_t>(out, rt::PATH, {});
+    write_record<int16_t>(out, rt::LAYER, {34});
+    write_record<int16_t>(out, rt::DATATYPE, {0});
+    write_record<int32_t>(out, rt::WIDTH, {5});
+    write_record<int32_t>(out, rt::XY, {0, 0, 100, 0, 140, 30});
+    write_record<int16_t>(out, rt::ENDEL, {});
+    cbag::gdsii::write_struct_end(*logger, out);
+    cbag::gdsii::write_lib_end(*logger, out);
+
+    cbag::gdsii::gds_cursor stream(out.data(), out.size());
+    cbag::gdsii::gds_rlookup rmap(test_layer_map, test_obj_map, *tech_info);
+    std::vector<std::shared_ptr<c_cellview>> cv_list;
+    cbag::gdsii::read_gds(*logger, stream, rmap, grid, std::back_inserter(cv_list));
+    REQUIRE(cv_list.size() == 1);
+
+    auto &top = *cv_list.back();
+    auto m1_key = cbag::layout::layer_t_at(*tech_info, "M1", "drawing");
+    auto m2_key = cbag::layout::layer_t_at(*tech_info, "M2", "drawing");
+    REQUIRE(top.find_geometry(m1_key)->second.get_bbox() == cbag::box_t(0, -3, 100, 3));
+    REQUIRE(top.find_geometry(m2_key)->second.get_bbox() == cbag::box_t(0, -3, 142, 32));
+}
+
+TEST_CASE("GDS boundaries are read in file order with their points", "[gds]") {
+    using rt = cbag::gdsii::record_type;
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto logger = cbag::get_cbag_logger();
+    auto time_vec = cbag::gdsii::get_gds_time();
+    // an L-shaped boundary, then a rectangular one
+    std::vector<std::vector<int32_t>> xy_list = {
+        {0, 0, 200, 0, 200, 100, 100, 100, 100, 200, 0, 200, 0, 0},
+        {0, 0, 300, 0, 300, 300, 0, 300, 0, 0},
+    };
+
+    cbag::gdsii::gds_buffer out;
+    cbag::gdsii::write_header(*logger, out);
+    cbag::gdsii::write_lib_begin(*logger, out, time_vec);
+    cbag::gdsii::write_lib_name(*logger, out, "CBAG_TEST");
+    cbag::gdsii::write_units(*logger, out, tech_info->get_resolution(), 1e-6);
+    cbag::gdsii::write_struct_begin(*logger, out, time_vec);
+    cbag::gdsii::write_struct_name(*logger, out, "BNDS");
+    for (const auto &xy : xy_list) {
+        write_record<int16_t>(out, rt::BOUNDARY, {});
+        write_record<int16_t>(out, rt::LAYER, {1000});
+        write_record<int16_t>(out, rt::DATATYPE, {0});
+        write_record<int32_t>(out, rt::XY, xy);
+        write_record<int16_t>(out, rt::ENDEL, {});
+    }
+    cbag::gdsii::write_struct_end(*logger, out);
+    cbag::gdsii::write_lib_end(*logger, out);
+
+    cbag::gdsii::gds_cursor stream(out.data(), out.size());
+    cbag::gdsii::gds_rlookup rmap(test_layer_map, test_obj_map, *tech_info);
+    std::vector<std::shared_ptr<c_cellview>> cv_list;
+    cbag::gdsii::read_gds(*logger, stream, rmap, grid, std::back_inserter(cv_list));
+    REQUIRE(cv_list.size() == 1);
+
+    c_cellview expect(grid, "BNDS", cbag::geometry_mode::POLY);
+    for (const auto &xy : xy_list) {
+        std::vector<cbag::point> pt_list;
+        for (std::size_t idx = 0; idx < xy.size(); idx += 2) {
+            pt_list.push_back(cbag::point{xy[idx], xy[idx + 1]});
+        }
+        cbag::layout::boundary bnd{cbag::boundary_type::PR};
+        bnd.set(pt_list.begin(), pt_list.end());
+        expect.add_object(std::move(bnd));
+    }
+    REQUIRE(*cv_list.back() == expect);
+}
+
+TEST_CASE("GDS array instances round trip away from the origin", "[gds]") {
+    using data_type = std::tuple<cbag::transformation, cbag::cnt_t, cbag::cnt_t, cbag::offset_t,
+                                 cbag::offset_t>;
+    auto [xform, nx, ny, spx, spy] = GENERATE(values<data_type>({
+        {cbag::make_xform(1000, 2000), 3, 2, 100, 50},
+        {cbag::make_xform(-500, 300, cbag::oR90), 3, 2, 100, 50},
+        {cbag::make_xform(700, -900, cbag::oMX), 2, 4, 60, 80},
+        {cbag::make_xform(100, 100, cbag::oR180), 4, 1, 30, 0},
+    }));
+
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto logger = cbag::get_cbag_logger();
+    std::unordered_map<std::string, std::shared_ptr<const c_cellview>> master_map{
+        {"LEAF", std::make_shared<const c_cellview>(grid, "LEAF")}};
+
+    cbag::gdsii::gds_buffer buf;
+    cbag::gdsii::write_instance(*logger, buf, "LEAF", "X0", xform, nx, ny, spx, spy);
+    cbag::gdsii::gds_cursor stream(buf.data(), buf.size());
+    REQUIRE(std::get<0>(cbag::gdsii::read_record_header(stream)) ==
+            cbag::gdsii::record_type::AREF);
+
+    std::size_t cnt = 0;
+    std::size_t num_absolute = 0;
+    auto [inst, mag] =
+        cbag::gdsii::read_arr_instance(*logger, stream, cnt, master_map, num_absolute);
+    REQUIRE(mag == 1.0);
+    REQUIRE(num_absolute == 0);
+    REQUIRE(inst.xform == xform);
+    REQUIRE(inst.nx == nx);
+    REQUIRE(inst.ny == ny);
+    REQUIRE(inst.spx == spx);
+    REQUIRE(inst.spy == spy);
+}
+
+TEST_CASE("Scan GDS structure statistics", "[gds]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto fname = write_test_gds(grid);
+
+    auto info_list = cbag::gdsii::scan_gds(fname);
+    REQUIRE(info_list.size() == 9);
+    for (std::size_t idx = 0; idx < 8; ++idx) {
+        auto &leaf = info_list[idx];
+        auto w = static_cast<cbag::coord_t>(20 * (idx + 1));
+        REQUIRE(leaf.name == "LEAF" + std::to_string(idx));
+        REQUIRE(leaf.depth == 0);
+        REQUIRE(leaf.num_used == ((idx == 0) ? 9 : 1));
+        // the second rectangle of the last leaf is empty
+        if (idx < 7) {
+            REQUIRE(leaf.num_flat == 2);
+            REQUIRE(leaf.bbox == cbag::box_t(0, 0, std::max(100, w), 200));
+        } else {
+            REQUIRE(leaf.num_flat == 1);
+            REQUIRE(leaf.bbox == cbag::box_t(0, 0, 100, w));
+        }
+    }
+
+    auto &top = info_list.back();
+    REQUIRE(top.name == "TOP");
+    REQUIRE(top.depth == 1);
+    REQUIRE(top.num_used == 0);
+    REQUIRE(top.stats.num_inst == 9);
+    REQUIRE(top.ref_cnt.at("LEAF0") == 9);
+    REQUIRE(top.layer_cnt.size() == 1);
+    REQUIRE(top.layer_cnt.begin()->second == 2);
+    REQUIRE(top.num_flat == 33);
+    REQUIRE(top.bbox == cbag::box_t(-50, -1200, 8000, 1000));
+}
@@ -4,11 +4,15 @@
 #include <cbag/enum/end_style.h>
 #include <cbag/layout/cellview_poly.h>
 #include <cbag/layout/cellview_util.h>
+#include <cbag/layout/geo_iterator.h>
 #include <cbag/layout/grid_object.h>
+#include <cbag/layout/instance.h>
 #include <cbag/layout/path_util.h>
 #include <cbag/layout/routing_grid.h>
 #include <cbag/layout/via_wrapper.h>
 
+#include "util/layout.h"
+
 using c_tech = cbag::layout::tech;
 using c_grid = cbag::layout::routing_grid;
 using c_cellview = cbag::layout::cellview;
@@ -22,12 +26,6 @@ using c_box = cbag::box_t;
 using pt_type = std::array<cbag::coord_t, 2>;
 using intv_type = std::array<cbag::coord_t, 2>;
 
-std::shared_ptr<const c_tech> make_tech_info() {
-    return std::make_shared<const c_tech>("tests/data/test_layout/tech_params.yaml");
-}
-std::shared_ptr<const c_grid> make_grid(const std::shared_ptr<const c_tech> &tech) {
-    return std::make_shared<const c_grid>(tech, "tests/data/test_layout/grid.yaml");
-}
 std::shared_ptr<c_cellview> make_cv(const std::shared_ptr<const c_grid> &grid) {
     return std::make_shared<c_cellview>(grid, "CBAG_TEST");
 }
@@ -179,3 +177,123 @@ TEST_CASE("connect warr to track", "[layout::cellview]") {
 
     REQUIRE(ans == expect);
 }
+
+TEST_CASE("remove and update shapes", "[layout::cellview]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto cv = make_cv(grid);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M2", "");
+
+    auto h0 = cv->add_shape(key, c_box(0, 0, 100, 20));
+    auto h1 = cv->add_shape(key, c_box(50, 0, 150, 20));
+    auto h2 = cv->add_shape(key, c_box(0, 100, 20, 200));
+    REQUIRE(h0.is_valid());
+
+    // removing the first box must keep the area covered by the overlapping second box
+    REQUIRE(cv->remove_shape(key, h0));
+    REQUIRE(!cv->remove_shape(key, h0));
+    auto h3 = cv->update_shape(key, h2, c_box(300, 100, 320, 200));
+    REQUIRE(h3.id == h2.id);
+
+    cbag::layout::geometry expect;
+    expect.add_shape(c_box(50, 0, 150, 20));
+    expect.add_shape(c_box(300, 100, 320, 200));
+    auto geo_iter = cv->find_geometry(key);
+    REQUIRE(geo_iter != cv->end_geometry());
+    REQUIRE(geo_iter->second == expect);
+
+    auto &index = *cv->get_geo_index(*tech_info->get_level(key));
+    REQUIRE(index.find(h1) != nullptr);
+    REQUIRE(index.find(h3) != nullptr);
+}
+
+TEST_CASE("lazy index matches eager index", "[layout::cellview]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M2", "");
+    auto lev = *tech_info->get_level(key);
+
+    auto fill = [&key](c_cellview &cv) {
+        for (cbag::coord_t idx = 0; idx < 10; ++idx) {
+            cv.add_shape(key, c_box(idx * 100, 0, idx * 100 + 40, 400));
+        }
+    };
+    auto make_top = [&](bool lazy) {
+        auto master = make_cv(grid);
+        master->set_lazy_index(lazy);
+        fill(*master);
+        auto top = make_cv(grid);
+        top->set_lazy_index(lazy);
+        fill(*top);
+        top->add_object(cbag::layout::instance("X0", master, cbag::make_xform(0, 1000), 3, 2,
+                                               1000, 500));
+        return top;
+    };
+    auto eager = make_top(false);
+    auto lazy = make_top(true);
+    REQUIRE(lazy->is_lazy_index());
+
+    for (const auto &r : {c_box(0, 0, 50, 50), c_box(-100, -100, 5000, 5000),
+                          c_box(150, 1200, 1250, 1300)}) {
+        std::size_t num_eager = 0, num_lazy = 0;
+        for (auto iter = eager->get_geo_index(lev)->begin_intersect(r, 0, 0, cbag::make_xform());
+             iter.has_next(); ++iter)
+            ++num_eager;
+        for (auto iter = lazy->get_geo_index(lev)->begin_intersect(r, 0, 0, cbag::make_xform());
+             iter.has_next(); ++iter)
+            ++num_lazy;
+        REQUIRE(num_lazy == num_eager);
+    }
+}
+
+TEST_CASE("set index algorithm", "[layout::cellview]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto lev = *tech_info->get_level(cbag::layout::layer_t_at(*tech_info, "M2", ""));
+
+    auto cv = make_cv(grid);
+    REQUIRE(cv->get_index_algorithm() == cbag::index_algorithm::QUADRATIC);
+    REQUIRE(cv->get_index_max_elements() == 32);
+
+    cv->set_index_algorithm(cbag::index_algorithm::RSTAR, 16);
+    REQUIRE(cv->get_index_algorithm() == cbag::index_algorithm::RSTAR);
+    REQUIRE(cv->get_index_max_elements() == 16);
+    REQUIRE(cv->get_geo_index(lev)->get_algorithm() == cbag::index_algorithm::RSTAR);
+    REQUIRE(cv->get_geo_index(lev)->get_max_elements() == 16);
+
+    cv->add_shape(cbag::layout::layer_t_at(*tech_info, "M2", ""), c_box(0, 0, 40, 400));
+    REQUIRE_THROWS_AS(cv->set_index_algorithm(cbag::index_algorithm::LINEAR, 8),
+                      std::runtime_error);
+    REQUIRE(cv->get_index_max_elements() == 16);
+}
+
+TEST_CASE("content hash ignores names and insertion order", "[layout::cellview]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto key = cbag::layout::layer_t_at(*tech_info, "M2", "");
+    auto box_list = std::vector<c_box>{c_box(0, 0, 100, 20), c_box(0, 100, 20, 200),
+                                       c_box(300, 100, 320, 200)};
+
+    auto cv0 = std::make_shared<c_cellview>(grid, "CELL0");
+    auto cv1 = std::make_shared<c_cellview>(grid, "CELL1");
+    for (const auto &box : box_list) {
+        cv0->add_shape(key, box);
+    }
+    for (auto iter = box_list.rbegin(); iter != box_list.rend(); ++iter) {
+        cv1->add_shape(key, *iter);
+    }
+    REQUIRE(cv0->get_hash() == cv1->get_hash());
+    REQUIRE(cv0->has_same_content(*cv1));
+    REQUIRE(!(*cv0 == *cv1));
+
+    // removing a shape, then adding it back, restores the hash
+    auto old_hash = cv0->get_hash();
+    auto h = cv0->add_shape(key, c_box(500, 0, 600, 20));
+    REQUIRE(cv0->get_hash() != old_hash);
+    REQUIRE(!cv0->has_same_content(*cv1));
+    cv0->remove_shape(key, h);
+    REQUIRE(cv0->get_hash() == old_hash);
+
+    cv1->add_object(cbag::layout::instance("X0", cv0, cbag::make_xform(0, 1000)));
+    REQUIRE(cv0->get_hash() != cv1->get_hash());
+}
@@ -0,0 +1,557 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <cbag/common/box_t_util.h>
+#include <cbag/common/point.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/layout/flat_geo_cache.h>
+#include <cbag/layout/geo_index.h>
+#include <cbag/layout/geo_iterator.h>
+#include <cbag/layout/pt_traits.h>
+
+using c_box = cbag::box_t;
+using c_index = cbag::layout::geo_index;
+
+// the number of allocations made by the test program, to check code paths that should not allocate
+std::atomic<std::size_t> num_alloc{0};
+
+void *operator new(std::size_t size) {
+    ++num_alloc;
+    if (auto ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+std::vector<c_box> make_box_grid(cbag::cnt_t nx, cbag::cnt_t ny, cbag::offset_t w,
+                                 cbag::offset_t sp) {
+    std::vector<c_box> ans;
+    ans.reserve(nx * ny);
+    for (decltype(nx) ix = 0; ix < nx; ++ix) {
+        for (decltype(ny) iy = 0; iy < ny; ++iy) {
+            cbag::coord_t x0 = ix * sp;
+            cbag::coord_t y0 = iy * sp;
+            ans.emplace_back(x0, y0, x0 + w, y0 + w);
+        }
+    }
+    return ans;
+}
+
+std::size_t count_intersect(const c_index &index, const c_box &r) {
+    std::size_t ans = 0;
+    for (auto iter = index.begin_intersect(r, 0, 0, cbag::make_xform()); iter.has_next(); ++iter) {
+        ++ans;
+    }
+    return ans;
+}
+
+std::size_t count_overlap(const std::vector<c_box> &box_list, const c_box &r) {
+    std::size_t ans = 0;
+    for (const auto &box : box_list) {
+        if (cbag::is_physical(cbag::get_intersect(box, r)))
+            ++ans;
+    }
+    return ans;
+}
+
+TEST_CASE("geo_index stages objects until finalized", "[layout::geo_index]") {
+    auto box_list = make_box_grid(20, 30, 10, 40);
+    c_index index;
+    REQUIRE(index.empty());
+    for (const auto &box : box_list) {
+        index.insert(box, 0, 0);
+    }
+    REQUIRE(!index.empty());
+    REQUIRE(!index.is_finalized());
+
+    index.finalize();
+    REQUIRE(index.is_finalized());
+    REQUIRE(index.get_bbox() == c_box(0, 0, 19 * 40 + 10, 29 * 40 + 10));
+}
+
+TEST_CASE("geo_index query results do not depend on staging", "[layout::geo_index]") {
+    auto box_list = make_box_grid(25, 25, 10, 40);
+    auto r = GENERATE(values<c_box>({
+        {0, 0, 100, 100},
+        {-50, -50, 5, 5},
+        {95, 95, 135, 400},
+        {2000, 2000, 3000, 3000},
+    }));
+
+    c_index index;
+    // insert half the boxes, query, then insert the rest to exercise incremental flushes.
+    auto half = box_list.size() / 2;
+    for (std::size_t idx = 0; idx < half; ++idx) {
+        index.insert(box_list[idx], 0, 0);
+    }
+    std::vector<c_box> first_half(box_list.begin(), box_list.begin() + half);
+    REQUIRE(count_intersect(index, r) == count_overlap(first_half, r));
+
+    for (std::size_t idx = half; idx < box_list.size(); ++idx) {
+        index.insert(box_list[idx], 0, 0);
+    }
+    REQUIRE(count_intersect(index, r) == count_overlap(box_list, r));
+}
+
+TEST_CASE("geo_iterator traverses instance hierarchy", "[layout::geo_index]") {
+    auto xform = GENERATE(values<cbag::transformation>({
+        cbag::make_xform(0, 0, cbag::oR0),
+        cbag::make_xform(1000, 0, cbag::oR90),
+        cbag::make_xform(-300, 500, cbag::oMX),
+        cbag::make_xform(25, -40, cbag::oMYR90),
+    }));
+
+    auto box_list = make_box_grid(10, 10, 10, 40);
+    auto leaf = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        leaf->insert(box, 0, 0);
+    }
+    // two levels of hierarchy, the middle level is placed with identity transform.
+    auto mid = std::make_shared<c_index>();
+    mid->insert(leaf, cbag::make_xform());
+    c_index top;
+    top.insert(mid, xform);
+
+    std::vector<c_box> expect_list;
+    for (const auto &box : box_list) {
+        expect_list.push_back(cbag::get_transform(box, xform));
+    }
+    auto r = cbag::get_transform(c_box(50, 50, 200, 170), xform);
+
+    std::vector<c_box> ans_list;
+    for (auto iter = top.begin_intersect(r, 0, 0, cbag::make_xform()); iter.has_next(); ++iter) {
+        auto view = *iter;
+        REQUIRE(view.index() == cbag::layout::geo_union_enum::RECT);
+        auto geo = view.get_union();
+        REQUIRE(*geo.get_if<c_box>() == view.get_bbox());
+        ans_list.push_back(view.get_bbox());
+    }
+    REQUIRE(ans_list.size() == count_overlap(expect_list, r));
+    for (const auto &box : ans_list) {
+        REQUIRE(std::find(expect_list.begin(), expect_list.end(), box) != expect_list.end());
+    }
+}
+
+TEST_CASE("geo_iterator traverses deep hierarchies", "[layout::geo_index]") {
+    // deeper than the frames stored inside the iterator
+    constexpr std::size_t num_levels = 80;
+    auto box_list = make_box_grid(3, 1, 10, 20);
+    auto cur = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        cur->insert(box, 0, 0);
+    }
+    for (std::size_t idx = 0; idx < num_levels; ++idx) {
+        auto next = std::make_shared<c_index>();
+        next->insert(cur, cbag::make_xform(1, 2));
+        cur = next;
+    }
+
+    std::vector<c_box> expect_list;
+    for (const auto &box : box_list) {
+        expect_list.push_back(cbag::get_move_by(box, num_levels, 2 * num_levels));
+    }
+    auto get_boxes = [](cbag::layout::geo_iterator iter) {
+        std::vector<c_box> ans;
+        while (iter.has_next()) {
+            ans.push_back((*iter++).get_bbox());
+        }
+        return ans;
+    };
+
+    auto iter = cur->begin_intersect(c_box(-100, -100, 1000, 1000), 0, 0, cbag::make_xform());
+    auto copy = iter;
+    REQUIRE(copy == iter);
+    auto ans_list = get_boxes(std::move(iter));
+    std::sort(ans_list.begin(), ans_list.end(), [](const c_box &a, const c_box &b) {
+        return xl(a) < xl(b);
+    });
+    REQUIRE(ans_list == expect_list);
+    REQUIRE(get_boxes(copy).size() == expect_list.size());
+}
+
+TEST_CASE("geo_iterator does not allocate while traversing", "[layout::geo_index]") {
+    // enough boxes that every R-tree has internal nodes
+    auto box_list = make_box_grid(40, 40, 10, 20);
+    auto leaf = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        leaf->insert(box, 0, 0);
+    }
+    auto mid = std::make_shared<c_index>();
+    for (cbag::coord_t idx = 0; idx < 5; ++idx) {
+        mid->insert(leaf, cbag::make_xform(idx * 1000, 0));
+    }
+    c_index top;
+    for (cbag::coord_t idx = 0; idx < 5; ++idx) {
+        top.insert(mid, cbag::make_xform(0, idx * 1000));
+    }
+    leaf->finalize();
+    mid->finalize();
+    top.finalize();
+
+    std::size_t num_geo = 0;
+    std::size_t num_copy = 0;
+    auto start = num_alloc.load();
+    for (auto iter = top.begin_intersect(c_box(-100, -100, 5000, 5000), 0, 0, cbag::make_xform());
+         iter.has_next(); ++iter) {
+        if (num_geo++ % 1000 == 0) {
+            auto copy = iter;
+            num_copy += copy.has_next();
+        }
+    }
+    auto num_new = num_alloc.load() - start;
+
+    REQUIRE(num_geo == 25 * box_list.size());
+    REQUIRE(num_copy == 40);
+    REQUIRE(num_new == 0);
+}
+
+TEST_CASE("geo_iterator only visits overlapping array elements", "[layout::geo_index]") {
+    auto xform = GENERATE(values<cbag::transformation>({
+        cbag::make_xform(0, 0, cbag::oR0),
+        cbag::make_xform(100, 30, cbag::oR90),
+        cbag::make_xform(-70, 200, cbag::oMY),
+    }));
+    auto sp = GENERATE(values<std::array<cbag::offset_t, 2>>({{60, 50}, {-45, 70}, {0, -80}}));
+    auto r = GENERATE(values<c_box>({
+        {0, 0, 100, 100},
+        {-500, -500, 500, 500},
+        {130, -20, 131, 400},
+        {5000, 5000, 6000, 6000},
+    }));
+
+    auto box_list = make_box_grid(2, 2, 10, 20);
+    auto leaf = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        leaf->insert(box, 0, 0);
+    }
+    cbag::cnt_t nx = 7;
+    cbag::cnt_t ny = 5;
+    c_index top;
+    top.insert(leaf, xform, nx, ny, sp[0], sp[1]);
+
+    std::vector<c_box> expect_list;
+    for (decltype(nx) ix = 0; ix < nx; ++ix) {
+        for (decltype(ny) iy = 0; iy < ny; ++iy) {
+            auto inst_xform = cbag::get_move_by(xform, ix * sp[0], iy * sp[1]);
+            for (const auto &box : box_list) {
+                expect_list.push_back(cbag::get_transform(box, inst_xform));
+            }
+        }
+    }
+
+    REQUIRE(count_intersect(top, r) == count_overlap(expect_list, r));
+}
+
+TEST_CASE("geo_index batch query matches single queries", "[layout::geo_index]") {
+    auto num_threads = GENERATE(1, 4);
+    auto xform = GENERATE(values<cbag::transformation>({
+        cbag::make_xform(0, 0, cbag::oR0),
+        cbag::make_xform(300, -20, cbag::oR270),
+    }));
+
+    auto box_list = make_box_grid(8, 8, 10, 30);
+    auto leaf = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        leaf->insert(box, 0, 0);
+    }
+    leaf->finalize();
+    c_index top;
+    top.insert(leaf, cbag::make_xform(15, 15, cbag::oMX), 3, 2, 300, -400);
+    top.insert(c_box(-100, -100, -90, 2000), 5, 5);
+
+    std::vector<cbag::layout::geo_query> queries;
+    for (cbag::coord_t x = -150; x < 1000; x += 70) {
+        for (cbag::coord_t y = -600; y < 400; y += 110) {
+            queries.push_back({c_box(x, y, x + 20 + (x % 50), y + 35), x % 7, y % 3});
+        }
+    }
+    queries.push_back({c_box(-1000, -1000, 2000, 2000), 0, 0});
+
+    auto ans = top.query_batch(queries, xform, num_threads);
+    REQUIRE(ans.size() == queries.size());
+    for (std::size_t idx = 0; idx < queries.size(); ++idx) {
+        const auto &q = queries[idx];
+        std::vector<c_box> expect_list;
+        for (auto iter = top.begin_intersect(q.box, q.spx, q.spy, xform); iter.has_next();
+             ++iter) {
+            expect_list.push_back((*iter).get_bbox());
+        }
+        std::vector<c_box> ans_list;
+        for (const auto &view : ans[idx]) {
+            ans_list.push_back(view.get_bbox());
+        }
+        auto cmp = [](const c_box &a, const c_box &b) {
+            return std::make_tuple(xl(a), yl(a), xh(a), yh(a)) <
+                   std::make_tuple(xl(b), yl(b), xh(b), yh(b));
+        };
+        std::sort(expect_list.begin(), expect_list.end(), cmp);
+        std::sort(ans_list.begin(), ans_list.end(), cmp);
+        REQUIRE(ans_list == expect_list);
+    }
+}
+
+TEST_CASE("geo_iterator results do not depend on flat cache", "[layout::geo_index]") {
+    auto r = GENERATE(values<c_box>({
+        {0, 0, 100, 100},
+        {-400, -300, 50, 700},
+        {333, 12, 334, 900},
+    }));
+    auto spx = GENERATE(0, 7);
+
+    auto make_top = [](bool use_cache) {
+        auto leaf = std::make_shared<c_index>();
+        for (const auto &box : make_box_grid(4, 3, 10, 25)) {
+            leaf->insert(box, 3, 0);
+        }
+        leaf->finalize();
+        auto mid = std::make_shared<c_index>();
+        mid->insert(leaf, cbag::make_xform(0, 0, cbag::oR90), 3, 2, -120, 90);
+        mid->insert(c_box(5, 5, 400, 15), 0, 0);
+        if (use_cache)
+            mid->enable_flat_cache();
+        else
+            mid->finalize();
+        auto top = std::make_shared<c_index>();
+        top->insert(mid, cbag::make_xform(40, -30, cbag::oMY), 2, 2, 500, 200);
+        return top;
+    };
+
+    auto get_boxes = [&r, &spx](const c_index &index) {
+        std::vector<c_box> ans;
+        for (auto iter = index.begin_intersect(r, spx, 0, cbag::make_xform()); iter.has_next();
+             ++iter) {
+            ans.push_back((*iter).get_bbox());
+        }
+        return ans;
+    };
+
+    auto expect_list = get_boxes(*make_top(false));
+    auto ans_list = get_boxes(*make_top(true));
+    REQUIRE(ans_list.size() == expect_list.size());
+    for (const auto &box : ans_list) {
+        REQUIRE(std::find(expect_list.begin(), expect_list.end(), box) != expect_list.end());
+    }
+}
+
+TEST_CASE("flat cache follows changes to masters", "[layout::geo_index]") {
+    auto leaf = std::make_shared<c_index>();
+    auto leaf_handle = leaf->insert(c_box(0, 0, 10, 10), 0, 0);
+    leaf->insert(c_box(50, 0, 60, 20), 0, 0);
+    auto mid = std::make_shared<c_index>();
+    mid->insert(leaf, cbag::make_xform(), 4, 1, 100, 0);
+    mid->enable_flat_cache();
+    c_index top;
+    top.insert(mid, cbag::make_xform(1000, 0), 1, 3, 0, 500);
+
+    // instance bounding boxes are fixed when inserted, so edits stay inside them
+    c_box r(0, -100, 2000, 2000);
+    c_box tall_box(1000, 15, 1400, 16);
+    REQUIRE(count_intersect(top, r) == 24);
+    REQUIRE(count_intersect(top, tall_box) == 4);
+    auto old_cache = mid->get_flat_cache();
+
+    // edit the master after the cache of its parent is built
+    auto new_handle = leaf->update(leaf_handle, c_box(0, 0, 10, 20), 0, 0);
+    leaf->insert(c_box(20, 0, 30, 10), 0, 0);
+    REQUIRE(count_intersect(top, r) == 36);
+    REQUIRE(count_intersect(top, tall_box) == 8);
+    REQUIRE(mid->get_flat_cache() != old_cache);
+    REQUIRE(old_cache->size() == 8);
+
+    leaf->remove(new_handle);
+    REQUIRE(count_intersect(top, r) == 24);
+    REQUIRE(count_intersect(top, tall_box) == 4);
+
+    // edit the cached index itself
+    mid->insert(c_box(20, 5, 30, 15), 0, 0);
+    REQUIRE(count_intersect(top, r) == 27);
+    REQUIRE(mid->get_flat_cache()->size() == 9);
+}
+
+TEST_CASE("geo_index nearest query matches brute force", "[layout::geo_index]") {
+    auto r = GENERATE(values<c_box>({
+        {-300, -300, -250, -250},
+        {130, 500, 140, 520},
+        {1000, 10, 1001, 11},
+        {50, 50, 60, 60},
+    }));
+    auto k = GENERATE(1, 5, 40);
+
+    auto box_list = make_box_grid(3, 3, 10, 30);
+    auto leaf = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        leaf->insert(box, 2, 4);
+    }
+    c_index top;
+    auto inst_xform = cbag::make_xform(20, 700, cbag::oMX);
+    top.insert(leaf, inst_xform, 6, 4, 100, -150);
+    top.insert(c_box(-100, 200, -90, 230), 0, 0);
+
+    // all bounding boxes including margins, in query coordinates
+    std::vector<int64_t> expect_list;
+    auto add_dist = [&r, &expect_list](const c_box &box) {
+        auto dx = std::max({xl(r) - xh(box), xl(box) - xh(r), 0});
+        auto dy = std::max({yl(r) - yh(box), yl(box) - yh(r), 0});
+        expect_list.push_back(static_cast<int64_t>(dx) * dx + static_cast<int64_t>(dy) * dy);
+    };
+    for (cbag::cnt_t ix = 0; ix < 6; ++ix) {
+        for (cbag::cnt_t iy = 0; iy < 4; ++iy) {
+            auto xform = cbag::get_move_by(inst_xform, ix * 100, iy * -150);
+            for (const auto &box : box_list) {
+                add_dist(cbag::get_transform(cbag::get_expand(box, 2, 4), xform));
+            }
+        }
+    }
+    add_dist(c_box(-100, 200, -90, 230));
+    std::sort(expect_list.begin(), expect_list.end());
+
+    auto ans = top.get_nearest(r, k, cbag::make_xform());
+    REQUIRE(ans.size() == std::min<std::size_t>(k, expect_list.size()));
+    for (std::size_t idx = 0; idx < ans.size(); ++idx) {
+        auto box = ans[idx].get_bnd_box();
+        auto dx = std::max({xl(r) - xh(box), xl(box) - xh(r), 0});
+        auto dy = std::max({yl(r) - yh(box), yl(box) - yh(r), 0});
+        REQUIRE(static_cast<int64_t>(dx) * dx + static_cast<int64_t>(dy) * dy == expect_list[idx]);
+    }
+    REQUIRE(top.get_min_distance(r) == Approx(std::sqrt(static_cast<double>(expect_list[0]))));
+}
+
+TEST_CASE("geo_index nearest query measures polygons exactly", "[layout::geo_index]") {
+    // an L shape whose notch holds the query box, and a triangle with spacing margins
+    std::vector<cbag::point> l_shape = {{0, 0},     {300, 0},   {300, 100},
+                                        {100, 100}, {100, 300}, {0, 300}};
+    cbag::layout::polygon90 l_poly;
+    l_poly.set(l_shape.begin(), l_shape.end());
+    std::vector<cbag::point> tri_shape = {{1000, 0}, {1200, 0}, {1000, 200}};
+    cbag::layout::polygon45 tri_poly;
+    tri_poly.set(tri_shape.begin(), tri_shape.end());
+
+    c_index index;
+    index.insert(l_poly, 0, 0);
+    index.insert(c_box(250, 400, 260, 410), 0, 0);
+    index.insert(tri_poly, 5, 5);
+
+    c_box r(250, 250, 260, 260);
+    REQUIRE(index.get_min_distance(r) == Approx(140));
+    auto ans = index.get_nearest(r, 2, cbag::make_xform());
+    REQUIRE(ans.size() == 2);
+    REQUIRE(ans[0].index() == cbag::layout::geo_union_enum::RECT);
+    REQUIRE(ans[1].get_bbox() == c_box(0, 0, 300, 300));
+
+    // the corner of the box grown by the margins is 90 away from the hypotenuse along x and y
+    c_box tri_r(1150, 150, 1160, 160);
+    REQUIRE(index.get_min_distance(tri_r) == Approx(90 / std::sqrt(2.0)));
+}
+
+TEST_CASE("geo_index supports concurrent queries", "[layout::geo_index]") {
+    auto num_threads = GENERATE(1, 3, 8);
+    auto r = GENERATE(values<c_box>({
+        {-200, -200, 900, 700},
+        {40, 40, 41, 600},
+    }));
+
+    auto box_list = make_box_grid(6, 6, 12, 30);
+    auto leaf = std::make_shared<c_index>();
+    for (const auto &box : box_list) {
+        leaf->insert(box, 1, 2);
+    }
+    c_index top;
+    top.insert(leaf, cbag::make_xform(0, 0, cbag::oR90), 4, 3, -200, 190);
+    top.insert(c_box(-150, -150, 800, -140), 0, 0);
+
+    // query the unfinalized index from many threads at once
+    std::vector<std::size_t> count_list(num_threads);
+    std::vector<std::thread> thread_list;
+    for (int idx = 0; idx < num_threads; ++idx) {
+        thread_list.emplace_back(
+            [&top, &r, &count_list, idx]() { count_list[idx] = count_intersect(top, r); });
+    }
+    for (auto &t : thread_list) {
+        t.join();
+    }
+    REQUIRE(top.is_finalized());
+
+    std::vector<c_box> expect_list;
+    for (auto iter = top.begin_intersect(r, 5, 5, cbag::make_xform()); iter.has_next(); ++iter) {
+        expect_list.push_back((*iter).get_bbox());
+    }
+    for (auto count : count_list) {
+        REQUIRE(count == count_intersect(top, r));
+    }
+
+    std::vector<c_box> ans_list;
+    for (const auto &view : top.query_tiled(r, 5, 5, cbag::make_xform(), num_threads)) {
+        ans_list.push_back(view.get_bbox());
+    }
+    auto cmp = [](const c_box &a, const c_box &b) {
+        return std::make_tuple(xl(a), yl(a), xh(a), yh(a)) <
+               std::make_tuple(xl(b), yl(b), xh(b), yh(b));
+    };
+    std::sort(expect_list.begin(), expect_list.end(), cmp);
+    std::sort(ans_list.begin(), ans_list.end(), cmp);
+    REQUIRE(ans_list == expect_list);
+}
+
+TEST_CASE("geo_index removes and updates objects by handle", "[layout::geo_index]") {
+    auto box_list = make_box_grid(10, 10, 10, 40);
+    c_index index;
+    std::vector<cbag::layout::geo_handle> handle_list;
+    for (const auto &box : box_list) {
+        handle_list.push_back(index.insert(box, 0, 0));
+    }
+    // an identical copy of the first box must survive removal of the original
+    auto copy_handle = index.insert(box_list[0], 0, 0);
+
+    c_box r(-10, -10, 1000, 1000);
+    REQUIRE(count_intersect(index, r) == box_list.size() + 1);
+
+    REQUIRE(index.remove(handle_list[0]));
+    REQUIRE(!index.remove(handle_list[0]));
+    REQUIRE(index.find(handle_list[0]) == nullptr);
+    REQUIRE(index.find(copy_handle) != nullptr);
+    REQUIRE(count_intersect(index, r) == box_list.size());
+
+    // moving a box keeps its id
+    c_box new_box(2000, 2000, 2010, 2010);
+    auto new_handle = index.update(handle_list[5], new_box, 0, 0);
+    REQUIRE(new_handle.id == handle_list[5].id);
+    REQUIRE(count_intersect(index, r) == box_list.size() - 1);
+    REQUIRE(count_intersect(index, new_box) == 1);
+    REQUIRE(std::get<c_box>(index.find(new_handle)->val) == new_box);
+    REQUIRE_THROWS_AS(index.update(handle_list[0], new_box, 0, 0), std::invalid_argument);
+}
+
+TEST_CASE("geo_index results do not depend on split algorithm", "[layout::geo_index]") {
+    auto alg = GENERATE(cbag::index_algorithm::LINEAR, cbag::index_algorithm::QUADRATIC,
+                        cbag::index_algorithm::RSTAR);
+    // 32 is the default, which uses a tree with compile time parameters
+    auto max_elements = GENERATE(4, 16, 32, 64);
+    auto r = GENERATE(values<c_box>({
+        {0, 0, 100, 100},
+        {95, 95, 135, 400},
+        {2000, 2000, 3000, 3000},
+    }));
+
+    auto box_list = make_box_grid(30, 20, 10, 40);
+    c_index index(alg, max_elements);
+    REQUIRE(index.get_algorithm() == alg);
+    // insert in two steps to exercise both bulk loading and incremental insertion
+    for (std::size_t idx = 0; idx < box_list.size(); ++idx) {
+        index.insert(box_list[idx], 0, 0);
+        if (idx == box_list.size() * 2 / 3)
+            index.finalize();
+    }
+    REQUIRE(count_intersect(index, r) == count_overlap(box_list, r));
+    REQUIRE(index.get_nearest(r, 3, cbag::make_xform()).size() == 3);
+}
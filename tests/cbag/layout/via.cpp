@@ -54,6 +54,10 @@ TEST_CASE("get via cuts", "[via]") {
         {cbag::make_xform(0, 0), "M2_M1",
          c_via_param(1, 1, 32, 32, 0, 0, 14, 14, 14, 14, 14, 14, 14, 14),
          std::vector<c_box>{c_box(-16, -16, 16, 16)}},
+        {cbag::make_xform(100, 200), "M2_M1",
+         c_via_param(2, 2, 32, 32, 40, 40, 14, 14, 14, 14, 14, 14, 14, 14),
+         std::vector<c_box>{c_box(48, 148, 80, 180), c_box(48, 220, 80, 252),
+                            c_box(120, 148, 152, 180), c_box(120, 220, 152, 252)}},
     }));
 
     std::vector<c_box> ans;
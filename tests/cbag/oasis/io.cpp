@@ -0,0 +1,125 @@
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <cbag/common/box_t.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/gdsii/read.h>
+#include <cbag/gdsii/write.h>
+#include <cbag/layout/cellview.h>
+#include <cbag/layout/instance.h>
+#include <cbag/layout/routing_grid.h>
+#include <cbag/layout/tech_util.h>
+#include <cbag/oasis/io_util.h>
+#include <cbag/oasis/read.h>
+#include <cbag/oasis/write.h>
+#include <cbag/util/io.h>
+
+#include "util/layout.h"
+
+using c_cellview = cbag::layout::cellview;
+
+TEST_CASE("Read/write OASIS integers and reals", "[oasis]") {
+    auto val = GENERATE(values<int64_t>({0, 1, -1, 63, 64, -64, 127, 128, 300000, -4000000000,
+                                         0x3fffffffffffffff, -0x3fffffffffffffff}));
+
+    std::string buf;
+    if (val >= 0)
+        cbag::oasis::write_uint(buf, static_cast<uint64_t>(val));
+    cbag::oasis::write_sint(buf, val);
+    cbag::oasis::write_real(buf, static_cast<double>(val));
+    cbag::oasis::write_real(buf, val / 7.0);
+
+    cbag::oasis::oas_cursor cur(buf.data(), buf.size());
+    if (val >= 0)
+        REQUIRE(cbag::oasis::read_uint(cur) == static_cast<uint64_t>(val));
+    REQUIRE(cbag::oasis::read_sint(cur) == val);
+    REQUIRE(cbag::oasis::read_real(cur) == static_cast<double>(val));
+    REQUIRE(cbag::oasis::read_real(cur) == val / 7.0);
+    REQUIRE(cur.empty());
+}
+
+TEST_CASE("Read/write OASIS point lists and repetitions", "[oasis]") {
+    auto pt_list = GENERATE(values<std::vector<cbag::point>>({
+        {{0, 0}, {100, 0}, {100, 50}, {0, 50}},
+        {{0, 0}, {30, 30}, {30, 100}, {-20, 50}},
+        {{0, 0}, {17, 5}, {-3, 40}},
+    }));
+
+    std::string buf;
+    cbag::oasis::write_point_list(buf, pt_list);
+    cbag::oasis::oas_repetition arr;
+    arr.nx = 3;
+    arr.ny = 2;
+    arr.spx = 40;
+    arr.spy = -70;
+    cbag::oasis::write_repetition(buf, arr);
+    cbag::oasis::oas_repetition irr;
+    irr.offset_list = pt_list;
+    cbag::oasis::write_repetition(buf, irr);
+
+    cbag::oasis::oas_cursor cur(buf.data(), buf.size());
+    REQUIRE(cbag::oasis::read_point_list(cur, false) == pt_list);
+    auto arr_ans = cbag::oasis::read_repetition(cur, {});
+    REQUIRE(arr_ans.get_offsets() == arr.get_offsets());
+    REQUIRE(arr_ans.is_regular());
+    REQUIRE(cbag::oasis::read_repetition(cur, {}).get_offsets() == pt_list);
+    REQUIRE(cur.empty());
+}
+
+// the shared test cellviews, and a cell with repeated rectangles and a mirrored instance
+std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>>
+make_oas_test_cellviews(const std::shared_ptr<const cbag::layout::routing_grid> &grid) {
+    auto key = cbag::layout::layer_t_at(*grid->get_tech(), "M1", "drawing");
+    auto cv_list = make_test_cellviews(grid);
+
+    auto top = std::make_shared<c_cellview>(grid, "CHIP");
+    // a grid of identical rectangles, written as one array
+    for (cbag::coord_t ix = 0; ix < 5; ++ix) {
+        for (cbag::coord_t iy = 0; iy < 3; ++iy) {
+            top->add_shape(key, cbag::box_t(1000 + 200 * ix, 300 * iy, 1100 + 200 * ix,
+                                            300 * iy + 100));
+        }
+    }
+    top->add_shape(key, cbag::box_t(-500, -500, -200, -450));
+    top->add_object(cbag::layout::instance("XLEAF0", cv_list[0].second,
+                                           cbag::make_xform(-2000, 100, cbag::oMXR90)));
+    top->add_object(cbag::layout::instance("XTOP", cv_list.back().second, cbag::make_xform(), 4,
+                                           2, 10000, 3000));
+    cv_list.emplace_back("CHIP", top);
+    return cv_list;
+}
+
+TEST_CASE("OASIS files match GDS files", "[oasis]") {
+    auto tech_info = make_tech_info();
+    auto grid = make_grid(tech_info);
+    auto compress = GENERATE(true, false);
+    auto cv_list = make_oas_test_cellviews(grid);
+
+    std::string gds_fname = "tests/data/test_outputs/oasis/io_test.gds";
+    std::string oas_fname = "tests/data/test_outputs/oasis/io_test.oas";
+    cbag::util::make_parent_dirs(oas_fname);
+    cbag::gdsii::implement_gds(gds_fname, "CBAG_TEST", test_layer_map, test_obj_map,
+                               tech_info->get_resolution(), 1e-6, cv_list);
+    cbag::oasis::implement_oas(oas_fname, test_layer_map, test_obj_map, tech_info->get_resolution(),
+                               1e-6, cv_list, compress);
+
+    std::vector<std::shared_ptr<c_cellview>> expect_list;
+    cbag::gdsii::read_gds(gds_fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(expect_list));
+    std::vector<std::shared_ptr<c_cellview>> oas_list;
+    cbag::oasis::read_oas(oas_fname, test_layer_map, test_obj_map, grid,
+                          std::back_inserter(oas_list));
+
+    REQUIRE(oas_list.size() == expect_list.size());
+    for (std::size_t idx = 0; idx < oas_list.size(); ++idx) {
+        REQUIRE(oas_list[idx]->get_name() == expect_list[idx]->get_name());
+        REQUIRE(*oas_list[idx] == *expect_list[idx]);
+    }
+    auto &top = *oas_list.back();
+    REQUIRE(std::distance(top.begin_inst(), top.end_inst()) == 2);
+}
@@ -1,7 +1,11 @@
 #include <catch2/catch.hpp>
 
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
 
+#include <cbag/util/compress.h>
 #include <cbag/util/io.h>
 
 namespace fs = std::filesystem;
@@ -61,3 +65,62 @@ TEST_CASE("throw exception when writing file with no write permission", "[io]")
 
     REQUIRE(throws_exception == true);
 }
+
+TEST_CASE("compressed streams round trip", "[io]") {
+    auto type = GENERATE(cbag::compress_type::GZIP, cbag::compress_type::ZSTD);
+    auto fname = std::string("tests/data/test_outputs/io/compress") +
+                 ((type == cbag::compress_type::GZIP) ? ".gz" : ".zst");
+    REQUIRE(cbag::util::get_compress_type(fname) == type);
+
+    // larger than one decompressed chunk, so reads and seeks cross chunk boundaries
+    constexpr std::size_t num = 3000000;
+    std::string data(num, '\0');
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        data[idx] = static_cast<char>((idx * 7) % 251);
+    }
+    {
+        cbag::util::compress_ostream out(fname, type);
+        out.write(data.data(), num);
+        out.close();
+    }
+
+    cbag::util::decompress_istream in(fname, type);
+    std::string result;
+    std::string buf(4, '\0');
+    while (in.read(buf.data(), 4)) {
+        // read every 4 bytes twice, like peeking at a record header
+        in.seekg(-4, std::ios::cur);
+        in.read(buf.data(), 4);
+        result += buf;
+    }
+    result.append(buf.data(), in.gcount());
+    REQUIRE(result == data);
+}
+
+TEST_CASE("block_ostream writes all data in order", "[io]") {
+    auto block_size = GENERATE(static_cast<std::size_t>(16), static_cast<std::size_t>(1 << 20));
+    auto fname = std::string("tests/data/test_outputs/io/block_test.bin");
+
+    std::string expect;
+    {
+        cbag::util::block_ostream stream(fname, block_size);
+        for (int idx = 0; idx < 1000; ++idx) {
+            auto val = std::to_string(idx * 7919);
+            expect += val;
+            expect.push_back('\0');
+            stream.write(val.data(), val.size());
+            stream.put('\0');
+        }
+        stream.close();
+    }
+
+    std::ifstream in(fname, std::ios_base::binary);
+    std::string ans((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(ans == expect);
+}
+
+TEST_CASE("block_ostream throws on write errors", "[io]") {
+    cbag::util::block_ostream stream("/dev/full", 16);
+    std::string data(64, 'a');
+    REQUIRE_THROWS_AS(stream.write(data.data(), data.size()), std::ios_base::failure);
+}
@@ -0,0 +1,49 @@
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <cbag/util/parallel.h>
+
+namespace cu = cbag::util;
+
+TEST_CASE("parallel_for visits every index once", "[util::parallel]") {
+    auto num_threads = GENERATE(1, 2, 4);
+
+    cu::thread_pool pool;
+    std::vector<std::atomic<int>> cnt_list(1000);
+    // the pool is reused by every call
+    for (int iter = 0; iter < 3; ++iter) {
+        cu::parallel_for(pool, cnt_list.size(), num_threads,
+                         [&cnt_list](std::size_t idx) { ++cnt_list[idx]; });
+    }
+    REQUIRE(pool.size() == static_cast<std::size_t>(num_threads - 1));
+    for (const auto &cnt : cnt_list) {
+        REQUIRE(cnt == 3);
+    }
+}
+
+TEST_CASE("parallel_for re-throws exceptions", "[util::parallel]") {
+    REQUIRE_THROWS_AS(cu::parallel_for(100, 4,
+                                       [](std::size_t idx) {
+                                           if (idx == 37)
+                                               throw std::runtime_error("bad index");
+                                       }),
+                      std::runtime_error);
+}
+
+TEST_CASE("nested parallel_for calls share the pool", "[util::parallel]") {
+    cu::thread_pool pool(2);
+    std::vector<int> sum_list(8, 0);
+    cu::parallel_for(pool, sum_list.size(), 3, [&pool, &sum_list](std::size_t idx) {
+        std::vector<int> val_list(100, 0);
+        cu::parallel_for(pool, val_list.size(), 3,
+                         [&val_list, idx](std::size_t j) { val_list[j] = static_cast<int>(idx); });
+        sum_list[idx] = std::accumulate(val_list.begin(), val_list.end(), 0);
+    });
+    for (std::size_t idx = 0; idx < sum_list.size(); ++idx) {
+        REQUIRE(sum_list[idx] == 100 * static_cast<int>(idx));
+    }
+}
@@ -0,0 +1,54 @@
+#include <cbag/common/box_t.h>
+#include <cbag/common/point.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/layout/cellview.h>
+#include <cbag/layout/instance.h>
+#include <cbag/layout/pt_traits.h>
+#include <cbag/layout/routing_grid.h>
+#include <cbag/layout/tech_util.h>
+
+#include "util/layout.h"
+
+const std::string test_layer_map = "tests/data/test_gds/gds.layermap";
+const std::string test_obj_map = "tests/data/test_gds/gds.objectmap";
+
+std::shared_ptr<const cbag::layout::tech> make_tech_info() {
+    return std::make_shared<const cbag::layout::tech>("tests/data/test_layout/tech_params.yaml");
+}
+
+std::shared_ptr<const cbag::layout::routing_grid>
+make_grid(const std::shared_ptr<const cbag::layout::tech> &tech) {
+    return std::make_shared<const cbag::layout::routing_grid>(
+        tech, "tests/data/test_layout/grid.yaml");
+}
+
+std::vector<std::pair<std::string, std::shared_ptr<const cbag::layout::cellview>>>
+make_test_cellviews(const std::shared_ptr<const cbag::layout::routing_grid> &grid) {
+    using c_cellview = cbag::layout::cellview;
+    auto &tech_info = *grid->get_tech();
+    auto key = cbag::layout::layer_t_at(tech_info, "M1", "drawing");
+
+    constexpr std::size_t num_leaf = 8;
+    std::vector<std::pair<std::string, std::shared_ptr<const c_cellview>>> cv_list;
+    auto top = std::make_shared<c_cellview>(grid, "TOP");
+    top->add_shape(key, cbag::box_t(-50, -50, 50, 50));
+    std::vector<cbag::point> l_shape = {{0, -1200}, {300, -1200}, {300, -1100},
+                                        {100, -1100}, {100, -1000}, {0, -1000}};
+    cbag::layout::polygon90 l_poly;
+    l_poly.set(l_shape.begin(), l_shape.end());
+    top->add_shape(key, l_poly);
+    for (std::size_t idx = 0; idx < num_leaf; ++idx) {
+        auto name = "LEAF" + std::to_string(idx);
+        auto leaf = std::make_shared<c_cellview>(grid, name);
+        auto w = static_cast<cbag::coord_t>(20 * (idx + 1));
+        leaf->add_shape(key, cbag::box_t(0, 0, 100, w));
+        leaf->add_shape(key, cbag::box_t(0, 40 + w, w, 200));
+        top->add_object(cbag::layout::instance("X" + std::to_string(idx), leaf,
+                                               cbag::make_xform(w * 50, 20, cbag::oR90)));
+        cv_list.emplace_back(name, leaf);
+    }
+    top->add_object(cbag::layout::instance("XARR", cv_list[0].second, cbag::make_xform(0, 500), 4,
+                                           2, 200, 300));
+    cv_list.emplace_back("TOP", top);
+    return cv_list;
+}
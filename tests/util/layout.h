@@ -0,0 +1,26 @@
+#ifndef TESTS_UTIL_LAYOUT_H
+#define TESTS_UTIL_LAYOUT_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cbag/layout/cellview_fwd.h>
+
+// the layer and object maps of the test GDS and OASIS files
+extern const std::string test_layer_map;
+extern const std::string test_obj_map;
+
+std::shared_ptr<const cbag::layout::tech> make_tech_info();
+
+std::shared_ptr<const cbag::layout::routing_grid>
+make_grid(const std::shared_ptr<const cbag::layout::tech> &tech);
+
+/** Returns 8 leaf cells, and a top cell with a box, a polygon, a rotated instance of each leaf
+ *  and an array of the first leaf, each with its structure name.
+ */
+std::vector<std::pair<std::string, std::shared_ptr<const cbag::layout::cellview>>>
+make_test_cellviews(const std::shared_ptr<const cbag::layout::routing_grid> &grid);
+
+#endif
@@ -0,0 +1,184 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <cbag/common/box_t_util.h>
+#include <cbag/common/transformation_util.h>
+#include <cbag/gdsii/read.h>
+#include <cbag/layout/cellview.h>
+#include <cbag/layout/geo_index.h>
+#include <cbag/layout/geo_iterator.h>
+#include <cbag/layout/routing_grid.h>
+#include <cbag/layout/tech.h>
+
+using c_box = cbag::box_t;
+
+struct bench_shape {
+    c_box box;
+    cbag::offset_t spx;
+    cbag::offset_t spy;
+};
+
+// random horizontal and vertical wires on a regular track pitch
+std::vector<bench_shape> make_synthetic(std::size_t num, std::mt19937 &gen) {
+    constexpr cbag::coord_t pitch = 100;
+    constexpr cbag::coord_t width = 40;
+    auto num_tracks = static_cast<cbag::coord_t>(std::sqrt(static_cast<double>(num))) + 1;
+    std::uniform_int_distribution<cbag::coord_t> track_dist(0, num_tracks - 1);
+    std::uniform_int_distribution<cbag::coord_t> len_dist(width, 20 * pitch);
+    std::uniform_int_distribution<cbag::coord_t> pos_dist(0, num_tracks * pitch);
+
+    std::vector<bench_shape> ans;
+    ans.reserve(num);
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        auto center = track_dist(gen) * pitch;
+        auto lower = pos_dist(gen);
+        auto upper = lower + len_dist(gen);
+        if (idx % 2 == 0)
+            ans.push_back({c_box(lower, center - width / 2, upper, center + width / 2), 0, 20});
+        else
+            ans.push_back({c_box(center - width / 2, lower, center + width / 2, upper), 20, 0});
+    }
+    return ans;
+}
+
+// all shapes of the last cellview in a GDS file, flattened into top level coordinates
+std::vector<bench_shape> read_layout(char *argv[]) {
+    auto tech_ptr = std::make_shared<const cbag::layout::tech>(argv[4]);
+    auto grid_ptr = std::make_shared<const cbag::layout::routing_grid>(tech_ptr, argv[5]);
+    std::vector<std::shared_ptr<cbag::layout::cellview>> cv_list;
+    cbag::gdsii::read_gds(argv[1], argv[2], argv[3], grid_ptr, std::back_inserter(cv_list));
+
+    std::vector<bench_shape> ans;
+    if (cv_list.empty())
+        return ans;
+    auto &cv = *cv_list.back();
+    for (auto lev = grid_ptr->get_bot_level(); lev <= grid_ptr->get_top_level(); ++lev) {
+        auto &index = *cv.get_geo_index(lev);
+        if (index.empty())
+            continue;
+        for (auto iter = index.begin_intersect(index.get_bbox(), 0, 0, cbag::make_xform());
+             iter.has_next(); ++iter) {
+            auto view = *iter;
+            auto box = view.get_bbox();
+            auto bnd = view.get_bnd_box();
+            ans.push_back({box, xl(box) - xl(bnd), yl(box) - yl(bnd)});
+        }
+    }
+    return ans;
+}
+
+std::vector<c_box> make_queries(const std::vector<bench_shape> &shapes, std::size_t num,
+                                std::mt19937 &gen) {
+    auto tot_box = c_box::get_invalid_box();
+    for (const auto &s : shapes) {
+        cbag::merge(tot_box, s.box);
+    }
+    std::uniform_int_distribution<cbag::coord_t> x_dist(cbag::xl(tot_box), cbag::xh(tot_box));
+    std::uniform_int_distribution<cbag::coord_t> y_dist(cbag::yl(tot_box), cbag::yh(tot_box));
+    std::uniform_int_distribution<cbag::coord_t> size_dist(10, 1000);
+    std::vector<c_box> ans;
+    ans.reserve(num);
+    for (std::size_t idx = 0; idx < num; ++idx) {
+        auto x = x_dist(gen);
+        auto y = y_dist(gen);
+        ans.emplace_back(x, y, x + size_dist(gen), y + size_dist(gen));
+    }
+    return ans;
+}
+
+template <class F> double time_sec(F &&fun) {
+    auto start = std::chrono::steady_clock::now();
+    fun();
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+    return diff.count();
+}
+
+void run_bench(const std::string &name, const std::vector<bench_shape> &shapes,
+               const std::vector<c_box> &queries) {
+    constexpr std::size_t stream_batch = 100;
+    std::cout << fmt::format("{}: {} shapes, {} queries", name, shapes.size(), queries.size())
+              << std::endl;
+    std::cout << fmt::format("{:>10} {:>6} {:>14} {:>14} {:>14} {:>10}", "algorithm", "node",
+                             "bulk (obj/s)", "stream (obj/s)", "query (q/s)", "hits")
+              << std::endl;
+
+    std::vector<std::pair<cbag::index_algorithm, std::string>> alg_list = {
+        {cbag::index_algorithm::LINEAR, "linear"},
+        {cbag::index_algorithm::QUADRATIC, "quadratic"},
+        {cbag::index_algorithm::RSTAR, "rstar"},
+    };
+    for (const auto &[alg, alg_name] : alg_list) {
+        for (std::size_t max_elements : {8, 16, 32, 64}) {
+            // bulk loading, as done when reading a layout
+            cbag::layout::geo_index bulk(alg, max_elements);
+            auto t_bulk = time_sec([&]() {
+                for (const auto &s : shapes) {
+                    bulk.insert(s.box, s.spx, s.spy);
+                }
+                bulk.finalize();
+            });
+
+            // streaming insertion, finalized after every small batch as when generation and
+            // queries are interleaved
+            cbag::layout::geo_index stream(alg, max_elements);
+            auto t_stream = time_sec([&]() {
+                for (std::size_t idx = 0; idx < shapes.size(); ++idx) {
+                    stream.insert(shapes[idx].box, shapes[idx].spx, shapes[idx].spy);
+                    if (idx % stream_batch == stream_batch - 1)
+                        stream.finalize();
+                }
+                stream.finalize();
+            });
+
+            std::size_t num_hits = 0;
+            auto t_query = time_sec([&]() {
+                for (const auto &r : queries) {
+                    for (auto iter = bulk.begin_intersect(r, 0, 0, cbag::make_xform());
+                         iter.has_next(); ++iter) {
+                        ++num_hits;
+                    }
+                }
+            });
+
+            std::cout << fmt::format("{:>10} {:>6} {:>14.0f} {:>14.0f} {:>14.0f} {:>10}",
+                                     alg_name, max_elements, shapes.size() / t_bulk,
+                                     shapes.size() / t_stream, queries.size() / t_query,
+                                     num_hits)
+                      << std::endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::mt19937 gen(42);
+    constexpr std::size_t num_queries = 100000;
+    switch (argc) {
+    case 1:
+    case 2: {
+        std::size_t num = (argc == 2) ? std::stoul(argv[1]) : 1000000;
+        auto shapes = make_synthetic(num, gen);
+        run_bench("synthetic", shapes, make_queries(shapes, num_queries, gen));
+        break;
+    }
+    case 6: {
+        auto shapes = read_layout(argv);
+        run_bench(argv[1], shapes, make_queries(shapes, num_queries, gen));
+        break;
+    }
+    default:
+        std::cout << "Usage: bench_geo_index [<num_shapes>]" << std::endl;
+        std::cout << "       bench_geo_index <gds_file> <layer_map> <obj_map> <tech_yaml> "
+                     "<grid_yaml>"
+                  << std::endl;
+    }
+
+    return 0;
+}
@@ -1,4 +1,12 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <fmt/core.h>
+
+#include <cbag/common/box_t_util.h>
 #include <cbag/gdsii/read_util.h>
+#include <cbag/gdsii/scan.h>
 #include <cbag/util/io.h>
 
 void print_gds(char *fname) {
@@ -10,13 +18,43 @@ void print_gds(char *fname) {
     std::cout << "print_gds done." << std::endl;
 }
 
+// prints a summary of every structure, without parsing shapes
+void print_gds_stats(char *fname) {
+    auto start = std::chrono::steady_clock::now();
+    auto info_list = cbag::gdsii::scan_gds(fname);
+
+    for (const auto &info : info_list) {
+        const auto &stats = info.stats;
+        fmt::print("STRUCT {}: depth {}, used {} times, {} flattened shapes, bbox {}\n", info.name,
+                   info.depth, info.num_used, info.num_flat,
+                   cbag::is_valid(info.bbox) ? cbag::to_string(info.bbox) : "none");
+        fmt::print("  {} boundaries, {} boxes, {} paths, {} texts, {} nodes, {} references\n",
+                   stats.num_boundary, stats.num_box, stats.num_path, stats.num_text,
+                   stats.num_node, stats.num_inst);
+        for (const auto &[key, cnt] : info.layer_cnt) {
+            fmt::print("  layer {}/{}: {}\n", key.first, key.second, cnt);
+        }
+        for (const auto &[master, cnt] : info.ref_cnt) {
+            fmt::print("  ref {}: {}\n", master, cnt);
+        }
+    }
+
+    fmt::print("Top structures:");
+    for (const auto &info : info_list) {
+        if (info.num_used == 0)
+            fmt::print(" {}", info.name);
+    }
+    auto dur = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    fmt::print("\n{} structures scanned in {:.3f} s.\n", info_list.size(), dur.count());
+}
+
 int main(int argc, char *argv[]) {
-    switch (argc) {
-    case 2:
+    if (argc == 2) {
         print_gds(argv[1]);
-        break;
-    default:
-        std::cout << "Usage: print_gds <fname>" << std::endl;
+    } else if (argc == 3 && std::strcmp(argv[1], "--stats") == 0) {
+        print_gds_stats(argv[2]);
+    } else {
+        std::cout << "Usage: print_gds [--stats] <fname>" << std::endl;
     }
 
     return 0;